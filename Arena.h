@@ -0,0 +1,77 @@
+#ifndef RENDERING_PROJECT_ARENA_H
+#define RENDERING_PROJECT_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Bump allocator for scene objects. Objects are placed back to back in large blocks
+// and destroyed together when the arena is cleared, so there is no per-object delete.
+class Arena {
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+        std::size_t used;
+    };
+    struct Destructor {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::vector<Block> blocks;
+    std::vector<Destructor> destructors;
+    std::size_t blockSize;
+
+public:
+    explicit Arena(std::size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+    ~Arena() { clear(); }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align) {
+        if (!blocks.empty()) {
+            Block& block = blocks.back();
+            std::size_t offset = (block.used + align - 1) & ~(align - 1);
+            if (offset + size <= block.size) {
+                block.used = offset + size;
+                return block.data.get() + offset;
+            }
+        }
+        // new[] storage is aligned for any fundamental type, so offset 0 is always valid
+        std::size_t capacity = std::max(blockSize, size);
+        blocks.push_back({std::make_unique<std::byte[]>(capacity), capacity, size});
+        return blocks.back().data.get();
+    }
+
+    template<class T, class... Args>
+    T* create(Args&&... args) {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            destructors.push_back({object, [](void* p) { static_cast<T*>(p)->~T(); }});
+        }
+        return object;
+    }
+
+    // Destroys every object in reverse creation order and releases all blocks
+    void clear() {
+        for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) it->destroy(it->object);
+        destructors.clear();
+        blocks.clear();
+    }
+
+    [[nodiscard]] std::size_t bytesReserved() const {
+        std::size_t total = 0;
+        for (const Block& block : blocks) total += block.size;
+        return total;
+    }
+};
+
+
+#endif //RENDERING_PROJECT_ARENA_H
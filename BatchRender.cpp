@@ -0,0 +1,250 @@
+#include "BatchRender.h"
+
+#include "Constants.h"
+#include "CpuRenderer.h"
+#include "Parallel.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "Timeline.h"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+
+CameraPath& CameraPath::key(const double time, const Vector3& origin, const Vector3& forward) {
+    auto it = std::upper_bound(keys.begin(), keys.end(), time, [](double t, const Key& k) { return t < k.time; });
+    keys.insert(it, {time, origin, forward.normalized()});
+    return *this;
+}
+
+CameraBasis CameraPath::at(const double time) const {
+    if (keys.empty()) return CameraBasis(Vector3(0, 0, 0), Vector3(0, 1, 0), Z);
+    if (time <= keys.front().time) return CameraBasis(keys.front().origin, keys.front().forward, Z);
+    if (time >= keys.back().time) return CameraBasis(keys.back().origin, keys.back().forward, Z);
+
+    const auto next = std::upper_bound(keys.begin(), keys.end(), time, [](double t, const Key& k) { return t < k.time; });
+    const std::size_t i = static_cast<std::size_t>(next - keys.begin()) - 1;
+    const Key& a = keys[i];
+    const Key& b = keys[i + 1];
+    const Vector3& before = keys[i > 0 ? i - 1 : i].origin;
+    const Vector3& after = keys[std::min(i + 2, keys.size() - 1)].origin;
+
+    const double f = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1.0;
+    const double f2 = f * f, f3 = f2 * f;
+    // Uniform Catmull-Rom; the end keys are repeated, so the path starts and stops on them
+    const Vector3 origin = (a.origin * 2.0 + (b.origin - before) * f +
+                            (before * 2.0 - a.origin * 5.0 + b.origin * 4.0 - after) * f2 +
+                            (a.origin * 3.0 - before - b.origin * 3.0 + after) * f3) * 0.5;
+    const Vector3 forward = a.forward * (1.0 - f) + b.forward * f;
+    return CameraBasis(origin, forward.magnitude() > 1e-9 ? forward : b.forward, Z);
+}
+
+namespace {
+    class JobReader {
+        std::istringstream in;
+        std::size_t line;
+
+    public:
+        JobReader(const std::string& text, const std::size_t line) : in(text), line(line) {}
+
+        [[noreturn]] void fail(const std::string& what) const {
+            throw std::invalid_argument("BatchRender: line " + std::to_string(line) + ": " + what);
+        }
+
+        bool atEnd() {
+            in >> std::ws;
+            return in.eof();
+        }
+
+        std::string word() {
+            std::string s;
+            if (!(in >> s)) fail("unexpected end of line");
+            return s;
+        }
+
+        double num() {
+            const std::string s = word();
+            try {
+                std::size_t used = 0;
+                const double v = std::stod(s, &used);
+                if (used == s.size()) return v;
+            } catch (const std::exception&) {}
+            fail("'" + s + "' is not a number");
+        }
+
+        int integer() { return static_cast<int>(num()); }
+        unsigned count() {
+            const double v = num();
+            if (v < 0) fail("expected a non-negative number");
+            return static_cast<unsigned>(v);
+        }
+        Vector3 vec() { const double x = num(), y = num(); return Vector3(x, y, num()); }
+    };
+
+    using Clock = std::chrono::steady_clock;
+}
+
+AnimationJob readAnimationJob(std::istream& in) {
+    AnimationJob job;
+    std::string text;
+    std::size_t line = 0;
+    bool header = false;
+    while (std::getline(in, text)) {
+        ++line;
+        JobReader r(text, line);
+        if (r.atEnd() || text.find_first_not_of(" \t") == text.find('#')) continue;
+
+        const std::string keyword = r.word();
+        if (!header) {
+            if (keyword != "batch" || r.integer() != 1) r.fail("expected 'batch 1'");
+            header = true;
+            continue;
+        }
+        if (keyword == "scene") job.scenePath = r.word();
+        else if (keyword == "output") job.output = r.word();
+        else if (keyword == "size") { job.width = r.count(); job.height = r.count(); }
+        else if (keyword == "frames") { job.firstFrame = r.integer(); job.lastFrame = r.integer(); }
+        else if (keyword == "fps") job.fps = r.num();
+        else if (keyword == "fov") job.fov = r.num();
+        else if (keyword == "light") job.light = r.vec().normalized();
+        else if (keyword == "steps") job.maxSteps = r.count();
+        else if (keyword == "reflections") job.maxReflectionDepth = r.integer();
+        else if (keyword == "antialias") job.edgeSamples = r.count();
+        else if (keyword == "concurrent") job.concurrentFrames = r.count();
+        else if (keyword == "camera") {
+            const double time = r.num();
+            const Vector3 origin = r.vec();
+            job.camera.key(time, origin, r.vec());
+        } else if (keyword == "animate") {
+            AnimationJob::Track& track = job.animation.emplace_back();
+            track.object = r.word();
+            track.parameter = r.word();
+            while (!r.atEnd()) {
+                const double time = r.num();
+                track.keys.emplace_back(time, r.num());
+            }
+            if (track.keys.empty()) r.fail("animate needs at least one time/value pair");
+        } else {
+            r.fail("unknown keyword '" + keyword + "'");
+        }
+        if (!r.atEnd()) r.fail("unexpected text after '" + keyword + "'");
+    }
+
+    if (!header) throw std::invalid_argument("BatchRender: empty job");
+    if (job.scenePath.empty() || job.output.empty()) throw std::invalid_argument("BatchRender: job needs 'scene' and 'output'");
+    if (job.output.find('#') == std::string::npos) throw std::invalid_argument("BatchRender: output needs a run of '#' for the frame number");
+    if (job.camera.empty()) throw std::invalid_argument("BatchRender: job needs at least one 'camera' key");
+    if (job.width == 0 || job.height == 0 || job.fps <= 0.0 || job.lastFrame < job.firstFrame)
+        throw std::invalid_argument("BatchRender: size, fps or frame range is empty");
+    return job;
+}
+
+std::string framePath(const std::string& pattern, const int frame) {
+    const std::size_t first = pattern.find('#');
+    if (first == std::string::npos) return pattern;
+    const std::size_t width = pattern.find_first_not_of('#', first) == std::string::npos
+        ? pattern.size() - first : pattern.find_first_not_of('#', first) - first;
+    std::string number = std::to_string(frame);
+    if (number.size() < width) number.insert(0, width - number.size(), '0');
+    return pattern.substr(0, first) + number + pattern.substr(first + width);
+}
+
+BatchStats renderAnimation(const AnimationJob& job, std::ostream* log) {
+    const auto start = Clock::now();
+    BatchStats stats;
+
+    std::ifstream sceneFile(job.scenePath);
+    if (!sceneFile) throw std::invalid_argument("BatchRender: cannot open scene '" + job.scenePath + "'");
+    std::ostringstream sceneText;
+    sceneText << sceneFile.rdbuf();
+
+    // A frame file only appears once it is complete (see below), so whatever exists is done
+    std::vector<int> todo;
+    for (int frame = job.firstFrame; frame <= job.lastFrame; ++frame) {
+        if (std::filesystem::exists(framePath(job.output, frame))) ++stats.skipped;
+        else todo.push_back(frame);
+    }
+    const std::filesystem::path directory = std::filesystem::path(job.output).parent_path();
+    if (!directory.empty()) std::filesystem::create_directories(directory);
+
+    // Whole frames in parallel keep every core busy without the per-pass joins of a single
+    // frame, so each worker thread renders its own frames with its own scene copy. Threads
+    // inside a frame only come in at the end of the job, when fewer frames than cores are
+    // left: each frame then takes the cores the finished workers gave up.
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned slots = static_cast<unsigned>(std::min<std::size_t>(
+        job.concurrentFrames > 0 ? job.concurrentFrames : cores, todo.size()));
+    const unsigned previousLimit = threadLimit.load();
+
+    std::atomic<std::size_t> next{0};
+    std::atomic<unsigned> rendered{0};
+    std::mutex mutex;  // log and firstError
+    std::exception_ptr firstError;
+
+    auto worker = [&] {
+        try {
+            Scene scene;
+            std::istringstream in(sceneText.str());
+            readScene(in, scene);
+            Timeline timeline(scene);
+            for (const AnimationJob::Track& t : job.animation) {
+                Timeline::Track& track = timeline.animate(t.object, t.parameter);
+                for (const auto& [time, value] : t.keys) track.key(time, value);
+            }
+            CpuRenderer renderer(scene, job.light, job.fov);
+            renderer.maxSteps = job.maxSteps;
+            renderer.maxReflectionDepth = job.maxReflectionDepth;
+            renderer.edgeSamples = job.edgeSamples;
+
+            std::vector<std::uint8_t> rgba;
+            for (std::size_t i; (i = next.fetch_add(1)) < todo.size();) {
+                const int frame = todo[i];
+                const double time = frame / job.fps;
+                threadLimit = std::max(1u, cores / static_cast<unsigned>(std::min<std::size_t>(slots, todo.size() - i)));
+
+                const auto frameStart = Clock::now();
+                timeline.evaluate(time);
+                renderer.render(job.camera.at(time), job.width, job.height, rgba);
+
+                // Written under a temporary name and renamed, so a frame file is never partial.
+                // The temporary name keeps the extension, which picks the image format.
+                const std::filesystem::path path = framePath(job.output, frame);
+                std::filesystem::path partial = path;
+                partial.replace_extension(".partial" + path.extension().string());
+                if (!sf::Image({job.width, job.height}, rgba.data()).saveToFile(partial))
+                    throw std::runtime_error("BatchRender: cannot write '" + partial.string() + "'");
+                std::filesystem::rename(partial, path);
+
+                const unsigned done = ++rendered;
+                if (log) {
+                    const double seconds = std::chrono::duration<double>(Clock::now() - frameStart).count();
+                    std::lock_guard lock(mutex);
+                    *log << "frame " << frame << " (" << done << "/" << todo.size() << ") " << seconds << " s\n" << std::flush;
+                }
+            }
+        } catch (...) {
+            std::lock_guard lock(mutex);
+            if (!firstError) firstError = std::current_exception();
+            next = todo.size();  // stop handing out frames
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < slots; ++t) pool.emplace_back(worker);
+    if (slots > 0) worker();
+    for (auto& thread : pool) thread.join();
+    threadLimit = previousLimit;
+    if (firstError) std::rethrow_exception(firstError);
+
+    stats.rendered = rendered;
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return stats;
+}
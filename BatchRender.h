@@ -0,0 +1,89 @@
+#ifndef RENDERING_PROJECT_BATCHRENDER_H
+#define RENDERING_PROJECT_BATCHRENDER_H
+
+#include "CameraBasis.h"
+#include "Vector3.h"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Keyframed camera flight: Catmull-Rom through the positions, view directions blended
+// and renormalised. Clamped outside the keyed range.
+class CameraPath {
+public:
+    struct Key {
+        double time;
+        Vector3 origin;
+        Vector3 forward;
+    };
+
+    CameraPath& key(double time, const Vector3& origin, const Vector3& forward);
+
+    [[nodiscard]] CameraBasis at(double time) const;
+    [[nodiscard]] bool empty() const { return keys.empty(); }
+
+private:
+    std::vector<Key> keys;  // sorted by time
+};
+
+// Offline rendering of an animation with the CPU renderer, read from a job file:
+//
+//     batch 1
+//     scene demo.scene                  SceneFile text, see --export-scene
+//     output frames/frame_#####.png     the run of '#' becomes the zero-padded frame number
+//     size 1280 720
+//     frames 0 599                      inclusive range
+//     fps 30
+//     fov 1.0472
+//     light 0 -0.8 0.6                  direction towards the light
+//     steps 512
+//     reflections 2
+//     antialias 16                      most extra rays per edge pixel, 0 = off
+//     concurrent 0                      frames rendered at once, 0 = one per hardware thread
+//     camera <time> <x y z> <forward x y z>            one line per key
+//     animate <object> <parameter> <time> <value>...   Timeline track, linear, clamped
+//
+// Lines may come in any order after the header; '#' starts a comment only at the
+// beginning of a line. Paths are relative to the working directory.
+struct AnimationJob {
+    std::string scenePath;
+    std::string output;
+    unsigned width = 1280, height = 720;
+    int firstFrame = 0, lastFrame = 0;
+    double fps = 30.0;
+    double fov = 1.0472;
+    Vector3 light{0, 0, 1};
+    unsigned maxSteps = 512;
+    int maxReflectionDepth = 2;
+    unsigned edgeSamples = 0;
+    unsigned concurrentFrames = 0;
+    CameraPath camera;
+
+    struct Track {
+        std::string object, parameter;
+        std::vector<std::pair<double, double>> keys;  // time, value
+    };
+    std::vector<Track> animation;
+};
+
+// Throws std::invalid_argument on a malformed job
+AnimationJob readAnimationJob(std::istream& in);
+
+// Output file of `frame` for a pattern with a run of '#'
+std::string framePath(const std::string& pattern, int frame);
+
+struct BatchStats {
+    unsigned rendered = 0;
+    unsigned skipped = 0;  // already on disk from an earlier run
+    double seconds = 0.0;
+};
+
+// Renders every frame of the job whose output file does not exist yet. Frames are written
+// under a temporary name and renamed when complete, so an interrupted job leaves only
+// finished frames behind and simply resumes when run again. Progress goes to `log`.
+BatchStats renderAnimation(const AnimationJob& job, std::ostream* log = nullptr);
+
+
+#endif //RENDERING_PROJECT_BATCHRENDER_H
@@ -0,0 +1,48 @@
+#include "Bvh.h"
+
+#include <numeric>
+
+
+void Bvh::build(const std::vector<Aabb>& boxes) {
+    nodes.clear();
+    items.resize(boxes.size());
+    std::iota(items.begin(), items.end(), 0u);
+    if (boxes.empty()) return;
+    nodes.reserve(2 * boxes.size() / LEAF_SIZE + 1);
+    buildNode(boxes, 0, static_cast<std::uint32_t>(boxes.size()), 0);
+}
+
+std::uint32_t Bvh::buildNode(const std::vector<Aabb>& boxes, const std::uint32_t begin, const std::uint32_t end, const int depth) {
+    const auto index = static_cast<std::uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    Aabb box, centroids;
+    for (std::uint32_t i = begin; i < end; ++i) {
+        const Aabb& b = boxes[items[i]];
+        box.grow(b);
+        Aabb c;
+        for (int a = 0; a < 3; ++a) c.lo[a] = c.hi[a] = b.centroid(a);
+        centroids.grow(c);
+    }
+    nodes[index].box = box;
+
+    // Depth is capped well below the traversal stack size
+    if (end - begin <= LEAF_SIZE || depth >= 48) {
+        nodes[index].first = begin;
+        nodes[index].count = end - begin;
+        return index;
+    }
+
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+        if (centroids.hi[a] - centroids.lo[a] > centroids.hi[axis] - centroids.lo[axis]) axis = a;
+    }
+    const std::uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+                     [&](std::uint32_t a, std::uint32_t b) { return boxes[a].centroid(axis) < boxes[b].centroid(axis); });
+
+    buildNode(boxes, begin, mid, depth + 1);
+    const std::uint32_t right = buildNode(boxes, mid, end, depth + 1);
+    nodes[index].first = right;
+    return index;
+}
@@ -0,0 +1,100 @@
+#ifndef RENDERING_PROJECT_BVH_H
+#define RENDERING_PROJECT_BVH_H
+
+#include "Objects/Object.h"
+#include "Vector3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+
+// Axis-aligned box; lowerBound() is the distance from a point to the box (0 inside)
+struct Aabb {
+    double lo[3] = {std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+    double hi[3] = {-std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+
+    static Aabb around(const BoundingSphere& s) {
+        Aabb b;
+        const double c[3] = {s.center.getX(), s.center.getY(), s.center.getZ()};
+        for (int a = 0; a < 3; ++a) { b.lo[a] = c[a] - s.radius; b.hi[a] = c[a] + s.radius; }
+        return b;
+    }
+
+    void grow(const Aabb& o) {
+        for (int a = 0; a < 3; ++a) { lo[a] = std::min(lo[a], o.lo[a]); hi[a] = std::max(hi[a], o.hi[a]); }
+    }
+
+    [[nodiscard]] double centroid(int axis) const { return 0.5 * (lo[axis] + hi[axis]); }
+
+    [[nodiscard]] double lowerBound(const Vector3& p) const {
+        const double c[3] = {p.getX(), p.getY(), p.getZ()};
+        double sq = 0.0;
+        for (int a = 0; a < 3; ++a) {
+            const double d = std::max({lo[a] - c[a], 0.0, c[a] - hi[a]});
+            sq += d * d;
+        }
+        return std::sqrt(sq);
+    }
+
+    [[nodiscard]] BoundingSphere sphere() const {
+        if (lo[0] > hi[0]) return {};
+        const Vector3 l(lo[0], lo[1], lo[2]), h(hi[0], hi[1], hi[2]);
+        return {(l + h) * 0.5, (h - l).magnitude() * 0.5};
+    }
+};
+
+// Bounding volume hierarchy over a list of boxes, built top-down by median split on the
+// widest axis. Nodes are stored depth first: an inner node's left child follows it
+// directly, so only the right child's index is kept.
+class Bvh {
+public:
+    static constexpr unsigned LEAF_SIZE = 4;
+
+    void build(const std::vector<Aabb>& boxes);
+    [[nodiscard]] bool empty() const { return nodes.empty(); }
+    [[nodiscard]] Aabb bounds() const { return nodes.empty() ? Aabb{} : nodes.front().box; }
+
+    // Branch-and-bound closest item: visits boxes nearest first and skips every box whose
+    // lower bound is not below the best distance so far. distanceTo(item, best) returns the
+    // item's distance (anything >= best when it cannot improve on it).
+    template<class Fn>
+    double nearest(const Vector3& p, Fn&& distanceTo, double best = std::numeric_limits<double>::infinity()) const {
+        if (nodes.empty()) return best;
+        std::uint32_t stack[64];
+        int sp = 0;
+        stack[sp++] = 0;
+        while (sp > 0) {
+            const Node& node = nodes[stack[--sp]];
+            if (node.box.lowerBound(p) >= best) continue;
+            if (node.count > 0) {
+                for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    best = std::min(best, distanceTo(items[i], best));
+                }
+                continue;
+            }
+            // Push the farther child first so the nearer one is popped next
+            const std::uint32_t left = static_cast<std::uint32_t>(&node - nodes.data()) + 1;
+            const std::uint32_t right = node.first;
+            const bool leftFirst = nodes[left].box.lowerBound(p) <= nodes[right].box.lowerBound(p);
+            stack[sp++] = leftFirst ? right : left;
+            stack[sp++] = leftFirst ? left : right;
+        }
+        return best;
+    }
+
+private:
+    struct Node {
+        Aabb box;
+        std::uint32_t first = 0;  // leaf: first entry in items; inner node: right child
+        std::uint32_t count = 0;  // items in a leaf, 0 for inner nodes
+    };
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> items;
+
+    std::uint32_t buildNode(const std::vector<Aabb>& boxes, std::uint32_t begin, std::uint32_t end, int depth);
+};
+
+
+#endif //RENDERING_PROJECT_BVH_H
@@ -9,7 +9,7 @@ class Difference : public Object {
     Object* b;
 
 public:
-    Difference(Object* a, Object* b) : a(a), b(b) {}
+    Difference(Object* a, Object* b) : a(a), b(b) { a->parent = this; b->parent = this; }
 
     Object* getA() const { return a; }
     Object* getB() const { return b; }
@@ -18,10 +18,27 @@ public:
         return std::max(a->distanceToSurface(p), -b->distanceToSurface(p));
     }
 
-    Vector3 getNormalAt(const Vector3& p) override {
-        return a->getNormalAt(p);
+    void distances(const double* xs, const double* ys, const double* zs, double* out, std::size_t count) override {
+        std::vector<double> other(count);
+        a->distances(xs, ys, zs, out, count);
+        b->distances(xs, ys, zs, other.data(), count);
+        for (std::size_t i = 0; i < count; ++i) out[i] = std::max(out[i], -other[i]);
     }
 
+    SdfSample sample(const Vector3& p) override {
+        SdfSample sa = a->sample(p);
+        SdfSample sb = b->sample(p);
+        if (sa.distance >= -sb.distance) return sa;
+        // On a carved face the surface (and normal) is b's, flipped; it is still
+        // painted like the solid it was cut from
+        sb.distance = -sb.distance;
+        sb.inverted = !sb.inverted;
+        sb.material = sa.material;
+        return sb;
+    }
+
+    Vector3 getNormalAt(const Vector3& p) override { return query(p, true).gradient; }
+
     sf::Color getColorAt(const Vector3& p) override {
         return a->getColorAt(p);
     }
@@ -30,6 +47,7 @@ public:
     float getRadiusOrSize() const override { return 0.0f; }
     sf::Color getColorAtOrigin() const override { return sf::Color::White; }
     Vector3 getNormalAtOrigin() const override { return Vector3(0,0,0); }
+    BoundingSphere getBounds() const override { return a->getBounds(); }
 };
 
 #endif
@@ -0,0 +1,86 @@
+#ifndef INSTANCES_H
+#define INSTANCES_H
+
+#include "../Objects/Object.h"
+#include "../Bvh.h"
+#include "../Matrix3.h"
+#include "../Quaternion.h"
+#include <stdexcept>
+#include <vector>
+
+// One placement of the shared child: rotated, uniformly scaled, then moved to position
+struct Instance {
+    Vector3 position;
+    Quaternion rotation{1, 0, 0, 0};
+    double scale = 1.0;
+    int material = -1;  // overrides the child's material, -1 = keep it
+};
+
+// Explicit list of copies of one child, each with its own transform and material. The
+// copies are indexed by a BVH over their bounds, so a query costs O(log n) child
+// evaluations instead of n. After editing `instances`, call rebuild().
+class Instances : public Object {
+    Object* child;
+    Bvh bvh;
+    // Rotation matrices of the instances (and their inverses), built by rebuild()
+    std::vector<Matrix3> toWorld, toLocal;
+
+public:
+    std::vector<Instance> instances;
+
+    Instances(Object* child, std::vector<Instance> list = {}) : child(child), instances(std::move(list)) {
+        if (!child->getBounds().isBounded()) throw std::invalid_argument("Instances: child must be bounded");
+        child->parent = this;
+        rebuild();
+    }
+
+    Object* getChild() const { return child; }
+
+    void add(const Instance& instance) { instances.push_back(instance); }
+
+    // Re-indexes the instances (and picks up changes to the child's bounds)
+    void rebuild() {
+        const BoundingSphere local = child->getBounds();
+        std::vector<Aabb> boxes;
+        boxes.reserve(instances.size());
+        toWorld.clear();
+        toLocal.clear();
+        for (const Instance& inst : instances) {
+            toWorld.push_back(Matrix3::fromQuaternion(inst.rotation));
+            toLocal.push_back(toWorld.back().transposed());
+            boxes.push_back(Aabb::around({inst.position + toWorld.back() * local.center * inst.scale, local.radius * inst.scale}));
+        }
+        bvh.build(boxes);
+    }
+
+    double distanceToSurface(const Vector3& p) override { return sample(p).distance; }
+
+    SdfSample sample(const Vector3& p) override {
+        SdfSample best;
+        bvh.nearest(p, [&](std::uint32_t i, double bound) {
+            const Instance& inst = instances[i];
+            SdfSample s = child->sample(toLocal[i] * (p - inst.position) / inst.scale);
+            s.distance *= inst.scale;
+            if (s.distance >= bound) return s.distance;
+            if (inst.material >= 0) s.material = inst.material;
+            s.toWorld = toWorld[i] * s.toWorld;
+            s.rotated = true;
+            best = s;
+            return s.distance;
+        });
+        return best;
+    }
+
+    Vector3 getNormalAt(const Vector3& p) override { return query(p, true).gradient; }
+
+    sf::Color getColorAt(const Vector3& p) override {
+        const SdfSample s = sample(p);
+        return s.leaf ? s.leaf->getColorAt(s.local) : sf::Color::White;
+    }
+
+    sf::Color getColorAtOrigin() const override { return child->getColorAtOrigin(); }
+    Vector3 getNormalAtOrigin() const override { return Vector3(0,0,0); }
+    BoundingSphere getBounds() const override { return bvh.bounds().sphere(); }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef REPETITION_H
+#define REPETITION_H
+
+#include "../Objects/Object.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Repeats one child on a grid by folding space into a single cell, so a grid of any size
+// costs one child evaluation. The child is modelled around the origin of cell (0,0,0) and
+// should fit inside its cell (bounding radius <= spacing / 2 on every repeated axis);
+// otherwise neighbouring copies can be overstepped.
+class Repetition : public Object {
+    Object* child;
+
+public:
+    Vector3 spacing;  // cell size per axis, 0 = not repeated along that axis
+    Vector3 limit;    // copies on each side of the centre cell, infinity = unbounded
+
+    static constexpr double UNBOUNDED = std::numeric_limits<double>::infinity();
+
+    Repetition(Object* child, const Vector3& spacing, const Vector3& limit = Vector3(UNBOUNDED, UNBOUNDED, UNBOUNDED)) :
+        child(child), spacing(spacing), limit(limit) { child->parent = this; }
+
+    Object* getChild() const { return child; }
+
+    // Position of p inside the cell that contains it
+    [[nodiscard]] Vector3 fold(const Vector3& p) const {
+        return Vector3(foldAxis(p.getX(), spacing.getX(), limit.getX()),
+                       foldAxis(p.getY(), spacing.getY(), limit.getY()),
+                       foldAxis(p.getZ(), spacing.getZ(), limit.getZ()));
+    }
+
+    double distanceToSurface(const Vector3& p) override { return child->distanceToSurface(fold(p)); }
+
+    SdfSample sample(const Vector3& p) override { return child->sample(fold(p)); }
+
+    Vector3 getNormalAt(const Vector3& p) override { return query(p, true).gradient; }
+
+    sf::Color getColorAt(const Vector3& p) override {
+        const SdfSample s = sample(p);
+        return s.leaf->getColorAt(s.local);
+    }
+
+    sf::Color getColorAtOrigin() const override { return child->getColorAtOrigin(); }
+    Vector3 getNormalAtOrigin() const override { return Vector3(0,0,0); }
+
+    BoundingSphere getBounds() const override {
+        BoundingSphere b = child->getBounds();
+        if (!b.isBounded()) return {};
+        // Half-diagonal of the grid of cell centres
+        const double s[3] = {spacing.getX(), spacing.getY(), spacing.getZ()};
+        const double l[3] = {limit.getX(), limit.getY(), limit.getZ()};
+        double extent = 0.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (s[axis] == 0.0) continue;
+            if (!std::isfinite(l[axis])) return {};
+            extent += (s[axis] * l[axis]) * (s[axis] * l[axis]);
+        }
+        return {b.center, b.radius + std::sqrt(extent)};
+    }
+
+    bool setParameter(const std::string& name, double value) override {
+        return setVectorComponent(spacing, "spacing", name, value) || setVectorComponent(limit, "limit", name, value);
+    }
+
+private:
+    static double foldAxis(double v, double s, double l) {
+        if (s == 0.0) return v;
+        const double cell = std::clamp(std::floor(v / s + 0.5), -l, l);
+        return v - s * cell;
+    }
+};
+
+#endif
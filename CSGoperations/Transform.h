@@ -0,0 +1,88 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "../Objects/Object.h"
+#include "../Matrix3.h"
+#include "../Quaternion.h"
+#include <cstddef>
+#include <vector>
+
+// Places a child: rotated, uniformly scaled, then moved by translation. The rotation is
+// kept as a matrix together with its inverse, so evaluating the child costs one
+// matrix-vector product; distances are scaled back by `scale`, which keeps them exact.
+class Transform : public Object {
+    Object* child;
+    Matrix3 rotation;  // child space -> world
+    Matrix3 inverse;   // world -> child space
+
+public:
+    Vector3 translation;
+    double scale;
+
+    Transform(Object* child, const Vector3& translation, const Quaternion& rotation = Quaternion(1, 0, 0, 0), double scale = 1.0) :
+        child(child), translation(translation), scale(scale) {
+        child->parent = this;
+        setRotation(rotation);
+    }
+
+    Object* getChild() const { return child; }
+    const Matrix3& getRotation() const { return rotation; }
+
+    void setRotation(const Quaternion& q) {
+        rotation = Matrix3::fromQuaternion(q);
+        inverse = rotation.transposed();
+    }
+
+    void setRotation(const Matrix3& m) {
+        rotation = m;
+        inverse = rotation.transposed();
+    }
+
+    [[nodiscard]] Vector3 toLocal(const Vector3& p) const { return inverse * (p - translation) / scale; }
+
+    double distanceToSurface(const Vector3& p) override { return child->distanceToSurface(toLocal(p)) * scale; }
+
+    // The whole batch goes to child space in one pass of the matrix kernel
+    void distances(const double* xs, const double* ys, const double* zs, double* out, std::size_t count) override {
+        std::vector<double> local(3 * count);
+        double* lx = local.data();
+        double* ly = lx + count;
+        double* lz = ly + count;
+        inverse.transformPoints(xs, ys, zs, lx, ly, lz, count, translation, 1.0 / scale);
+        child->distances(lx, ly, lz, out, count);
+        for (std::size_t i = 0; i < count; ++i) out[i] *= scale;
+    }
+
+    SdfSample sample(const Vector3& p) override {
+        SdfSample s = child->sample(toLocal(p));
+        s.distance *= scale;
+        s.toWorld = rotation * s.toWorld;
+        s.rotated = true;
+        return s;
+    }
+
+    Vector3 getNormalAt(const Vector3& p) override { return query(p, true).gradient; }
+
+    sf::Color getColorAt(const Vector3& p) override {
+        const SdfSample s = sample(p);
+        return s.leaf->getColorAt(s.local);
+    }
+
+    Vector3 getCenterOrPoint() const override { return translation; }
+    sf::Color getColorAtOrigin() const override { return child->getColorAtOrigin(); }
+    Vector3 getNormalAtOrigin() const override { return Vector3(0,0,0); }
+    float getReflectivity() const override { return child->getReflectivity(); }
+
+    BoundingSphere getBounds() const override {
+        const BoundingSphere b = child->getBounds();
+        if (!b.isBounded()) return {};
+        return {translation + rotation * b.center * scale, b.radius * scale};
+    }
+
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "scale") { scale = value; return true; }
+        return setVectorComponent(translation, "translation", name, value);
+    }
+};
+
+#endif
@@ -8,7 +8,7 @@ class Union : public Object {
     Object* b;
 
 public:
-    Union(Object* a, Object* b) : a(a), b(b) {}
+    Union(Object* a, Object* b) : a(a), b(b) { a->parent = this; b->parent = this; }
 
     Object* getA() const { return a; }
     Object* getB() const { return b; }
@@ -17,16 +17,24 @@ public:
         return std::min(a->distanceToSurface(p), b->distanceToSurface(p));
     }
 
-    Vector3 getNormalAt(const Vector3& p) override {
-        return (a->distanceToSurface(p) < b->distanceToSurface(p))
-            ? a->getNormalAt(p)
-            : b->getNormalAt(p);
+    void distances(const double* xs, const double* ys, const double* zs, double* out, std::size_t count) override {
+        std::vector<double> other(count);
+        a->distances(xs, ys, zs, out, count);
+        b->distances(xs, ys, zs, other.data(), count);
+        for (std::size_t i = 0; i < count; ++i) out[i] = std::min(out[i], other[i]);
     }
 
+    SdfSample sample(const Vector3& p) override {
+        SdfSample sa = a->sample(p);
+        SdfSample sb = b->sample(p);
+        return sa.distance < sb.distance ? sa : sb;
+    }
+
+    Vector3 getNormalAt(const Vector3& p) override { return query(p, true).gradient; }
+
     sf::Color getColorAt(const Vector3& p) override {
-        return (a->distanceToSurface(p) < b->distanceToSurface(p))
-            ? a->getColorAt(p)
-            : b->getColorAt(p);
+        const SdfSample s = sample(p);
+        return s.leaf->getColorAt(s.local);
     }
 
 
@@ -34,6 +42,7 @@ public:
     float getRadiusOrSize() const override { return 0.0f; }
     sf::Color getColorAtOrigin() const override { return sf::Color::White; }
     Vector3 getNormalAtOrigin() const override { return Vector3(0,0,0); }
+    BoundingSphere getBounds() const override { return a->getBounds().merged(b->getBounds()); }
 };
 
 #endif
@@ -4,17 +4,51 @@
 
 #include "CameraBasis.h"
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
 Vector3 CameraBasis::pixelDir(const unsigned x, const unsigned y, const unsigned width, const unsigned height, const double fov) const {
     const double aspect = static_cast<double>(width) / static_cast<double>(height);
     const double ndc_x = ( (x + 0.5) / static_cast<double>(width)  ) * 2.0 - 1.0;
     const double ndc_y = ( (y + 0.5) / static_cast<double>(height) ) * 2.0 - 1.0;
 
+    // Same projection as the shader: fov is the vertical field of view
     const double tanHalfFov = std::tan(fov/2);
     Vector3 dir = (f
-                   + r * (ndc_x * tanHalfFov)
-                   - u * (ndc_y * tanHalfFov / aspect))
+                   + r * (ndc_x * tanHalfFov * aspect)
+                   - u * (ndc_y * tanHalfFov))
                   .normalized();
     return dir;
 }
 
+void CameraBasis::pixelDirDifferentials(const unsigned x, const unsigned y, const unsigned width, const unsigned height,
+                                        const double fov, Vector3& dx, Vector3& dy) const {
+    const double aspect = static_cast<double>(width) / static_cast<double>(height);
+    const double ndc_x = ( (x + 0.5) / static_cast<double>(width)  ) * 2.0 - 1.0;
+    const double ndc_y = ( (y + 0.5) / static_cast<double>(height) ) * 2.0 - 1.0;
+    const double tanHalfFov = std::tan(fov/2);
+    const Vector3 v = f + r * (ndc_x * tanHalfFov * aspect) - u * (ndc_y * tanHalfFov);
+
+    // d = v / |v|, so d' = (v' - d (d . v')) / |v| with v' the change of v over one pixel
+    const double length = v.magnitude();
+    const Vector3 d = v / length;
+    const Vector3 vx = r * (2.0 / width * tanHalfFov * aspect);
+    const Vector3 vy = u * (-2.0 / height * tanHalfFov);
+    dx = (vx - d * d.dot(vx)) / length;
+    dy = (vy - d * d.dot(vy)) / length;
+}
+
+double CameraBasis::projectedDiameter(const Vector3& center, const double radius, const double tanHalfX, const double tanHalfY, const unsigned height) const {
+    const Vector3 d = center - o;
+    if (d.magnitude() <= radius) return std::numeric_limits<double>::infinity(); // camera inside bounds
+    const double z = d.dot(f);
+    if (z < -radius) return 0.0; // fully behind the camera
+
+    // Reject spheres lying completely outside one of the four side planes
+    const double x = std::abs(d.dot(r));
+    const double y = std::abs(d.dot(u));
+    if (x - z * tanHalfX > radius * std::sqrt(1.0 + tanHalfX * tanHalfX)) return 0.0;
+    if (y - z * tanHalfY > radius * std::sqrt(1.0 + tanHalfY * tanHalfY)) return 0.0;
+
+    return radius * height / (std::max(z, radius) * tanHalfY);
+}
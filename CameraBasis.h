@@ -17,6 +17,11 @@ struct CameraBasis {
     o(origin), f(forward.normalized()), r(f.cross(up_hint).normalized()), u(r.cross(f).normalized()) {}
 
     [[nodiscard]] Vector3 pixelDir(unsigned x, unsigned y, unsigned width, unsigned height, double fov) const;
+    // Ray differentials: how pixelDir changes from pixel (x, y) to (x + 1, y) and (x, y + 1)
+    void pixelDirDifferentials(unsigned x, unsigned y, unsigned width, unsigned height, double fov, Vector3& dx, Vector3& dy) const;
+    // Screen-space diameter (pixels) of a bounding sphere, 0 if it is outside the view frustum.
+    // tanHalfX / tanHalfY are the tangents of the horizontal / vertical half view angles.
+    [[nodiscard]] double projectedDiameter(const Vector3& center, double radius, double tanHalfX, double tanHalfY, unsigned height) const;
 };
 
 
@@ -0,0 +1,620 @@
+#include "CpuRenderer.h"
+
+#include "Constants.h"
+#include "Lod.h"
+#include "Parallel.h"
+#include "Objects/Mandelbulb.h"
+#include "Objects/QuaternionJulia.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+namespace {
+    const Vector3 SKY(0.5, 0.7, 1.0);
+    constexpr double REFLECTION_BIAS = 0.02;
+    constexpr double REFLECTION_STRENGTH = 0.9;
+    constexpr double MIN_LEAP_CELLS = 2.0;  // grid leaps shorter than this are not worth a skipped query
+
+    std::uint8_t toByte(float v) {
+        return static_cast<std::uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    Vector3 reflect(const Vector3& d, const Vector3& n) {
+        return d - n * (2.0 * d.dot(n));
+    }
+
+    // Ambient + Lambert + Phong highlight, as the shading pass and the shader
+    Vector3 phong(const Vector3& base, const Vector3& normal, const Vector3& view, const Vector3& lightDir, const float lit) {
+        const double lambert = std::max(normal.dot(lightDir), 0.0);
+        const double specular = std::pow(std::max(view.dot(reflect(lightDir * -1, normal)), 0.0), 32.0);
+        return base * (0.2 + 0.6 * lambert * lit) + 0.2 * specular * lit;
+    }
+
+    // What a pixel shows, for edge detection; object -2 = outside the frame, never an edge
+    struct EdgeKey {
+        std::int32_t object = -2;
+        float depth = 0.0f;
+        Vector3 normal;
+    };
+
+    // Offset of extra sample k > 0 within its pixel, from the R2 sequence (Roberts 2018):
+    // well spread for any sample count, so a pixel may stop after any pass
+    void subpixelOffset(const unsigned k, double& jx, double& jy) {
+        const double a = 0.5 + k * 0.7548776662466927, b = 0.5 + k * 0.5698402909980532;
+        jx = a - std::floor(a) - 0.5;
+        jy = b - std::floor(b) - 0.5;
+    }
+
+    // Texture coordinates of p on `object`, mapped as baseColorAt() in the shader does;
+    // false for objects the shader draws untextured
+    bool surfaceUV(const Object* object, const Vector3& p, const Vector3& n, double& u, double& v) {
+        Vector3 center;
+        if (const auto* sphere = dynamic_cast<const Sphere*>(object)) center = sphere->center;
+        else if (const auto* bulb = dynamic_cast<const Mandelbulb*>(object)) center = bulb->center;
+        else if (const auto* julia = dynamic_cast<const QuaternionJulia*>(object)) center = julia->center;
+        else if (const auto* box = dynamic_cast<const Box*>(object)) {
+            // One face per dominant normal axis, as calculateBoxUV
+            const Vector3 q = p - box->center, size = box->halfSize * 2.0;
+            const double ax = std::abs(n.getX()), ay = std::abs(n.getY()), az = std::abs(n.getZ());
+            if (ax > ay && ax > az) {
+                u = q.getY() / size.getY() + 0.5;
+                v = q.getZ() / size.getZ() + 0.5;
+                if (n.getX() < 0.0) u = 1.0 - u;
+            } else if (ay > az) {
+                u = q.getX() / size.getX() + 0.5;
+                v = q.getZ() / size.getZ() + 0.5;
+                if (n.getY() < 0.0) u = 1.0 - u;
+            } else {
+                u = q.getX() / size.getX() + 0.5;
+                v = q.getY() / size.getY() + 0.5;
+                if (n.getZ() < 0.0) v = 1.0 - v;
+            }
+            return true;
+        } else {
+            return false;
+        }
+
+        // Equirectangular, as calculateSphereUV
+        const Vector3 d = (p - center).normalized();
+        u = (std::atan2(d.getY(), d.getX()) + PI) / (2.0 * PI);
+        v = std::acos(std::clamp(d.getZ(), -1.0, 1.0)) / PI;
+        return true;
+    }
+
+    // Difference of two texture coordinates that wrap around at 1
+    double wrappedDelta(const double to, const double from) {
+        const double d = to - from;
+        return d - std::round(d);
+    }
+
+    // Two tangents perpendicular to the unit normal n, each `width` long
+    void tangentsOf(const Vector3& n, const double width, Vector3& t1, Vector3& t2) {
+        t1 = n.cross(std::abs(n.getZ()) < 0.9 ? Z : X).normalized();
+        t2 = n.cross(t1).normalized();
+        t1 *= width;
+        t2 *= width;
+    }
+}
+
+Vector3 CpuRenderer::surfaceNormal(const SdfSample& hit, const Vector3& dir) {
+    // Normal from the leaf alone (at the point it was sampled); the CSG tree above it is not evaluated again
+    try {
+        return Object::surfaceNormal(hit);
+    } catch (const std::invalid_argument&) {
+        return dir * -1; // flat distance field (e.g. clamped fractal DE)
+    }
+}
+
+double CpuRenderer::march(const Vector3& origin, const Vector3& dir, SdfSample& hit, const double cone, const long tile) const {
+    Vector3 pos = origin;
+    double travelled = 0.0;
+    Lod::Scope lod(footprint(cone));
+    // Grid leaps keep clear by the tolerance wherever they land, which widens linearly along the ray
+    const double growth = Lod::hitEpsilon(0.0, footprint(1.0));
+
+    for (unsigned step = 0; step < maxSteps && travelled < maxDistance; ++step) {
+        // Detail and hit tolerance follow the width of the pixel at the current point
+        Lod::footprint = footprint(cone + travelled);
+        const double epsilon = Lod::hitEpsilon(hitEpsilon, Lod::footprint);
+        // A leap over a few empty cells replaces the query; a shorter one still lengthens the step
+        const double skip = useGrid ? grid.leap(pos, dir, epsilon, growth, maxDistance - travelled) : 0.0;
+        if (skip > 0.0 && skip >= MIN_LEAP_CELLS * grid.cellSize()) {
+            pos += dir * skip;
+            travelled += skip;
+            continue;
+        }
+        hit = tile < 0 ? scene.query(pos) : scene.query(pos, screenBins.objects(static_cast<std::size_t>(tile)));
+        if (!hit.leaf) break;
+        if (hit.distance < epsilon) return travelled;
+        const double d = std::max(hit.distance, skip);
+        pos += dir * d;
+        travelled += d;
+    }
+    hit.leaf = nullptr;
+    return -1.0;
+}
+
+float CpuRenderer::shadow(const Vector3& p, const Vector3& normal) const {
+    const float cached = useShadowCache ? shadowCache.visibility(p, normal) : -1.0f;
+    if (cached < 0.0f) return shadowMarch(p, normal, false);
+    if (cached == 0.0f || shadowCache.uncached().empty()) return cached;
+    return cached * shadowMarch(p, normal, true);
+}
+
+float CpuRenderer::shadowMarch(const Vector3& p, const Vector3& normal, const bool uncached) const {
+    // Same constants as shadowRay() in the shader
+    constexpr double shadowBias = 0.02;
+    constexpr double shadowEps = 0.005;
+    constexpr double maxShadowDist = 100.0;
+    constexpr int maxShadowSteps = 64;
+
+    const Vector3 lightDir = light.normalized();
+    const Vector3 origin = p + normal * shadowBias + lightDir * shadowBias;
+    double travelled = shadowBias * 2.0;
+
+    for (int i = 0; i < maxShadowSteps && travelled < maxShadowDist; ++i) {
+        const Vector3 q = origin + lightDir * travelled;
+        double d;
+        if (uncached) {
+            d = std::numeric_limits<double>::infinity();
+            for (Object* object : shadowCache.uncached()) d = std::min(d, object->distanceToSurface(q));
+        } else {
+            d = scene.distanceToClosest(q).first;
+        }
+        if (d < shadowEps) return 0.0f;
+        travelled += std::max(d, 0.02);
+    }
+    return 1.0f;
+}
+
+Vector3 CpuRenderer::shadePoint(const int material, const Vector3& p, const Vector3& normal, const Vector3& view, const float lit,
+                                const Object* object, const double width) const {
+    // Secondary rays carry no differentials; the pixel cone stands in for them
+    Vector3 dpdx, dpdy;
+    tangentsOf(normal, width, dpdx, dpdy);
+    return phong(baseColor(static_cast<MaterialId>(material), object, p, normal, dpdx, dpdy), normal, view, light.normalized(), lit);
+}
+
+Vector3 CpuRenderer::shadeRay(const Vector3& origin, const Vector3& dir, const Vector3& dx, const Vector3& dy, const long tile) const {
+    SdfSample hit;
+    const double t = march(origin, dir, hit, 0.0, tile);
+    if (!hit.leaf) return SKY;
+    const Vector3 p = origin + dir * t;
+    Vector3 n;
+    float lit;
+    {
+        Lod::Scope lod(footprint(t));
+        n = surfaceNormal(hit, dir);
+        lit = shadow(p, n);
+    }
+
+    // Primary hit, with the differentials transferred to the hit plane as in the shading pass
+    const double facing = std::min(dir.dot(n), -0.05);
+    const Vector3 dpdx = (dx - dir * (dx.dot(n) / facing)) * t;
+    const Vector3 dpdy = (dy - dir * (dy.dot(n) / facing)) * t;
+    const auto material = static_cast<MaterialId>(hit.material);
+    Vector3 color = phong(baseColor(material, hit.object, p, n, dpdx, dpdy), n, dir * -1, light.normalized(), lit);
+
+    // Bounces as in the reflection pass
+    float reflectivity = scene.materials[material].reflectivity;
+    if (maxReflectionDepth <= 0 || reflectivity <= 0.001f) return color;
+    auto weight = static_cast<float>(std::clamp(reflectivity, 0.0f, 1.0f) * REFLECTION_STRENGTH);
+    float throughput = 1.0f;
+    Vector3 rayOrigin = p + n * REFLECTION_BIAS, rayDir = reflect(dir, n).normalized();
+    for (int bounce = 0; bounce < maxReflectionDepth; ++bounce) {
+        SdfSample bounceHit;
+        const double bounceT = march(rayOrigin, rayDir, bounceHit, t);
+        if (!bounceHit.leaf) {
+            color += SKY * weight;
+            break;
+        }
+        const Vector3 q = rayOrigin + rayDir * bounceT;
+        const double width = footprint(t + (q - p).magnitude());
+        Vector3 bounceNormal;
+        float visibility;
+        {
+            Lod::Scope lod(width);
+            bounceNormal = surfaceNormal(bounceHit, rayDir);
+            visibility = shadow(q, bounceNormal);
+        }
+        color += shadePoint(bounceHit.material, q, bounceNormal, rayDir * -1, visibility, bounceHit.object, width) * weight;
+
+        if (bounce + 1 == maxReflectionDepth) break;
+        reflectivity = std::clamp(scene.materials[static_cast<MaterialId>(bounceHit.material)].reflectivity, 0.0f, 1.0f);
+        throughput *= reflectivity;
+        if (throughput < 0.01f) break;
+        weight *= reflectivity;
+        rayOrigin = q + bounceNormal * REFLECTION_BIAS;
+        rayDir = reflect(rayDir, bounceNormal).normalized();
+    }
+    return color;
+}
+
+Vector3 CpuRenderer::baseColor(const MaterialId material, const Object* object, const Vector3& p, const Vector3& normal,
+                               const Vector3& dpdx, const Vector3& dpdy) const {
+    double u, v;
+    const MipTexture* texture = material < materialTextures.size() ? materialTextures[material] : nullptr;
+    if (texture && object && surfaceUV(object, p, normal, u, v)) {
+        // UV derivatives by mapping the corners of the footprint as well
+        double ux, vx, uy, vy;
+        surfaceUV(object, p + dpdx, normal, ux, vx);
+        surfaceUV(object, p + dpdy, normal, uy, vy);
+        const MipTexture::Rgba c = texture->sample(u, v, wrappedDelta(ux, u), wrappedDelta(vx, v), wrappedDelta(uy, u), wrappedDelta(vy, v));
+        return {c.r, c.g, c.b};
+    }
+    const sf::Color c = scene.materials[material].colorAt(p);
+    return {c.r / 255.0, c.g / 255.0, c.b / 255.0};
+}
+
+void CpuRenderer::loadTextures() {
+    materialTextures.assign(scene.materials.size(), nullptr);
+    for (std::size_t m = 0; m < scene.materials.size(); ++m) {
+        const std::string& path = scene.materials[static_cast<MaterialId>(m)].texture;
+        if (path.empty()) continue;
+        auto [it, inserted] = textures.try_emplace(path);
+        if (inserted) {
+            // Same path variations as TextureResidency
+            sf::Image image;
+            for (const std::string& tryPath : {path, "../" + path, "./" + path}) {
+                if (image.loadFromFile(tryPath)) {
+                    it->second = MipTexture(image);
+                    break;
+                }
+            }
+        }
+        if (!it->second.empty()) materialTextures[m] = &it->second;
+    }
+}
+
+void CpuRenderer::render(const CameraBasis& camera, const unsigned width, const unsigned height, std::vector<std::uint8_t>& rgba) {
+    renderRegion(camera, width, height, 0, 0, width, height, rgba);
+}
+
+void CpuRenderer::renderRegion(const CameraBasis& camera, const unsigned frameWidth, const unsigned frameHeight,
+                               const unsigned x0, const unsigned y0, const unsigned width, const unsigned height,
+                               std::vector<std::uint8_t>& rgba) {
+    prepare(frameHeight);
+    gbufferPass(camera, frameWidth, frameHeight, x0, y0, width, height);
+    binHits();
+    shadowPass();
+    shadingPass();
+    reflectionPass();
+    edgePass();
+    resolve(rgba);
+}
+
+void CpuRenderer::prepare(const unsigned frameHeight) {
+    pixelAngle = frameHeight > 0 ? Lod::pixelAngle(fov, frameHeight) : 0.0;
+    if (useShadowCache) shadowCache.update(scene.objects, light, scene.staticVersion());
+    if (useGrid) grid.update();
+    loadTextures();
+}
+
+void CpuRenderer::gbufferPass(const CameraBasis& camera, const unsigned frameWidth, const unsigned frameHeight,
+                              const unsigned x0, const unsigned y0, const unsigned width, const unsigned height) {
+    gbuffer.resizeRegion(frameWidth, frameHeight, x0, y0, width, height);
+    gbuffer.camera = camera;
+    gbuffer.fov = fov;
+
+    if (useScreenBins) {
+        binBounds.resize(scene.objects.size());
+        for (std::size_t k = 0; k < scene.objects.size(); ++k) binBounds[k] = scene.bounds[scene.idOf(scene.objects[k])];
+        screenBins.build(binBounds, camera, frameWidth, frameHeight, fov, x0, y0, width, height,
+                         hitEpsilon, Lod::hitEpsilon(0.0, footprint(1.0)));
+    }
+
+    parallelFor(height, [&](std::size_t y0, std::size_t y1) {
+        for (std::size_t y = y0; y < y1; ++y) {
+            for (unsigned x = 0; x < width; ++x) {
+                const std::size_t i = y * width + x;
+                const Vector3 dir = gbuffer.rayDir(i);
+                const long tile = useScreenBins ? static_cast<long>(screenBins.tileAt(x, static_cast<unsigned>(y))) : -1;
+                SdfSample hit;
+                double t = march(camera.o, dir, hit, 0.0, tile);
+                if (!hit.leaf) continue;
+                // Normals see the same level of detail as the march that found the hit
+                Lod::Scope lod(footprint(t));
+                gbuffer.depth[i] = static_cast<float>(t);
+                gbuffer.object[i] = hit.object->id;
+                gbuffer.normal[i] = encodeOctahedral(surfaceNormal(hit, dir));
+                gbuffer.material[i] = static_cast<std::uint16_t>(hit.material);
+            }
+        }
+    });
+}
+
+void CpuRenderer::binHits() {
+    // Counting sort of the hit pixels by material; sky pixels never enter the queue
+    const std::size_t pixels = gbuffer.size();
+    const std::size_t materialCount = scene.materials.size();
+    bins.assign(materialCount + 1, 0);
+    for (std::size_t i = 0; i < pixels; ++i)
+        if (gbuffer.isHit(i)) ++bins[gbuffer.material[i] + 1];
+    for (std::size_t m = 0; m < materialCount; ++m) bins[m + 1] += bins[m];
+    hitPixel.resize(bins[materialCount]);
+    std::vector<std::uint32_t> cursor(bins.begin(), bins.end() - 1);
+    for (std::size_t i = 0; i < pixels; ++i)
+        if (gbuffer.isHit(i)) hitPixel[cursor[gbuffer.material[i]]++] = static_cast<std::uint32_t>(i);
+}
+
+void CpuRenderer::shadowPass() {
+    shadowing.assign(gbuffer.size(), 1.0f);
+    parallelFor(hitPixel.size(), [&](std::size_t h0, std::size_t h1) {
+        for (std::size_t h = h0; h < h1; ++h) {
+            const std::uint32_t i = hitPixel[h];
+            Lod::Scope lod(footprint(gbuffer.depth[i]));
+            shadowing[i] = shadow(gbuffer.position(i), gbuffer.normalAt(i));
+        }
+    }, 1024);
+}
+
+void CpuRenderer::shadingPass() {
+    const std::size_t pixels = gbuffer.size();
+    colorR.assign(pixels, static_cast<float>(SKY.getX()));
+    colorG.assign(pixels, static_cast<float>(SKY.getY()));
+    colorB.assign(pixels, static_cast<float>(SKY.getZ()));
+
+    // Material-independent lighting terms, folded with the shadow pass result
+    const std::size_t hitCount = hitPixel.size();
+    diffuseTerm.resize(hitCount);
+    specularTerm.resize(hitCount);
+    const Vector3 lightDir = light.normalized();
+    parallelFor(hitCount, [&](std::size_t h0, std::size_t h1) {
+        for (std::size_t h = h0; h < h1; ++h) {
+            const std::uint32_t i = hitPixel[h];
+            const Vector3 n = gbuffer.normalAt(i);
+            const Vector3 view = gbuffer.rayDir(i) * -1;
+            const double lambert = std::max(n.dot(lightDir), 0.0);
+            const double specular = std::pow(std::max(view.dot(reflect(lightDir * -1, n)), 0.0), 32.0);
+            diffuseTerm[h] = static_cast<float>(0.2 + 0.6 * lambert * shadowing[i]);
+            specularTerm[h] = static_cast<float>(0.2 * specular * shadowing[i]);
+        }
+    }, 1024);
+
+    // One tight loop per material bin
+    for (std::size_t m = 0; m + 1 < bins.size(); ++m) {
+        const std::size_t begin = bins[m], end = bins[m + 1];
+        if (begin == end) continue;
+        const Material& material = scene.materials[static_cast<MaterialId>(m)];
+
+        if (materialTextures[m]) {
+            // Textured: the primary ray differentials give each pixel's footprint on the surface
+            parallelFor(end - begin, [&](std::size_t h0, std::size_t h1) {
+                for (std::size_t h = begin + h0; h < begin + h1; ++h) {
+                    const std::uint32_t i = hitPixel[h];
+                    const Vector3 dir = gbuffer.rayDir(i);
+                    const Vector3 n = gbuffer.normalAt(i);
+                    Vector3 dx, dy;
+                    gbuffer.rayDifferentials(i, dx, dy);
+                    // Transfer to the hit plane: dP = t dD + dt D with dt = -t (dD . n) / (D . n)
+                    const double t = gbuffer.depth[i];
+                    const double facing = std::min(dir.dot(n), -0.05);
+                    const Vector3 dpdx = (dx - dir * (dx.dot(n) / facing)) * t;
+                    const Vector3 dpdy = (dy - dir * (dy.dot(n) / facing)) * t;
+                    const Vector3 c = baseColor(static_cast<MaterialId>(m), scene.all[gbuffer.object[i]], gbuffer.position(i), n, dpdx, dpdy);
+                    colorR[i] = static_cast<float>(c.getX()) * diffuseTerm[h] + specularTerm[h];
+                    colorG[i] = static_cast<float>(c.getY()) * diffuseTerm[h] + specularTerm[h];
+                    colorB[i] = static_cast<float>(c.getZ()) * diffuseTerm[h] + specularTerm[h];
+                }
+            }, 256);
+        } else if (material.bake == Material::Bake::None && !material.procedural) {
+            const float r = material.baseColor.r / 255.0f;
+            const float g = material.baseColor.g / 255.0f;
+            const float b = material.baseColor.b / 255.0f;
+            for (std::size_t h = begin; h < end; ++h) {
+                const std::uint32_t i = hitPixel[h];
+                colorR[i] = r * diffuseTerm[h] + specularTerm[h];
+                colorG[i] = g * diffuseTerm[h] + specularTerm[h];
+                colorB[i] = b * diffuseTerm[h] + specularTerm[h];
+            }
+        } else {
+            for (std::size_t h = begin; h < end; ++h) {
+                const std::uint32_t i = hitPixel[h];
+                const sf::Color c = material.colorAt(gbuffer.position(i));
+                colorR[i] = c.r / 255.0f * diffuseTerm[h] + specularTerm[h];
+                colorG[i] = c.g / 255.0f * diffuseTerm[h] + specularTerm[h];
+                colorB[i] = c.b / 255.0f * diffuseTerm[h] + specularTerm[h];
+            }
+        }
+    }
+}
+
+void CpuRenderer::reflectionPass() {
+    if (maxReflectionDepth <= 0) return;
+
+    // Only reflective hits spawn a ray; the material bins let us skip the others wholesale
+    rays.clear();
+    for (std::size_t m = 0; m + 1 < bins.size(); ++m) {
+        const float reflectivity = scene.materials[static_cast<MaterialId>(m)].reflectivity;
+        if (reflectivity <= 0.001f) continue;
+        const auto strength = static_cast<float>(std::clamp(reflectivity, 0.0f, 1.0f) * REFLECTION_STRENGTH);
+        for (std::size_t h = bins[m]; h < bins[m + 1]; ++h) {
+            const std::uint32_t i = hitPixel[h];
+            const Vector3 n = gbuffer.normalAt(i);
+            rays.push(gbuffer.position(i) + n * REFLECTION_BIAS, reflect(gbuffer.rayDir(i), n).normalized(), i, 1.0f, strength);
+        }
+    }
+
+    for (int bounce = 0; bounce < maxReflectionDepth && !rays.empty(); ++bounce) {
+        // March stage, over rays binned by direction and origin
+        rays.sortCoherent();
+        rays.prepareOutputs();
+        parallelFor(rays.size(), [&](std::size_t r0, std::size_t r1) {
+            for (std::size_t r = r0; r < r1; ++r) {
+                // The primary hit distance stands in for the path length before this bounce
+                rays.t[r] = march(rays.origin[r], rays.dir[r], rays.hit[r], gbuffer.depth[rays.pixel[r]]);
+            }
+        }, 64);
+
+        // Compaction: misses resolve to sky here, hits move on
+        hits.clear();
+        for (std::size_t r = 0; r < rays.size(); ++r) {
+            const std::uint32_t i = rays.pixel[r];
+            if (!rays.hit[r].leaf) {
+                colorR[i] += static_cast<float>(SKY.getX()) * rays.weight[r];
+                colorG[i] += static_cast<float>(SKY.getY()) * rays.weight[r];
+                colorB[i] += static_cast<float>(SKY.getZ()) * rays.weight[r];
+                continue;
+            }
+            hits.push(rays.origin[r] + rays.dir[r] * rays.t[r], rays.dir[r], i, rays.throughput[r], rays.weight[r]);
+            hits.hit.push_back(rays.hit[r]);
+        }
+        hits.normal.resize(hits.size());
+        hits.visibility.resize(hits.size());
+
+        // Shadow stage
+        parallelFor(hits.size(), [&](std::size_t h0, std::size_t h1) {
+            for (std::size_t h = h0; h < h1; ++h) {
+                Lod::Scope lod(footprint(gbuffer.depth[hits.pixel[h]] + (hits.origin[h] - gbuffer.position(hits.pixel[h])).magnitude()));
+                hits.normal[h] = surfaceNormal(hits.hit[h], hits.dir[h]);
+                hits.visibility[h] = shadow(hits.origin[h], hits.normal[h]);
+            }
+        }, 256);
+
+        // Shade stage; every queue entry owns a distinct pixel
+        parallelFor(hits.size(), [&](std::size_t h0, std::size_t h1) {
+            for (std::size_t h = h0; h < h1; ++h) {
+                const std::uint32_t i = hits.pixel[h];
+                const double width = footprint(gbuffer.depth[i] + (hits.origin[h] - gbuffer.position(i)).magnitude());
+                const Vector3 c = shadePoint(hits.hit[h].material, hits.origin[h], hits.normal[h], hits.dir[h] * -1, hits.visibility[h],
+                                             hits.hit[h].object, width);
+                colorR[i] += static_cast<float>(c.getX()) * hits.weight[h];
+                colorG[i] += static_cast<float>(c.getY()) * hits.weight[h];
+                colorB[i] += static_cast<float>(c.getZ()) * hits.weight[h];
+            }
+        }, 256);
+
+        // Reflect stage: only reflective hits carry on to the next bounce
+        rays.clear();
+        if (bounce + 1 == maxReflectionDepth) break;
+        for (std::size_t h = 0; h < hits.size(); ++h) {
+            const float reflectivity = std::clamp(scene.materials[static_cast<MaterialId>(hits.hit[h].material)].reflectivity, 0.0f, 1.0f);
+            const float throughput = hits.throughput[h] * reflectivity;
+            if (throughput < 0.01f) continue;
+            const Vector3& n = hits.normal[h];
+            rays.push(hits.origin[h] + n * REFLECTION_BIAS, reflect(hits.dir[h], n).normalized(),
+                      hits.pixel[h], throughput, hits.weight[h] * reflectivity);
+        }
+    }
+}
+
+void CpuRenderer::edgePass() {
+    edgePixels.clear();
+    edgeRays = 0;
+    if (edgeSamples == 0) return;
+    const unsigned width = gbuffer.width, height = gbuffer.height;
+
+    // What the region grown by one pixel shows: the G-buffer inside, probe rays through the
+    // ring around it, so edges along tile borders are found as in the whole frame
+    const unsigned keysWidth = width + 2, keysHeight = height + 2;
+    std::vector<EdgeKey> keys(std::size_t(keysWidth) * keysHeight);
+    for (std::size_t i = 0; i < gbuffer.size(); ++i) {
+        EdgeKey& key = keys[(i / width + 1) * keysWidth + i % width + 1];
+        key.object = gbuffer.object[i];
+        key.depth = gbuffer.depth[i];
+        if (gbuffer.isHit(i)) key.normal = gbuffer.normalAt(i);
+    }
+    std::vector<std::uint32_t> ring;
+    for (unsigned ky = 0; ky < keysHeight; ++ky) {
+        for (unsigned kx = 0; kx < keysWidth; kx += (ky == 0 || ky + 1 == keysHeight || kx + 1 == keysWidth) ? 1 : keysWidth - 1) {
+            const long fx = static_cast<long>(gbuffer.originX + kx) - 1, fy = static_cast<long>(gbuffer.originY + ky) - 1;
+            if (fx >= 0 && fy >= 0 && fx < static_cast<long>(gbuffer.frameWidth) && fy < static_cast<long>(gbuffer.frameHeight))
+                ring.push_back(ky * keysWidth + kx);
+        }
+    }
+    parallelFor(ring.size(), [&](std::size_t r0, std::size_t r1) {
+        for (std::size_t r = r0; r < r1; ++r) {
+            EdgeKey& key = keys[ring[r]];
+            const Vector3 dir = gbuffer.camera.pixelDir(gbuffer.originX + ring[r] % keysWidth - 1, gbuffer.originY + ring[r] / keysWidth - 1,
+                                                        gbuffer.frameWidth, gbuffer.frameHeight, fov);
+            SdfSample hit;
+            const double t = march(gbuffer.camera.o, dir, hit);
+            key.object = -1;
+            if (!hit.leaf) continue;
+            Lod::Scope lod(footprint(t));
+            key.object = hit.object->id;
+            key.depth = static_cast<float>(t);
+            key.normal = decodeOctahedral(encodeOctahedral(surfaceNormal(hit, dir)));  // as stored in the G-buffer
+        }
+    }, 64);
+
+    auto differs = [&](const EdgeKey& a, const EdgeKey& b) {
+        if (b.object == -2) return false;
+        if (a.object != b.object) return true;
+        if (a.object < 0) return false;
+        return std::abs(a.depth - b.depth) > edgeDepthRatio * std::min(a.depth, b.depth) || a.normal.dot(b.normal) < edgeNormalCos;
+    };
+    for (unsigned y = 0; y < height; ++y) {
+        for (unsigned x = 0; x < width; ++x) {
+            const std::size_t k = std::size_t(y + 1) * keysWidth + x + 1;
+            if (differs(keys[k], keys[k - 1]) || differs(keys[k], keys[k + 1]) ||
+                differs(keys[k], keys[k - keysWidth]) || differs(keys[k], keys[k + keysWidth]))
+                edgePixels.push_back(y * width + x);
+        }
+    }
+
+    // Edge pixels start from their centre ray and sample until the mean settles
+    const std::size_t edgeCount = edgePixels.size();
+    std::vector<Vector3> sum(edgeCount);
+    std::vector<unsigned> taken(edgeCount, 1);
+    std::vector<std::uint32_t> active(edgeCount);
+    for (std::size_t e = 0; e < edgeCount; ++e) {
+        const std::uint32_t i = edgePixels[e];
+        sum[e] = Vector3(colorR[i], colorG[i], colorB[i]);
+        active[e] = static_cast<std::uint32_t>(e);
+    }
+    const unsigned perPass = std::max(1u, edgeSamplesPerPass);
+    while (!active.empty()) {
+        for (const std::uint32_t e : active) edgeRays += std::min(perPass, edgeSamples + 1 - taken[e]);
+        std::vector<char> settled(active.size());
+        parallelFor(active.size(), [&](std::size_t a0, std::size_t a1) {
+            for (std::size_t a = a0; a < a1; ++a) {
+                const std::uint32_t e = active[a], i = edgePixels[e];
+                const unsigned x = i % width, y = i / width;
+                const long tile = useScreenBins ? static_cast<long>(screenBins.tileAt(x, y)) : -1;
+                const Vector3 centre = gbuffer.rayDir(i);
+                Vector3 dx, dy;
+                gbuffer.rayDifferentials(i, dx, dy);
+
+                const Vector3 before = sum[e] / taken[e];
+                const unsigned count = std::min(perPass, edgeSamples + 1 - taken[e]);
+                for (unsigned k = taken[e]; k < taken[e] + count; ++k) {
+                    double jx, jy;
+                    subpixelOffset(k, jx, jy);
+                    sum[e] += shadeRay(gbuffer.camera.o, (centre + dx * jx + dy * jy).normalized(), dx, dy, tile);
+                }
+                taken[e] += count;
+                const Vector3 change = sum[e] / taken[e] - before;
+                // The first pass only says the centre ray was unrepresentative; stop on the second
+                settled[a] = taken[e] > edgeSamples ||
+                             (taken[e] > perPass + 1 && std::max({std::abs(change.getX()), std::abs(change.getY()), std::abs(change.getZ())}) < edgeTolerance);
+            }
+        }, 16);
+
+        std::size_t kept = 0;
+        for (std::size_t a = 0; a < active.size(); ++a)
+            if (!settled[a]) active[kept++] = active[a];
+        active.resize(kept);
+    }
+
+    for (std::size_t e = 0; e < edgeCount; ++e) {
+        const std::uint32_t i = edgePixels[e];
+        const Vector3 c = sum[e] / taken[e];
+        colorR[i] = static_cast<float>(c.getX());
+        colorG[i] = static_cast<float>(c.getY());
+        colorB[i] = static_cast<float>(c.getZ());
+    }
+}
+
+void CpuRenderer::resolve(std::vector<std::uint8_t>& rgba) const {
+    const std::size_t pixels = gbuffer.size();
+    rgba.resize(pixels * 4);
+    for (std::size_t i = 0; i < pixels; ++i) {
+        rgba[i * 4 + 0] = toByte(colorR[i]);
+        rgba[i * 4 + 1] = toByte(colorG[i]);
+        rgba[i * 4 + 2] = toByte(colorB[i]);
+        rgba[i * 4 + 3] = 255;
+    }
+}
@@ -0,0 +1,131 @@
+#ifndef RENDERING_PROJECT_CPURENDERER_H
+#define RENDERING_PROJECT_CPURENDERER_H
+
+#include "CameraBasis.h"
+#include "EmptySpaceGrid.h"
+#include "GBuffer.h"
+#include "MipTexture.h"
+#include "RayQueue.h"
+#include "Scene.h"
+#include "ScreenBins.h"
+#include "ShadowCache.h"
+#include "Vector3.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Software counterpart of shaders/raymarch.frag, organised as wavefront stages:
+//   1. G-buffer pass  - march primary rays, store depth / object / normal / material
+//   2. hit binning    - compact hit pixels into one queue, sorted by material
+//   3. shadow pass    - cached light-space map for static geometry, shadow rays for the rest
+//   4. shading pass   - Phong, one tight loop per material bin
+//   5. reflection pass - per bounce: sort, march, shadow, shade and reflect ray queues
+//   6. edge pass      - optional anti-aliasing: extra sub-pixel rays at G-buffer edges only
+// Stages consume and produce compacted queues, so sky and non-reflective pixels drop
+// out as early as possible instead of being skipped inside a per-pixel loop.
+struct CpuRenderer {
+    Scene& scene;
+    Vector3 light;       // direction towards the light
+    double fov;          // vertical field of view, as in the shader
+
+    unsigned maxSteps = 512;
+    double hitEpsilon = 0.001;     // lower limit; the hit test widens with the pixel cone
+    bool useLod = true;            // pixel-footprint hit epsilon and fractal/terrain detail
+    double maxDistance = 2000.0;
+    int maxReflectionDepth = 2;
+
+    bool useShadowCache = true;
+    ShadowCache shadowCache;
+
+    bool useGrid = true;           // leap through empty cells instead of marching them
+    EmptySpaceGrid grid{scene};
+
+    bool useScreenBins = true;     // primary rays only evaluate the objects their tile can see
+    ScreenBins screenBins;
+
+    // Edge anti-aliasing. A pixel is on an edge when a neighbour shows another object (or
+    // the sky), lies more than edgeDepthRatio further or nearer, or turns its normal by more
+    // than acos(edgeNormalCos). Edge pixels take edgeSamplesPerPass sub-pixel rays at a time
+    // until their mean moves by less than edgeTolerance in a pass or they reach edgeSamples;
+    // the rest keep their single centre ray.
+    unsigned edgeSamples = 0;          // most extra rays per edge pixel, 0 = off
+    unsigned edgeSamplesPerPass = 4;
+    float edgeTolerance = 0.5f / 255;  // half an 8-bit step
+    double edgeDepthRatio = 0.05;
+    double edgeNormalCos = 0.9;
+
+    // Object textures, mip-mapped and loaded by path on first use; a file that cannot be
+    // read leaves an empty entry, and its objects keep their material color
+    std::map<std::string, MipTexture> textures;
+
+    GBuffer gbuffer;
+    std::vector<float> shadowing;              // per pixel, 1 = lit
+    std::vector<float> colorR, colorG, colorB; // linear color per pixel
+    std::vector<std::uint32_t> edgePixels;     // found by the last edge pass
+    std::uint64_t edgeRays = 0;                // sub-pixel rays the last edge pass traced
+
+    CpuRenderer(Scene& scene, const Vector3& light, double fov) : scene(scene), light(light), fov(fov) {}
+
+    // Renders into `rgba` (width * height * 4 bytes, top row first)
+    void render(const CameraBasis& camera, unsigned width, unsigned height, std::vector<std::uint8_t>& rgba);
+    // Renders only the width x height pixels at (x0, y0) of a frameWidth x frameHeight
+    // frame (a tile); `rgba` receives just that region, top row first
+    void renderRegion(const CameraBasis& camera, unsigned frameWidth, unsigned frameHeight,
+                      unsigned x0, unsigned y0, unsigned width, unsigned height, std::vector<std::uint8_t>& rgba);
+
+    // Brings the per-frame state (pixel footprint scale, shadow cache, empty-space grid,
+    // textures) up to date for a frame frameHeight pixels high; renderRegion does this itself
+    void prepare(unsigned frameHeight);
+    void gbufferPass(const CameraBasis& camera, unsigned frameWidth, unsigned frameHeight,
+                     unsigned x0, unsigned y0, unsigned width, unsigned height);
+    void binHits();
+    void shadowPass();
+    void shadingPass();
+    void reflectionPass();
+    void edgePass();
+    void resolve(std::vector<std::uint8_t>& rgba) const;
+
+    // Sphere-traces a ray; returns the hit distance and the sample at the hit
+    // (leaf, object, material), or -1 and a sample without a leaf on a miss.
+    // `cone` is the path length before origin (reflections), which widens the pixel footprint.
+    // A primary ray can pass its screenBins tile to only evaluate the objects listed there.
+    double march(const Vector3& origin, const Vector3& dir, SdfSample& hit, double cone = 0.0, long tile = -1) const;
+    // Width of a pixel's cone after `distance` along its path, 0 with LOD disabled
+    [[nodiscard]] double footprint(double distance) const { return useLod ? pixelAngle * distance : 0.0; }
+    // Unit normal at a hit, from its leaf alone; facing back along `dir` where the field is flat
+    static Vector3 surfaceNormal(const SdfSample& hit, const Vector3& dir);
+    // 1 if the light is visible from p, 0 if it is blocked
+    float shadow(const Vector3& p, const Vector3& normal) const;
+    // Shadow ray against the whole scene (uncached = false) or only what the cache does not cover
+    float shadowMarch(const Vector3& p, const Vector3& normal, bool uncached) const;
+    // Color of one primary ray, as the G-buffer, shadow, shading and reflection passes would
+    // give its pixel; dx and dy are its ray differentials, for texture filtering
+    [[nodiscard]] Vector3 shadeRay(const Vector3& origin, const Vector3& dir, const Vector3& dx, const Vector3& dy,
+                                   long tile = -1) const;
+    // Phong for a single point with a known light visibility (used for secondary hits).
+    // Textures on `object` are filtered over a pixel cone `width` wide at p.
+    Vector3 shadePoint(int material, const Vector3& p, const Vector3& normal, const Vector3& view, float lit,
+                       const Object* object = nullptr, double width = 0.0) const;
+    // Surface color of `object` at p: its material's texture, filtered over the patch spanned
+    // by dpdx and dpdy (the pixel's footprint on the surface), or the material color
+    [[nodiscard]] Vector3 baseColor(MaterialId material, const Object* object, const Vector3& p, const Vector3& normal,
+                                    const Vector3& dpdx, const Vector3& dpdy) const;
+
+private:
+    double pixelAngle = 0.0;  // set by render() from fov and height
+    // Hit pixels sorted by material; bins[m]..bins[m+1] is material m's range in hitPixel
+    std::vector<std::uint32_t> hitPixel;
+    std::vector<std::uint32_t> bins;
+    std::vector<float> diffuseTerm, specularTerm;  // per hit, in bin order
+    std::vector<BoundingSphere> binBounds;         // top-level bounds handed to screenBins
+    std::vector<const MipTexture*> materialTextures;  // by MaterialId, null = untextured
+    RayQueue rays, hits;                           // reflection wavefront
+
+    // Loads the textures of materials that gained one and refreshes materialTextures
+    void loadTextures();
+};
+
+
+#endif //RENDERING_PROJECT_CPURENDERER_H
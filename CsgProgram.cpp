@@ -0,0 +1,386 @@
+#include "CsgProgram.h"
+
+#include "Objects/Sphere.h"
+#include "Objects/Plane.h"
+#include "Objects/Box.h"
+#include "Objects/Cylinder.h"
+#include "Objects/Capsule.h"
+#include "Objects/Torus.h"
+#include "Objects/Mandelbulb.h"
+#include "Objects/QuaternionJulia.h"
+#include "CSGoperations/Union.h"
+#include "CSGoperations/Intersection.h"
+#include "CSGoperations/Difference.h"
+#include "CSGoperations/Repetition.h"
+#include "CSGoperations/Transform.h"
+#include "Lod.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+
+namespace {
+    sf::Glsl::Vec4 vec4(const Vector3& v, double w = 0.0) {
+        return {static_cast<float>(v.getX()), static_cast<float>(v.getY()), static_cast<float>(v.getZ()), static_cast<float>(w)};
+    }
+
+    Vector3 xyz(const sf::Glsl::Vec4& v) { return Vector3(v.x, v.y, v.z); }
+
+    double length(double x, double y) { return std::sqrt(x * x + y * y); }
+
+    // The two fractal estimators below are ports of mandelbulbSDF / quaternionJuliaSDF
+    // in the shader, not of the CPU objects, so this interpreter matches the GPU
+    double mandelbulbSDF(const Vector3& p, const Vector3& center, double scale, double power, double iterations) {
+        const double distFromCenter = (p - center).magnitude();
+        const double boundingRadius = scale * 3.0;
+        if (distFromCenter > boundingRadius * 3.0) return distFromCenter - boundingRadius;
+
+        const Vector3 c = (p - center) / scale;
+        Vector3 z;
+        double dr = 1.0;
+        for (double i = 0.0; i < iterations; i += 1.0) {
+            double r = z.magnitude();
+            if (r > 2.0) break;
+            if (r < 1e-10) {
+                r = 1e-10;
+                z = Vector3(1e-10, 0, 0);
+            }
+            double theta = std::acos(std::clamp(z.getZ() / r, -1.0, 1.0));
+            double phi = std::atan2(z.getY(), z.getX());
+            dr = std::pow(r, power - 1.0) * power * dr + 1.0;
+            const double zr = std::pow(r, power);
+            theta *= power;
+            phi *= power;
+            z = Vector3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)) * zr + c;
+        }
+
+        const double r = std::max(z.magnitude(), 1e-10);
+        dr = std::max(dr, 1e-10);
+        double distance = 0.5 * std::log(r) * r / dr * scale;
+        if (distance < 0.0) distance = 0.0005;
+        if (distance < 0.0001) distance = 0.0001;
+        if (std::isnan(distance) || distance > 100.0) distance = 100.0;
+        return distance;
+    }
+
+    double juliaSDF(const Vector3& p, const Vector3& center, double scale, const Vector3& juliaC, double iterations) {
+        const double distFromCenter = (p - center).magnitude();
+        const double boundingRadius = scale * 2.0;
+        if (distFromCenter > boundingRadius * 3.0) return distFromCenter - boundingRadius;
+
+        Vector3 z = (p - center) / scale;
+        double dr = 1.0;
+        for (double i = 0.0; i < iterations; i += 1.0) {
+            double r = z.magnitude();
+            if (r > 2.0) break;
+            if (r < 1e-10) {
+                r = 1e-10;
+                z = Vector3(1e-10, 0, 0);
+            }
+            const double x = z.getX(), y = z.getY(), zz = z.getZ();
+            z = Vector3(x * x - y * y - zz * zz, 2.0 * x * y, 2.0 * x * zz) + juliaC;
+            dr = 2.0 * r * dr + 1.0;
+        }
+
+        const double r = std::max(z.magnitude(), 1e-10);
+        dr = std::max(dr, 1e-10);
+        double distance = 0.5 * std::log(r) * r / dr * scale;
+        if (distance < 0.0) distance = 0.0005;
+        if (distance < 0.0001) distance = 0.0001;
+        if (std::isnan(distance) || distance > 100.0) distance = 100.0;
+        return distance;
+    }
+}
+
+bool CsgProgram::isOperator(Object* object, Object*& a, Object*& b, Op& op) {
+    if (auto* u = dynamic_cast<Union*>(object)) { a = u->getA(); b = u->getB(); op = Op::Union; return true; }
+    if (auto* i = dynamic_cast<Intersection*>(object)) { a = i->getA(); b = i->getB(); op = Op::Intersection; return true; }
+    if (auto* d = dynamic_cast<Difference*>(object)) { a = d->getA(); b = d->getB(); op = Op::Difference; return true; }
+    return false;
+}
+
+int CsgProgram::stackNeed(Object* object) {
+    // Sethi-Ullman number: evaluating the hungrier operand first keeps the stack shallow
+    if (auto* rep = dynamic_cast<Repetition*>(object)) return stackNeed(rep->getChild());
+    if (auto* tr = dynamic_cast<Transform*>(object)) return stackNeed(tr->getChild());
+    Object *a, *b;
+    Op op;
+    if (!isOperator(object, a, b, op)) return 1;
+    const int na = stackNeed(a), nb = stackNeed(b);
+    return na == nb ? na + 1 : std::max(na, nb);
+}
+
+int CsgProgram::domainNeed(Object* object) {
+    if (auto* rep = dynamic_cast<Repetition*>(object)) return 1 + domainNeed(rep->getChild());
+    if (auto* tr = dynamic_cast<Transform*>(object)) return 1 + domainNeed(tr->getChild());
+    Object *a, *b;
+    Op op;
+    if (!isOperator(object, a, b, op)) return 0;
+    return std::max(domainNeed(a), domainNeed(b));
+}
+
+unsigned CsgProgram::push(const Op op, const float a, const float b, const float c) {
+    const unsigned index = size();
+    rows.emplace_back(static_cast<float>(op), a, b, c);
+    for (unsigned r = 1; r < ROWS_PER_INSTRUCTION; ++r) rows.emplace_back(0.f, 0.f, 0.f, 0.f);
+    return index;
+}
+
+bool CsgProgram::append(Object* root, unsigned& begin, unsigned& end) {
+    const std::size_t rollback = rows.size();
+    begin = size();
+    if (stackNeed(root) > static_cast<int>(MAX_STACK) || domainNeed(root) > static_cast<int>(MAX_DOMAINS)
+        || !emit(root, true) || size() > MAX_INSTRUCTIONS) {
+        rows.erase(rows.begin() + static_cast<std::ptrdiff_t>(rollback), rows.end());
+        return false;
+    }
+    end = size();
+    return true;
+}
+
+bool CsgProgram::emit(Object* object, const bool boundable) {
+    Object *a, *b;
+    Op op;
+    const bool isNode = isOperator(object, a, b, op);
+    auto* repetition = dynamic_cast<Repetition*>(object);
+    auto* transform = dynamic_cast<Transform*>(object);
+    const bool fractal = dynamic_cast<Mandelbulb*>(object) || dynamic_cast<QuaternionJulia*>(object);
+
+    // Guard subtrees and expensive leaves with their bounding sphere
+    const BoundingSphere bounds = object->getBounds();
+    unsigned bound = MAX_INSTRUCTIONS;
+    if (boundable && bounds.isBounded() && (isNode || repetition || transform || fractal)) {
+        bound = push(Op::Bound, static_cast<float>(bounds.radius));
+        rows[bound * ROWS_PER_INSTRUCTION + 1] = vec4(bounds.center);
+    }
+    const unsigned first = size();
+
+    if (isNode) {
+        const bool swap = stackNeed(b) > stackNeed(a);
+        // Nothing below a subtrahend may be replaced by a lower bound
+        const bool boundA = boundable;
+        const bool boundB = boundable && op != Op::Difference;
+        const bool ok = swap ? emit(b, boundB) && emit(a, boundA) : emit(a, boundA) && emit(b, boundB);
+        if (!ok) return false;
+        if (swap && op == Op::Difference) op = Op::DifferenceReversed;
+        push(op);
+    } else if (repetition) {
+        // Folds p into one cell for the child, restored by EndRepeat
+        const unsigned i = push(Op::Repeat);
+        const Vector3& l = repetition->limit;
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(repetition->spacing);
+        rows[i * ROWS_PER_INSTRUCTION + 2] = vec4(Vector3(std::min(l.getX(), UNLIMITED), std::min(l.getY(), UNLIMITED), std::min(l.getZ(), UNLIMITED)));
+        if (!emit(repetition->getChild(), boundable)) return false;
+        push(Op::EndRepeat);
+    } else if (transform) {
+        const unsigned i = push(Op::Transform, static_cast<float>(transform->scale));
+        const Matrix3 inverse = transform->getRotation().transposed();
+        const Vector3& t = transform->translation;
+        const double tw[3] = {t.getX(), t.getY(), t.getZ()};
+        for (int r = 0; r < 3; ++r) {
+            rows[i * ROWS_PER_INSTRUCTION + 1 + r] = vec4(Vector3(inverse.m[r][0], inverse.m[r][1], inverse.m[r][2]), tw[r]);
+        }
+        if (!emit(transform->getChild(), boundable)) return false;
+        push(Op::EndTransform, static_cast<float>(transform->scale));
+    } else if (!emitLeaf(object)) {
+        return false;
+    }
+
+    if (bound != MAX_INSTRUCTIONS) {
+        // Jump target, and the first leaf of the subtree as the leaf reported when it is skipped
+        unsigned leaf = first;
+        while (rows[leaf * ROWS_PER_INSTRUCTION].x >= static_cast<float>(Op::Union)) ++leaf;
+        rows[bound * ROWS_PER_INSTRUCTION].z = static_cast<float>(size());
+        rows[bound * ROWS_PER_INSTRUCTION].w = static_cast<float>(leaf);
+    }
+    return size() <= MAX_INSTRUCTIONS;
+}
+
+bool CsgProgram::emitLeaf(Object* object) {
+    unsigned i;
+    if (auto* s = dynamic_cast<Sphere*>(object)) {
+        i = push(Op::Sphere, static_cast<float>(s->radius));
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(s->center);
+    } else if (auto* pl = dynamic_cast<Plane*>(object)) {
+        i = push(Op::Plane);
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(pl->point);
+        rows[i * ROWS_PER_INSTRUCTION + 2] = vec4(pl->normal);
+    } else if (auto* bx = dynamic_cast<Box*>(object)) {
+        i = push(Op::Box);
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(bx->center);
+        rows[i * ROWS_PER_INSTRUCTION + 2] = vec4(bx->halfSize);
+    } else if (auto* cy = dynamic_cast<Cylinder*>(object)) {
+        i = push(Op::Cylinder, static_cast<float>(cy->radius), static_cast<float>(cy->halfHeight));
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(cy->center);
+    } else if (auto* ca = dynamic_cast<Capsule*>(object)) {
+        i = push(Op::Capsule, static_cast<float>(ca->radius));
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(ca->a);
+        rows[i * ROWS_PER_INSTRUCTION + 2] = vec4(ca->b);
+    } else if (auto* t = dynamic_cast<Torus*>(object)) {
+        i = push(Op::Torus, static_cast<float>(t->majorR), static_cast<float>(t->minorR));
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(t->center);
+    } else if (auto* mb = dynamic_cast<Mandelbulb*>(object)) {
+        i = push(Op::Mandelbulb, static_cast<float>(mb->scale), static_cast<float>(mb->power), static_cast<float>(mb->iterations));
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(mb->center);
+    } else if (auto* qj = dynamic_cast<QuaternionJulia*>(object)) {
+        i = push(Op::Julia, static_cast<float>(qj->scale), static_cast<float>(qj->iterations));
+        rows[i * ROWS_PER_INSTRUCTION + 1] = vec4(qj->center);
+        rows[i * ROWS_PER_INSTRUCTION + 2] = vec4(qj->c);
+    } else {
+        return false;  // e.g. Terrain: its parameters do not fit an instruction
+    }
+
+    const sf::Color c = object->getColorAtOrigin();
+    rows[i * ROWS_PER_INSTRUCTION + 3] = {c.r / 255.f, c.g / 255.f, c.b / 255.f, 1.f};
+    return true;
+}
+
+double CsgProgram::leafDistance(const unsigned instruction, const Vector3& p) const {
+    const sf::Glsl::Vec4& ins = rows[instruction * ROWS_PER_INSTRUCTION];
+    const Vector3 v1 = xyz(rows[instruction * ROWS_PER_INSTRUCTION + 1]);
+    const Vector3 v2 = xyz(rows[instruction * ROWS_PER_INSTRUCTION + 2]);
+
+    switch (static_cast<Op>(static_cast<int>(ins.x + 0.5f))) {
+        case Op::Sphere:
+            return (p - v1).magnitude() - ins.y;
+        case Op::Plane:
+            return (p - v1).dot(v2);
+        case Op::Box: {
+            const Vector3 q = p - v1;
+            const double dx = std::abs(q.getX()) - v2.getX(), dy = std::abs(q.getY()) - v2.getY(), dz = std::abs(q.getZ()) - v2.getZ();
+            return Vector3(std::max(dx, 0.0), std::max(dy, 0.0), std::max(dz, 0.0)).magnitude() + std::min(std::max(dx, std::max(dy, dz)), 0.0);
+        }
+        case Op::Cylinder: {
+            const Vector3 q = p - v1;
+            const double dx = length(q.getX(), q.getZ()) - ins.y, dy = std::abs(q.getY()) - ins.z;
+            return std::min(std::max(dx, dy), 0.0) + length(std::max(dx, 0.0), std::max(dy, 0.0));
+        }
+        case Op::Capsule: {
+            const Vector3 pa = p - v1, ba = v2 - v1;
+            const double h = std::clamp(pa.dot(ba) / ba.dot(ba), 0.0, 1.0);
+            return (pa - ba * h).magnitude() - ins.y;
+        }
+        case Op::Torus: {
+            const Vector3 q = p - v1;
+            return length(length(q.getX(), q.getZ()) - ins.y, q.getY()) - ins.z;
+        }
+        case Op::Mandelbulb:
+            return mandelbulbSDF(p, v1, ins.y, ins.z, Lod::fractalIterations(static_cast<int>(ins.w), ins.y, ins.z, Lod::footprint));
+        case Op::Julia:
+            return juliaSDF(p, v1, ins.y, v2, Lod::fractalIterations(static_cast<int>(ins.z), ins.y, 2.0, Lod::footprint));
+        default:
+            return 1e20;
+    }
+}
+
+Vector3 CsgProgram::fold(const unsigned instruction, const Vector3& p) const {
+    // Same arithmetic as the shader: axes with zero spacing are multiplied out
+    const sf::Glsl::Vec4& s = rows[instruction * ROWS_PER_INSTRUCTION + 1];
+    const sf::Glsl::Vec4& l = rows[instruction * ROWS_PER_INSTRUCTION + 2];
+    auto axis = [](double v, double spacing, double limit) {
+        const double cell = std::clamp(std::floor(v / std::max(spacing, 1e-9) + 0.5), -limit, limit);
+        return v - spacing * cell;
+    };
+    return Vector3(axis(p.getX(), s.x, l.x), axis(p.getY(), s.y, l.y), axis(p.getZ(), s.z, l.z));
+}
+
+double CsgProgram::maxDeviation(Object* root, const unsigned samples) {
+    CsgProgram program;
+    unsigned begin, end;
+    if (!program.append(root, begin, end)) return -1.0;
+
+    const BoundingSphere bounds = root->getBounds();
+    const Vector3 center = bounds.isBounded() ? bounds.center : Vector3();
+    const double radius = bounds.isBounded() ? bounds.radius * 1.25 : 20.0;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    double worst = 0.0;
+    auto compare = [&](const Vector3& p, const double exact) {
+        const double encoded = program.evaluate(begin, end, p).distance;
+        worst = std::max(worst, exact > BOUND_MARGIN ? encoded - exact : std::abs(encoded - exact));
+    };
+    for (unsigned i = 0; i < samples; ++i) {
+        Vector3 p = center + Vector3(unit(rng), unit(rng), unit(rng)) * radius;
+        double exact = root->distanceToSurface(p);
+        compare(p, exact);
+        // And where it matters most: near the surface, marching from there towards the centre
+        const double toCenter = (center - p).magnitude();
+        const Vector3 dir = (center - p) / toCenter;
+        double travelled = 0.0;
+        for (int step = 0; step < 256 && exact > 1e-4 && travelled + exact < toCenter; ++step) {
+            travelled += exact;
+            p += dir * exact;
+            exact = root->distanceToSurface(p);
+        }
+        compare(p, exact);
+    }
+    return worst;
+}
+
+CsgProgram::Result CsgProgram::evaluate(const unsigned begin, const unsigned end, const Vector3& point) const {
+    double stackD[MAX_STACK];
+    int stackL[MAX_STACK];
+    int sp = 0;
+    Vector3 domains[MAX_DOMAINS];
+    int dp = 0;
+    Vector3 p = point;
+
+    for (unsigned pc = begin; pc < end;) {
+        const sf::Glsl::Vec4& ins = rows[pc * ROWS_PER_INSTRUCTION];
+        const int op = static_cast<int>(ins.x + 0.5f);
+
+        if (op < static_cast<int>(Op::Union)) {
+            stackD[sp] = leafDistance(pc, p);
+            stackL[sp] = static_cast<int>(pc);
+            ++sp;
+            ++pc;
+        } else if (op == static_cast<int>(Op::Bound)) {
+            const double dist = (p - xyz(rows[pc * ROWS_PER_INSTRUCTION + 1])).magnitude() - ins.y;
+            if (dist > BOUND_MARGIN) {
+                stackD[sp] = dist;
+                stackL[sp] = static_cast<int>(ins.w + 0.5f);
+                ++sp;
+                pc = static_cast<unsigned>(ins.z + 0.5f);
+            } else {
+                ++pc;
+            }
+        } else if (op == static_cast<int>(Op::Repeat)) {
+            domains[dp++] = p;
+            p = fold(pc, p);
+            ++pc;
+        } else if (op == static_cast<int>(Op::EndRepeat)) {
+            p = domains[--dp];
+            ++pc;
+        } else if (op == static_cast<int>(Op::Transform)) {
+            const Vector3 r0 = xyz(rows[pc * ROWS_PER_INSTRUCTION + 1]);
+            const Vector3 r1 = xyz(rows[pc * ROWS_PER_INSTRUCTION + 2]);
+            const Vector3 r2 = xyz(rows[pc * ROWS_PER_INSTRUCTION + 3]);
+            const Vector3 q = p - Vector3(rows[pc * ROWS_PER_INSTRUCTION + 1].w, rows[pc * ROWS_PER_INSTRUCTION + 2].w, rows[pc * ROWS_PER_INSTRUCTION + 3].w);
+            domains[dp++] = p;
+            p = Vector3(r0.dot(q), r1.dot(q), r2.dot(q)) / ins.y;
+            ++pc;
+        } else if (op == static_cast<int>(Op::EndTransform)) {
+            p = domains[--dp];
+            stackD[sp - 1] *= ins.y;
+            ++pc;
+        } else {
+            --sp;
+            const double y = stackD[sp], x = stackD[sp - 1];
+            const int ly = stackL[sp], lx = stackL[sp - 1];
+            double d;
+            int leaf;
+            switch (static_cast<Op>(op)) {
+                case Op::Union: d = std::min(x, y); leaf = x < y ? lx : ly; break;
+                case Op::Intersection: d = std::max(x, y); leaf = x > y ? lx : ly; break;
+                // Carved faces keep the minuend's leaf, as Difference::sample does for materials
+                case Op::Difference: d = std::max(x, -y); leaf = lx; break;
+                case Op::DifferenceReversed: d = std::max(y, -x); leaf = ly; break;
+                default: d = x; leaf = lx; break;
+            }
+            stackD[sp - 1] = d;
+            stackL[sp - 1] = leaf;
+            ++pc;
+        }
+    }
+    return {stackD[0], stackL[0]};
+}
@@ -0,0 +1,79 @@
+#ifndef RENDERING_PROJECT_CSGPROGRAM_H
+#define RENDERING_PROJECT_CSGPROGRAM_H
+
+#include "Objects/Object.h"
+#include "Vector3.h"
+#include <SFML/Graphics/Glsl.hpp>
+#include <vector>
+
+
+// CSG trees flattened into postfix programs for the shader (u_csgProgram), plus a CPU
+// interpreter that mirrors csgDistance() in shaders/raymarch.frag instruction for
+// instruction, so the GPU encoding can be checked against Union/Intersection/Difference.
+//
+// Every instruction is ROWS_PER_INSTRUCTION vec4 rows:
+//   row 0: (op, a, b, c)   row 1, 2: op-specific vectors   row 3: leaf colour
+// Operands are pushed on a small stack; operators pop two values and push one. A Bound
+// instruction in front of a subtree skips it and pushes the distance to its bounding
+// sphere when the point is well outside it. Subtrees below a Difference's subtrahend are never
+// bounded: a lower bound turns into an overestimate once it is negated. Repeat folds p into
+// one grid cell for the instructions up to its EndRepeat, so a Repetition costs one child;
+// Transform maps p into the child's space (rows 1-3: inverse rotation, translation in w)
+// and EndTransform scales the child's distance back.
+class CsgProgram {
+public:
+    static constexpr unsigned ROWS_PER_INSTRUCTION = 4;
+    static constexpr unsigned MAX_INSTRUCTIONS = 64;  // MAX_CSG_ROWS / 4 in the shader
+    static constexpr unsigned MAX_STACK = 8;          // CSG_STACK in the shader
+    static constexpr unsigned MAX_DOMAINS = 4;        // CSG_DOMAINS in the shader: nested repetitions/transforms
+    static constexpr double UNLIMITED = 1e30;         // repetition limit standing in for infinity
+    // Bounds only skip points at least this far outside, so a skipped subtree never
+    // reports a distance small enough to count as a hit or to disturb normals
+    static constexpr double BOUND_MARGIN = 0.05;      // CSG_BOUND_MARGIN in the shader
+
+    enum class Op {
+        Sphere = 0, Plane = 1, Box = 2, Cylinder = 3, Capsule = 4, Torus = 5, Mandelbulb = 9, Julia = 11,
+        Union = 20, Intersection = 21, Difference = 22, DifferenceReversed = 23,
+        Bound = 30,
+        Repeat = 40, EndRepeat = 41,
+        Transform = 50, EndTransform = 51
+    };
+
+    struct Result {
+        double distance;
+        int leaf;  // instruction index of the leaf that produced the distance
+    };
+
+    std::vector<sf::Glsl::Vec4> rows;
+
+    void clear() { rows.clear(); }
+    [[nodiscard]] unsigned size() const { return static_cast<unsigned>(rows.size() / ROWS_PER_INSTRUCTION); }
+
+    // Appends the program for `root` and returns its instruction range [begin, end).
+    // Returns false (leaving the program unchanged) if the tree contains an object the
+    // shader cannot evaluate (Terrain, Instances), needs more than MAX_STACK slots or
+    // MAX_DOMAINS nested repetitions/transforms, or does not fit.
+    bool append(Object* root, unsigned& begin, unsigned& end);
+
+    // Runs instructions [begin, end) at p exactly as the shader does (in double precision)
+    [[nodiscard]] Result evaluate(unsigned begin, unsigned end, const Vector3& p) const;
+
+    // Encodes `root` on its own and returns the largest difference between evaluate() and
+    // root->distanceToSurface() over `samples` points in and around its bounds (or a 20-unit
+    // ball around the origin if unbounded); -1 if it cannot be encoded. Away from the surface
+    // a Bound may stand in with a smaller distance, which does not count. See --check-csg.
+    static double maxDeviation(Object* root, unsigned samples = 4096);
+
+private:
+    static bool isOperator(Object* object, Object*& a, Object*& b, Op& op);
+    static int stackNeed(Object* object);
+    static int domainNeed(Object* object);
+    bool emit(Object* object, bool boundable);
+    bool emitLeaf(Object* object);
+    unsigned push(Op op, float a = 0, float b = 0, float c = 0);
+    [[nodiscard]] double leafDistance(unsigned instruction, const Vector3& p) const;
+    [[nodiscard]] Vector3 fold(unsigned instruction, const Vector3& p) const;
+};
+
+
+#endif //RENDERING_PROJECT_CSGPROGRAM_H
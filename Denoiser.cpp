@@ -0,0 +1,184 @@
+#include "Denoiser.h"
+
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DENOISER_SSE2 1
+#endif
+
+
+namespace {
+    constexpr float KERNEL[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};  // B3 spline
+    constexpr int NORMAL_SQUARINGS = 7;  // normal weight is (n . nq)^(2^7)
+
+    float luma(const float r, const float g, const float b) {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+#ifdef DENOISER_SSE2
+    // exp(x) for x <= 0, to ~1e-7 relative: 2^(x log2 e) split into an exponent and a
+    // polynomial for the fraction
+    __m128 expNegative(__m128 x) {
+        x = _mm_max_ps(x, _mm_set1_ps(-87.0f));
+        const __m128 t = _mm_mul_ps(x, _mm_set1_ps(1.44269504f));
+        __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+        whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, t), _mm_set1_ps(1.0f)));  // floor
+        const __m128 f = _mm_sub_ps(t, whole);
+        __m128 p = _mm_set1_ps(1.333355814e-3f);
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.618129108e-3f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.550410866e-2f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.402265070e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.931471806e-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+        const __m128i bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(whole), _mm_set1_epi32(127)), 23);
+        return _mm_mul_ps(p, _mm_castsi128_ps(bits));
+    }
+#endif
+}
+
+void Denoiser::apply(const GBuffer& guide, std::vector<float>& r, std::vector<float>& g, std::vector<float>& b) {
+    const unsigned width = guide.width, height = guide.height;
+    const std::size_t pixels = guide.size();
+    if (pixels == 0 || iterations <= 0) return;
+
+    // Guides as planes; sky pixels get a zero normal, so they never take or give weight
+    depth.resize(pixels);
+    normalX.resize(pixels);
+    normalY.resize(pixels);
+    normalZ.resize(pixels);
+    object.resize(pixels);
+    parallelFor(pixels, [&](std::size_t i0, std::size_t i1) {
+        for (std::size_t i = i0; i < i1; ++i) {
+            const bool hit = guide.isHit(i);
+            const Vector3 n = hit ? guide.normalAt(i) : Vector3();
+            normalX[i] = static_cast<float>(n.getX());
+            normalY[i] = static_cast<float>(n.getY());
+            normalZ[i] = static_cast<float>(n.getZ());
+            depth[i] = hit ? guide.depth[i] : 0.0f;
+            object[i] = static_cast<float>(guide.object[i]);
+        }
+    }, 4096);
+    nextR.resize(pixels);
+    nextG.resize(pixels);
+    nextB.resize(pixels);
+    lum.resize(pixels);
+    colorScale.resize(pixels);
+    for (std::size_t i = 0; i < pixels; ++i) lum[i] = luma(r[i], g[i], b[i]);
+
+    // Noise estimate to start from: luminance variance over the 3x3 pixels of the same object
+    variance.resize(pixels);
+    nextVariance.resize(pixels);
+    parallelFor(height, [&](std::size_t y0, std::size_t y1) {
+        for (std::size_t y = y0; y < y1; ++y) {
+            for (unsigned x = 0; x < width; ++x) {
+                const std::size_t p = y * width + x;
+                float sum = 0.0f, sum2 = 0.0f, count = 0.0f;
+                for (std::size_t qy = y > 0 ? y - 1 : 0; qy <= std::min<std::size_t>(y + 1, height - 1); ++qy) {
+                    for (unsigned qx = x > 0 ? x - 1 : 0; qx <= std::min(x + 1, width - 1); ++qx) {
+                        const std::size_t q = qy * width + qx;
+                        if (object[q] != object[p]) continue;
+                        sum += lum[q];
+                        sum2 += lum[q] * lum[q];
+                        count += 1.0f;
+                    }
+                }
+                const float mean = sum / count;
+                variance[p] = std::max(0.0f, sum2 / count - mean * mean);
+            }
+        }
+    }, 16);
+
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        const int step = 1 << iteration;
+        if (iteration > 0)
+            for (std::size_t i = 0; i < pixels; ++i) lum[i] = luma(r[i], g[i], b[i]);
+        // Luminance differences are measured in standard deviations of the centre's noise
+        for (std::size_t i = 0; i < pixels; ++i) colorScale[i] = 1.0f / (colorSigma * std::sqrt(variance[i]) + 1e-4f);
+
+        parallelFor(height, [&](std::size_t y0, std::size_t y1) {
+            std::vector<float> accR(width), accG(width), accB(width), accW(width), accV(width);
+            for (std::size_t y = y0; y < y1; ++y) {
+                const std::size_t row = y * width;
+                const float centre = KERNEL[2] * KERNEL[2];
+                for (unsigned x = 0; x < width; ++x) {
+                    accR[x] = centre * r[row + x];
+                    accG[x] = centre * g[row + x];
+                    accB[x] = centre * b[row + x];
+                    accW[x] = centre;
+                    accV[x] = centre * centre * variance[row + x];
+                }
+
+                for (int ky = 0; ky < 5; ++ky) {
+                    const long qy = static_cast<long>(y) + (ky - 2) * step;
+                    if (qy < 0 || qy >= static_cast<long>(height)) continue;
+                    for (int kx = 0; kx < 5; ++kx) {
+                        if (kx == 2 && ky == 2) continue;
+                        const long dx = (kx - 2) * step;
+                        const float kernel = KERNEL[kx] * KERNEL[ky];
+                        const float distance = static_cast<float>(step) * std::sqrt(static_cast<float>((kx - 2) * (kx - 2) + (ky - 2) * (ky - 2)));
+                        const float depthScale = 1.0f / (depthSigma * distance);
+                        const long shift = (qy - static_cast<long>(y)) * static_cast<long>(width) + dx;  // tap index - centre index
+
+                        // Pixels whose tap lies inside the image
+                        const unsigned xBegin = static_cast<unsigned>(std::max(0L, -dx));
+                        const unsigned xEnd = static_cast<unsigned>(std::clamp(static_cast<long>(width) - dx, 0L, static_cast<long>(width)));
+                        unsigned x = xBegin;
+#ifdef DENOISER_SSE2
+                        const __m128 vKernel = _mm_set1_ps(kernel), vDepth = _mm_set1_ps(depthScale);
+                        const __m128 zero = _mm_setzero_ps(), signMask = _mm_set1_ps(-0.0f), minDepth = _mm_set1_ps(1e-3f);
+                        for (; x + 4 <= xEnd; x += 4) {
+                            const std::size_t p = row + x, q = p + shift;
+                            const __m128 dl = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(&lum[q]), _mm_loadu_ps(&lum[p])));
+                            const __m128 zp = _mm_loadu_ps(&depth[p]);
+                            const __m128 dz = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(&depth[q]), zp));
+                            const __m128 e = _mm_add_ps(_mm_mul_ps(dl, _mm_loadu_ps(&colorScale[p])),
+                                                        _mm_div_ps(_mm_mul_ps(dz, vDepth), _mm_max_ps(zp, minDepth)));
+                            __m128 nw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&normalX[p]), _mm_loadu_ps(&normalX[q])),
+                                                              _mm_mul_ps(_mm_loadu_ps(&normalY[p]), _mm_loadu_ps(&normalY[q]))),
+                                                   _mm_mul_ps(_mm_loadu_ps(&normalZ[p]), _mm_loadu_ps(&normalZ[q])));
+                            nw = _mm_max_ps(nw, zero);
+                            for (int k = 0; k < NORMAL_SQUARINGS; ++k) nw = _mm_mul_ps(nw, nw);
+                            const __m128 same = _mm_cmpeq_ps(_mm_loadu_ps(&object[p]), _mm_loadu_ps(&object[q]));
+                            const __m128 w = _mm_and_ps(same, _mm_mul_ps(_mm_mul_ps(vKernel, nw), expNegative(_mm_sub_ps(zero, e))));
+                            _mm_storeu_ps(&accR[x], _mm_add_ps(_mm_loadu_ps(&accR[x]), _mm_mul_ps(w, _mm_loadu_ps(&r[q]))));
+                            _mm_storeu_ps(&accG[x], _mm_add_ps(_mm_loadu_ps(&accG[x]), _mm_mul_ps(w, _mm_loadu_ps(&g[q]))));
+                            _mm_storeu_ps(&accB[x], _mm_add_ps(_mm_loadu_ps(&accB[x]), _mm_mul_ps(w, _mm_loadu_ps(&b[q]))));
+                            _mm_storeu_ps(&accW[x], _mm_add_ps(_mm_loadu_ps(&accW[x]), w));
+                            _mm_storeu_ps(&accV[x], _mm_add_ps(_mm_loadu_ps(&accV[x]), _mm_mul_ps(_mm_mul_ps(w, w), _mm_loadu_ps(&variance[q]))));
+                        }
+#endif
+                        for (; x < xEnd; ++x) {
+                            const std::size_t p = row + x, q = p + shift;
+                            if (object[p] != object[q]) continue;
+                            float nw = std::max(0.0f, normalX[p] * normalX[q] + normalY[p] * normalY[q] + normalZ[p] * normalZ[q]);
+                            for (int k = 0; k < NORMAL_SQUARINGS; ++k) nw *= nw;
+                            const float e = std::abs(lum[q] - lum[p]) * colorScale[p] + std::abs(depth[q] - depth[p]) * depthScale / std::max(depth[p], 1e-3f);
+                            const float w = kernel * nw * std::exp(-e);
+                            accR[x] += w * r[q];
+                            accG[x] += w * g[q];
+                            accB[x] += w * b[q];
+                            accW[x] += w;
+                            accV[x] += w * w * variance[q];
+                        }
+                    }
+                }
+
+                for (unsigned x = 0; x < width; ++x) {
+                    const float inv = 1.0f / accW[x];
+                    nextR[row + x] = accR[x] * inv;
+                    nextG[row + x] = accG[x] * inv;
+                    nextB[row + x] = accB[x] * inv;
+                    nextVariance[row + x] = accV[x] * inv * inv;
+                }
+            }
+        }, 8);
+
+        r.swap(nextR);
+        g.swap(nextG);
+        b.swap(nextB);
+        variance.swap(nextVariance);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef RENDERING_PROJECT_DENOISER_H
+#define RENDERING_PROJECT_DENOISER_H
+
+#include "GBuffer.h"
+#include <vector>
+
+
+// Edge-avoiding a-trous wavelet filter for noisy low-sample images (Dammertz et al. 2010,
+// with the variance-guided luminance weight of SVGF). Each iteration blurs with a 5x5
+// B3-spline kernel whose taps are spread 2^i pixels apart, so five iterations reach 125
+// pixels across at 25 taps a pixel each. A tap's weight drops with the difference from the
+// centre pixel in
+//   - object:    taps on another object (or the sky) are ignored outright
+//   - normal:    max(0, n . nq)^128
+//   - depth:     exp(-|z - zq| / (depthSigma * z * tap distance in pixels))
+//   - luminance: exp(-|l - lq| / (colorSigma * standard deviation of l))
+// so noise is averaged away within surfaces but edges and silhouettes stay sharp. The
+// luminance variance starts as that of each pixel's 3x3 neighbourhood and is filtered
+// along with the color, so the luminance weight tightens as the noise goes down.
+// The guides are the G-buffer of the same pixels. Rows are filtered in parallel, and the
+// taps of four neighbouring pixels are weighted at once with SSE2 where available.
+class Denoiser {
+public:
+    int iterations = 5;
+    float colorSigma = 3.0f;
+    float depthSigma = 0.1f;
+
+    // Filters the planar colors (guide.width x guide.height, top row first) in place
+    void apply(const GBuffer& guide, std::vector<float>& r, std::vector<float>& g, std::vector<float>& b);
+
+private:
+    // Guides decoded once per apply; object ids as floats (exact below 2^24)
+    std::vector<float> depth, normalX, normalY, normalZ, object;
+    std::vector<float> nextR, nextG, nextB;
+    std::vector<float> lum, variance, nextVariance, colorScale;
+};
+
+
+#endif //RENDERING_PROJECT_DENOISER_H
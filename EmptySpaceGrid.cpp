@@ -0,0 +1,300 @@
+#include "EmptySpaceGrid.h"
+
+#include "CSGoperations/Difference.h"
+#include "CSGoperations/Intersection.h"
+#include "CSGoperations/Transform.h"
+#include "CSGoperations/Union.h"
+#include "Objects/Capsule.h"
+#include "Objects/Cylinder.h"
+#include "Objects/Terrain.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+    constexpr double DOMAIN_MARGIN = 0.05;  // of the static bounds' extent, on every side
+    constexpr double NUDGE = 1e-3;          // of a cell, to step across a face
+    constexpr std::size_t BATCH = 256;      // cells per Object::distances call, small enough to stay in cache
+
+    double sphereBound(const BoundingSphere& b, const Vector3& c, const double halfDiagonal) {
+        return (c - b.center).magnitude() - b.radius - halfDiagonal;
+    }
+
+    // Distance along the ray to where it enters the sphere grown by margin; 0 if p is inside
+    double sphereEntry(const BoundingSphere& b, const Vector3& p, const Vector3& dir, const double margin) {
+        const Vector3 oc = p - b.center;
+        const double r = b.radius + margin;
+        const double c = oc.dot(oc) - r * r;
+        if (c <= 0.0) return 0.0;
+        const double half = oc.dot(dir);
+        const double disc = half * half - c;
+        if (half >= 0.0 || disc < 0.0) return std::numeric_limits<double>::infinity();
+        return -half - std::sqrt(disc);
+    }
+
+    // Exact SDFs and their unions, intersections, differences and rigid placements change
+    // by at most the distance moved (1-Lipschitz), which the centre-minus-diagonal bound needs
+    bool isExact(Object* object) {
+        if (dynamic_cast<Sphere*>(object) || dynamic_cast<Box*>(object) || dynamic_cast<Plane*>(object) ||
+            dynamic_cast<Torus*>(object) || dynamic_cast<Capsule*>(object) || dynamic_cast<Cylinder*>(object)) return true;
+        if (auto* u = dynamic_cast<Union*>(object)) return isExact(u->getA()) && isExact(u->getB());
+        if (auto* i = dynamic_cast<Intersection*>(object)) return isExact(i->getA()) && isExact(i->getB());
+        if (auto* d = dynamic_cast<Difference*>(object)) return isExact(d->getA()) && isExact(d->getB());
+        if (auto* t = dynamic_cast<Transform*>(object)) return isExact(t->getChild());
+        return false;
+    }
+}
+
+EmptySpaceGrid::EmptySpaceGrid(Scene& scene) : scene(scene) {
+    listener = scene.subscribe([this](const Object& object) {
+        if (!object.parent) changed.push_back(static_cast<ObjectId>(object.id));
+    });
+}
+
+EmptySpaceGrid::~EmptySpaceGrid() {
+    scene.unsubscribe(listener);
+}
+
+EmptySpaceGrid::Kind EmptySpaceGrid::kindOf(Object* object) {
+    if (dynamic_cast<Plane*>(object) || dynamic_cast<Terrain*>(object)) return Kind::HalfSpace;
+    if (isExact(object)) return Kind::Exact;
+    return object->getBounds().isBounded() ? Kind::Bounds : Kind::Unknown;
+}
+
+EmptySpaceGrid::HalfSpace EmptySpaceGrid::halfSpaceOf(Object* object) {
+    if (const auto* plane = dynamic_cast<const Plane*>(object)) return {plane->normal, plane->normal.dot(plane->point)};
+    // d = z - height, so nothing lies above the highest height the terrain can reach
+    return {Vector3(0, 0, 1), static_cast<const Terrain*>(object)->heightRange().second};
+}
+
+std::size_t EmptySpaceGrid::update() {
+    bool rebuild = !built || scene.objects.size() != builtCount;
+    for (std::size_t i = 0; i < scene.objects.size() && !rebuild; ++i) {
+        const Object* object = scene.objects[i];
+        rebuild = builtDynamic[scene.idOf(object)] != static_cast<std::uint8_t>(object->dynamic);
+    }
+
+    // Moving an unbounded object or leaving the domain changes too much to patch
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    std::erase_if(changed, [this](ObjectId id) {
+        return std::none_of(statics.begin(), statics.end(), [&](const Source& s) { return s.object->id == static_cast<int>(id); });
+    });
+    for (const ObjectId id : changed) {
+        const BoundingSphere& now = scene.bounds[id];
+        if (rebuild || !builtBounds[id].isBounded() || !now.isBounded()) { rebuild = true; break; }
+        const Aabb box = Aabb::around(now);
+        for (int a = 0; a < 3; ++a) rebuild = rebuild || box.lo[a] < domain.lo[a] || box.hi[a] > domain.hi[a];
+    }
+
+    if (rebuild) {
+        build();
+        return bounds.size();
+    }
+    std::size_t evaluated = 0;
+    if (enabled) {
+        for (const ObjectId id : changed) evaluated += refresh(id);
+    }
+    changed.clear();
+    return evaluated;
+}
+
+void EmptySpaceGrid::build() {
+    statics.clear();
+    halfSpaces.clear();
+    dynamics.clear();
+    changed.clear();
+    builtBounds.assign(scene.all.size(), {});
+    builtDynamic.assign(scene.all.size(), 0);
+    builtCount = scene.objects.size();
+    built = true;
+
+    domain = {};
+    bool usable = true;
+    clearOutside = true;
+    for (Object* object : scene.objects) {
+        const ObjectId id = scene.idOf(object);
+        const BoundingSphere& b = scene.bounds[id];
+        builtBounds[id] = b;
+        builtDynamic[id] = object->dynamic;
+        if (object->dynamic) {
+            dynamics.push_back(object);
+            usable = usable && b.isBounded();  // leaps could not be clipped against it
+            continue;
+        }
+        const Kind kind = kindOf(object);
+        statics.push_back({object, kind});
+        usable = usable && kind != Kind::Unknown;
+        if (kind == Kind::HalfSpace) halfSpaces.push_back(halfSpaceOf(object));
+        else if (b.isBounded()) domain.grow(Aabb::around(b));
+        else clearOutside = false;  // e.g. a union with a plane: only the cells bound it
+    }
+
+    enabled = usable && !statics.empty();
+    bounds.clear();
+    if (!enabled || domain.lo[0] > domain.hi[0]) {
+        dims[0] = dims[1] = dims[2] = 0;
+        return;
+    }
+
+    // Cubic cells over the static bounds plus a margin, the longest axis split `resolution` times
+    double extent = 0.0;
+    for (int a = 0; a < 3; ++a) extent = std::max(extent, domain.hi[a] - domain.lo[a]);
+    extent = std::max(extent, 1e-6);
+    const double margin = extent * DOMAIN_MARGIN;
+    cell = (extent + 2.0 * margin) / std::max(1u, resolution);
+    for (int a = 0; a < 3; ++a) {
+        domain.lo[a] -= margin;
+        dims[a] = std::max(1u, static_cast<unsigned>(std::ceil((domain.hi[a] + margin - domain.lo[a]) / cell)));
+        domain.hi[a] = domain.lo[a] + dims[a] * cell;
+    }
+
+    bounds.resize(std::size_t(dims[0]) * dims[1] * dims[2]);
+    parallelFor(bounds.size(), [&](std::size_t begin, std::size_t end) {
+        std::size_t cells[BATCH];
+        for (std::size_t first = begin; first < end; first += BATCH) {
+            const std::size_t count = std::min(BATCH, end - first);
+            for (std::size_t k = 0; k < count; ++k) cells[k] = first + k;
+            evaluate(cells, count);
+        }
+    }, std::size_t(dims[0]) * dims[1]);
+}
+
+std::size_t EmptySpaceGrid::refresh(const ObjectId id) {
+    // A cell can only change where the object's old bound did not exceed the cell's bound
+    // (it may have been the closest object) or its new bound is below it
+    const BoundingSphere old = builtBounds[id];
+    const BoundingSphere& now = scene.bounds[id];
+    const double h = halfDiagonal();
+    const float slack = static_cast<float>(NUDGE * cell);
+
+    std::vector<std::size_t> affected;
+    for (std::size_t i = 0; i < bounds.size(); ++i) {
+        const Vector3 c = centerOf(i);
+        if (sphereBound(old, c, h) <= bounds[i] + slack || sphereBound(now, c, h) < bounds[i] + slack) affected.push_back(i);
+    }
+    parallelFor(affected.size(), [&](std::size_t begin, std::size_t end) {
+        evaluate(affected.data() + begin, end - begin);
+    }, BATCH);
+
+    builtBounds[id] = now;
+    return affected.size();
+}
+
+void EmptySpaceGrid::evaluate(const std::size_t* cells, const std::size_t count) {
+    const double h = halfDiagonal();
+    std::vector<double> xs(count), ys(count), zs(count), distance(count);
+    std::vector<double> lowest(count, std::numeric_limits<double>::infinity());
+    for (std::size_t k = 0; k < count; ++k) {
+        const Vector3 c = centerOf(cells[k]);
+        xs[k] = c.getX();
+        ys[k] = c.getY();
+        zs[k] = c.getZ();
+    }
+    for (const Source& s : statics) {
+        switch (s.kind) {
+            case Kind::HalfSpace:
+                continue;  // intersected exactly by leap()
+            case Kind::Exact:
+                s.object->distances(xs.data(), ys.data(), zs.data(), distance.data(), count);
+                for (std::size_t k = 0; k < count; ++k) lowest[k] = std::min(lowest[k], distance[k] - h);
+                break;
+            case Kind::Bounds: {
+                const BoundingSphere& b = scene.bounds[scene.idOf(s.object)];
+                for (std::size_t k = 0; k < count; ++k) lowest[k] = std::min(lowest[k], sphereBound(b, Vector3(xs[k], ys[k], zs[k]), h));
+                break;
+            }
+            case Kind::Unknown:
+                std::fill(lowest.begin(), lowest.end(), -std::numeric_limits<double>::infinity());
+                break;
+        }
+    }
+    // Rounded down, so the float never claims more room than the double
+    for (std::size_t k = 0; k < count; ++k)
+        bounds[cells[k]] = std::nextafter(static_cast<float>(lowest[k]), -std::numeric_limits<float>::infinity());
+}
+
+Vector3 EmptySpaceGrid::centerOf(const std::size_t index) const {
+    const std::size_t x = index % dims[0];
+    const std::size_t y = index / dims[0] % dims[1];
+    const std::size_t z = index / (std::size_t(dims[0]) * dims[1]);
+    return Vector3(domain.lo[0] + (x + 0.5) * cell, domain.lo[1] + (y + 0.5) * cell, domain.lo[2] + (z + 0.5) * cell);
+}
+
+double EmptySpaceGrid::halfDiagonal() const {
+    return 0.5 * std::sqrt(3.0) * cell;
+}
+
+double EmptySpaceGrid::leap(const Vector3& p, const Vector3& dir, const double margin, const double growth,
+                            const double reach) const {
+    if (!enabled) return 0.0;
+
+    double limit = reach;
+    for (const Object* object : dynamics) {
+        // Entering earlier only lowers the margin owed there
+        const BoundingSphere& b = scene.bounds[scene.idOf(object)];
+        const double entry = sphereEntry(b, p, dir, margin);
+        limit = std::min(limit, entry < limit ? sphereEntry(b, p, dir, margin + growth * entry) : limit);
+    }
+    for (const HalfSpace& h : halfSpaces) {
+        const double height = h.normal.dot(p) - h.offset - margin;
+        const double closing = growth - h.normal.dot(dir);
+        if (height <= 0.0) return 0.0;
+        if (closing > 0.0) limit = std::min(limit, height / closing);
+    }
+    if (limit <= 0.0) return 0.0;
+
+    const double o[3] = {p.getX(), p.getY(), p.getZ()};
+    const double d[3] = {dir.getX(), dir.getY(), dir.getZ()};
+    double travelled = 0.0;
+    for (unsigned guard = dims[0] + dims[1] + dims[2] + 4; guard > 0 && travelled < limit; --guard) {
+        double q[3];
+        bool inside = !bounds.empty();
+        for (int a = 0; a < 3; ++a) {
+            q[a] = o[a] + d[a] * travelled;
+            inside = inside && q[a] >= domain.lo[a] && q[a] < domain.hi[a];
+        }
+
+        if (!inside) {
+            if (!clearOutside) return travelled;
+            // Only half-spaces out here: on to where the ray enters the domain, if it does
+            double enter = 0.0, leave = std::numeric_limits<double>::infinity();
+            for (int a = 0; a < 3 && !bounds.empty(); ++a) {
+                if (d[a] == 0.0) {
+                    if (q[a] < domain.lo[a] || q[a] >= domain.hi[a]) leave = -1.0;
+                    continue;
+                }
+                const double t0 = (domain.lo[a] - q[a]) / d[a];
+                const double t1 = (domain.hi[a] - q[a]) / d[a];
+                enter = std::max(enter, std::min(t0, t1));
+                leave = std::min(leave, std::max(t0, t1));
+            }
+            if (bounds.empty() || enter > leave) return limit;
+            if (enter <= 0.0) return travelled;  // on a face, rounded the wrong way
+            // The domain margin keeps every bound well away from its faces
+            travelled += enter + NUDGE * cell;
+            continue;
+        }
+
+        std::size_t index = 0, stride = 1;
+        double exit = std::numeric_limits<double>::infinity();
+        for (int a = 0; a < 3; ++a) {
+            const auto i = std::min(static_cast<unsigned>((q[a] - domain.lo[a]) / cell), dims[a] - 1);
+            index += i * stride;
+            stride *= dims[a];
+            if (d[a] > 0.0) exit = std::min(exit, (domain.lo[a] + (i + 1) * cell - q[a]) / d[a]);
+            else if (d[a] < 0.0) exit = std::min(exit, (domain.lo[a] + i * cell - q[a]) / d[a]);
+        }
+
+        const double bound = bounds[index] - margin;
+        const double clear = bound - growth * travelled;
+        if (clear <= 0.0) return travelled;
+        // Just past the exit face, by less than the clearance, so the landing point is still clear
+        const double step = std::max(exit + 0.5 * std::min(clear, NUDGE * cell), clear);
+        if (growth > 0.0 && travelled + step > bound / growth) return bound / growth;
+        travelled += step;
+    }
+    return std::min(travelled, limit);
+}
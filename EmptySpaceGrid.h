@@ -0,0 +1,89 @@
+#ifndef RENDERING_PROJECT_EMPTYSPACEGRID_H
+#define RENDERING_PROJECT_EMPTYSPACEGRID_H
+
+#include "Bvh.h"
+#include "Scene.h"
+#include "Vector3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Coarse grid over the static part of a scene. Every cell stores a lower bound on the
+// distance estimate anywhere inside it: the distance at the cell centre minus half the
+// cell diagonal for exact SDFs, the distance to the bounding sphere for fractals and other
+// estimators. A cell with a positive bound holds no surface, so a ray crosses it in one
+// leap instead of creeping along nearby geometry.
+// Planes and terrain are not gridded: they are half-spaces (terrain up to its highest
+// possible height), intersected with the ray exactly, so a ray skimming the ground leaps
+// straight to where it comes within reach of it. Dynamic objects stay out of the grid as
+// well; leaps stop where the ray enters their bounding spheres.
+// The grid follows scene changes: a changed static object only re-evaluates the cells it
+// was, or now may be, the closest object for.
+class EmptySpaceGrid {
+public:
+    unsigned resolution = 64;  // cells along the longest axis of the static bounds
+
+    explicit EmptySpaceGrid(Scene& scene);
+    ~EmptySpaceGrid();
+    EmptySpaceGrid(const EmptySpaceGrid&) = delete;
+    EmptySpaceGrid& operator=(const EmptySpaceGrid&) = delete;
+
+    // Builds the grid on first use or when objects were added or changed between static
+    // and dynamic, otherwise re-evaluates the cells around changed objects. Returns the
+    // number of cells evaluated.
+    std::size_t update();
+
+    [[nodiscard]] bool isEnabled() const { return enabled; }
+    [[nodiscard]] double cellSize() const { return cell; }
+
+    // How far, up to `reach`, a ray from p along unit `dir` can advance without coming
+    // closer to a surface than margin + growth * (distance advanced); 0 when p may already
+    // be that close. The growth follows a hit tolerance that widens with distance.
+    [[nodiscard]] double leap(const Vector3& p, const Vector3& dir, double margin, double growth, double reach) const;
+
+private:
+    Scene& scene;
+    int listener;
+    bool enabled = false;
+    bool built = false;
+    bool clearOutside = false;               // nothing but half-spaces outside the domain
+
+    Aabb domain;
+    double cell = 0.0;
+    unsigned dims[3] = {0, 0, 0};
+    std::vector<float> bounds;               // per cell, x fastest
+
+    // How a static object's bound over a cell is found
+    enum class Kind : std::uint8_t { HalfSpace, Exact, Bounds, Unknown };
+    struct Source {
+        Object* object;
+        Kind kind;
+    };
+    // No surface where normal . p > offset
+    struct HalfSpace {
+        Vector3 normal;
+        double offset;
+    };
+
+    std::vector<Source> statics;             // top-level objects
+    std::vector<HalfSpace> halfSpaces;
+    std::vector<Object*> dynamics;
+    std::size_t builtCount = 0;
+    std::vector<BoundingSphere> builtBounds; // bounds the cells were evaluated with, by ObjectId
+    std::vector<std::uint8_t> builtDynamic;  // dynamic flag at build time, by ObjectId
+    std::vector<ObjectId> changed;           // static objects changed since the last update
+
+    void build();
+    [[nodiscard]] std::size_t refresh(ObjectId id);
+    [[nodiscard]] static Kind kindOf(Object* object);
+    [[nodiscard]] static HalfSpace halfSpaceOf(Object* object);
+    // Bounds of the listed cells; each exact source is queried for all of them at once
+    // (Object::distances)
+    void evaluate(const std::size_t* cells, std::size_t count);
+    [[nodiscard]] Vector3 centerOf(std::size_t index) const;
+    [[nodiscard]] double halfDiagonal() const;
+};
+
+
+#endif //RENDERING_PROJECT_EMPTYSPACEGRID_H
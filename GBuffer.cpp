@@ -0,0 +1,65 @@
+#include "GBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+    double signNotZero(double v) { return v >= 0.0 ? 1.0 : -1.0; }
+
+    std::uint32_t toSnorm16(double v) {
+        const auto q = static_cast<std::int16_t>(std::lround(std::clamp(v, -1.0, 1.0) * 32767.0));
+        return static_cast<std::uint16_t>(q);
+    }
+
+    double fromSnorm16(std::uint32_t bits) {
+        return std::max(-1.0, static_cast<std::int16_t>(bits & 0xffffu) / 32767.0);
+    }
+}
+
+std::uint32_t encodeOctahedral(const Vector3& n) {
+    const double l1 = std::abs(n.getX()) + std::abs(n.getY()) + std::abs(n.getZ());
+    if (l1 == 0.0) return 0;
+    double x = n.getX() / l1;
+    double y = n.getY() / l1;
+    if (n.getZ() < 0.0) {
+        // Fold the lower hemisphere over the diagonals
+        const double fx = (1.0 - std::abs(y)) * signNotZero(x);
+        const double fy = (1.0 - std::abs(x)) * signNotZero(y);
+        x = fx;
+        y = fy;
+    }
+    return toSnorm16(x) | (toSnorm16(y) << 16);
+}
+
+Vector3 decodeOctahedral(const std::uint32_t packed) {
+    double x = fromSnorm16(packed);
+    double y = fromSnorm16(packed >> 16);
+    const double z = 1.0 - std::abs(x) - std::abs(y);
+    if (z < 0.0) {
+        const double fx = (1.0 - std::abs(y)) * signNotZero(x);
+        const double fy = (1.0 - std::abs(x)) * signNotZero(y);
+        x = fx;
+        y = fy;
+    }
+    return Vector3(x, y, z).normalized();
+}
+
+void GBuffer::resize(const unsigned newWidth, const unsigned newHeight) {
+    resizeRegion(newWidth, newHeight, 0, 0, newWidth, newHeight);
+}
+
+void GBuffer::resizeRegion(const unsigned newFrameWidth, const unsigned newFrameHeight, const unsigned x0, const unsigned y0,
+                           const unsigned newWidth, const unsigned newHeight) {
+    frameWidth = newFrameWidth;
+    frameHeight = newFrameHeight;
+    originX = x0;
+    originY = y0;
+    width = newWidth;
+    height = newHeight;
+    const std::size_t pixels = static_cast<std::size_t>(width) * height;
+    depth.assign(pixels, -1.0f);
+    object.assign(pixels, -1);
+    normal.assign(pixels, 0);
+    material.assign(pixels, 0);
+}
@@ -0,0 +1,50 @@
+#ifndef RENDERING_PROJECT_GBUFFER_H
+#define RENDERING_PROJECT_GBUFFER_H
+
+#include "CameraBasis.h"
+#include "Vector3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Unit normal <-> two 16-bit snorm values on the octahedron, packed into 32 bits
+std::uint32_t encodeOctahedral(const Vector3& n);
+Vector3 decodeOctahedral(std::uint32_t packed);
+
+// Per-pixel surface attributes written by the primary march of the CPU renderer.
+// Later passes (shadows, shading, reflections, and anything screen-space such as
+// reprojection, denoising or AA) read from here instead of re-marching.
+struct GBuffer {
+    unsigned width = 0, height = 0;
+    // The buffer may cover just a tile: its pixel (x, y) is pixel (originX + x, originY + y)
+    // of a frameWidth x frameHeight frame, which is what the rays are generated for
+    unsigned frameWidth = 0, frameHeight = 0;
+    unsigned originX = 0, originY = 0;
+    CameraBasis camera{Vector3(), Vector3(0, 1, 0), Vector3(0, 0, 1)};
+    double fov = 0.0;
+
+    std::vector<float> depth;           // distance along the primary ray
+    std::vector<std::int32_t> object;   // ObjectId of the top-level hit, -1 = sky
+    std::vector<std::uint32_t> normal;  // octahedral-encoded world-space normal
+    std::vector<std::uint16_t> material;
+
+    void resize(unsigned newWidth, unsigned newHeight);
+    // Covers the newWidth x newHeight pixels at (x0, y0) of a larger frame
+    void resizeRegion(unsigned newFrameWidth, unsigned newFrameHeight, unsigned x0, unsigned y0, unsigned newWidth, unsigned newHeight);
+
+    [[nodiscard]] std::size_t size() const { return depth.size(); }
+    [[nodiscard]] bool isHit(std::size_t i) const { return object[i] >= 0; }
+    [[nodiscard]] Vector3 rayDir(std::size_t i) const {
+        return camera.pixelDir(originX + static_cast<unsigned>(i % width), originY + static_cast<unsigned>(i / width), frameWidth, frameHeight, fov);
+    }
+    [[nodiscard]] Vector3 position(std::size_t i) const { return camera.o + rayDir(i) * depth[i]; }
+    // Change of the primary ray direction towards the next pixel along x and along y
+    void rayDifferentials(std::size_t i, Vector3& dx, Vector3& dy) const {
+        camera.pixelDirDifferentials(originX + static_cast<unsigned>(i % width), originY + static_cast<unsigned>(i / width), frameWidth, frameHeight, fov, dx, dy);
+    }
+    [[nodiscard]] Vector3 normalAt(std::size_t i) const { return decodeOctahedral(normal[i]); }
+};
+
+
+#endif //RENDERING_PROJECT_GBUFFER_H
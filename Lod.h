@@ -0,0 +1,50 @@
+#ifndef RENDERING_PROJECT_LOD_H
+#define RENDERING_PROJECT_LOD_H
+
+#include <algorithm>
+#include <cmath>
+
+
+// Level of detail from the pixel footprint: the world-space width of one pixel's cone at
+// the point being evaluated. Marchers set it for the queries they make (Lod::Scope); the
+// fractal and terrain distance functions read it and skip detail smaller than a pixel.
+// A footprint of 0 means full detail, which is what every query outside a march gets.
+// The same rules are implemented in shaders/raymarch.frag (lodIterations / lodOctaves).
+struct Lod {
+    static inline thread_local double footprint = 0.0;
+
+    // Sets the footprint for the current thread until the scope ends
+    class Scope {
+        double saved;
+    public:
+        explicit Scope(double width) : saved(footprint) { footprint = width; }
+        ~Scope() { footprint = saved; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // Angle subtended by one pixel for a vertical field of view over `height` pixels
+    static double pixelAngle(double fov, unsigned height) { return 2.0 * std::tan(fov / 2) / height; }
+
+    // A surface point is accepted once it is within half a pixel of the surface
+    static double hitEpsilon(double minimum, double width) { return std::max(minimum, 0.5 * width); }
+
+    // Escape-time fractals gain detail about `power` times finer per iteration, so features of
+    // iteration n are ~scale / power^n wide; two iterations past the pixel size are kept
+    static int fractalIterations(int iterations, double scale, double power, double width) {
+        if (width <= 0.0) return iterations;
+        const double levels = std::log(scale / width) / std::log(std::max(power, 2.0));
+        return std::clamp(static_cast<int>(std::ceil(levels)) + 2, std::min(iterations, 2), iterations);
+    }
+
+    // Octave i of an fBm has wavelength 1 / (baseFrequency * lacunarity^i); octaves shorter
+    // than a pixel are dropped (one is kept beyond that)
+    static int octaves(int octaves, double baseFrequency, double lacunarity, double width) {
+        if (width <= 0.0 || baseFrequency <= 0.0 || lacunarity <= 1.0) return octaves;
+        const double levels = std::log(1.0 / (baseFrequency * width)) / std::log(lacunarity);
+        return std::clamp(static_cast<int>(std::floor(levels)) + 2, 1, octaves);
+    }
+};
+
+
+#endif //RENDERING_PROJECT_LOD_H
@@ -0,0 +1,163 @@
+#include "Material.h"
+
+#include "Constants.h"
+#include "Objects/Sphere.h"
+#include "Objects/Plane.h"
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+    std::uint32_t packColor(const sf::Color c) {
+        return (static_cast<std::uint32_t>(c.r) << 24) | (c.g << 16) | (c.b << 8) | c.a;
+    }
+
+    sf::Color texel(const sf::Image& image, double u, double v) {
+        const sf::Vector2u size = image.getSize();
+        u -= std::floor(u);
+        v -= std::floor(v);
+        const unsigned x = std::min(size.x - 1, static_cast<unsigned>(u * size.x));
+        const unsigned y = std::min(size.y - 1, static_cast<unsigned>(v * size.y));
+        return image.getPixel({x, y});
+    }
+
+    // Two unit tangents spanning the plane
+    void planeTangents(const Vector3& normal, Vector3& t1, Vector3& t2) {
+        t1 = normal.cross(std::abs(normal.getZ()) < 0.9 ? Z : X).normalized();
+        t2 = normal.cross(t1).normalized();
+    }
+}
+
+sf::Color Material::colorAt(const Vector3& p) const {
+    switch (bake) {
+        case Bake::Spherical: {
+            Vector3 d = p - bakeOrigin;
+            double len = d.magnitude();
+            if (len == 0) return baseColor;
+            d /= len;
+            double theta = std::acos(std::clamp(d.getZ(), -1.0, 1.0));
+            double phi = std::atan2(d.getY(), d.getX());
+            return texel(baked, (phi + PI) / (2.0 * PI), theta / PI);
+        }
+        case Bake::Planar: {
+            Vector3 d = p - bakeOrigin;
+            return texel(baked, d.dot(bakeU), d.dot(bakeV));
+        }
+        case Bake::None:
+            break;
+    }
+    if (procedural) return procedural(p);
+    return baseColor;
+}
+
+bool bakeSphereColor(Material& material, const Sphere& sphere, const unsigned width, const unsigned height) {
+    sf::Image image({width, height});
+    bool constant = true;
+    const sf::Color first = sphere.color_func(sphere.center + Z * sphere.radius);
+
+    for (unsigned y = 0; y < height; ++y) {
+        const double theta = (y + 0.5) / height * PI;
+        for (unsigned x = 0; x < width; ++x) {
+            const double phi = (x + 0.5) / width * 2.0 * PI - PI;
+            Vector3 dir(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+            sf::Color c = sphere.color_func(sphere.center + dir * sphere.radius);
+            constant = constant && c == first;
+            image.setPixel({x, y}, c);
+        }
+    }
+
+    material.baseColor = first;
+    if (constant) return false;
+
+    material.bake = Material::Bake::Spherical;
+    material.baked = std::move(image);
+    material.bakeOrigin = sphere.center;
+    material.bakeRadius = sphere.radius;
+    return true;
+}
+
+bool bakePlaneColor(Material& material, const Plane& plane, const double period, const unsigned resolution) {
+    Vector3 t1, t2;
+    planeTangents(plane.normal, t1, t2);
+
+    sf::Image image({resolution, resolution});
+    bool constant = true;
+    const sf::Color first = plane.color_func(plane.point);
+
+    for (unsigned y = 0; y < resolution; ++y) {
+        for (unsigned x = 0; x < resolution; ++x) {
+            Vector3 p = plane.point + t1 * ((x + 0.5) / resolution * period) + t2 * ((y + 0.5) / resolution * period);
+            sf::Color c = plane.color_func(p);
+            constant = constant && c == first;
+            image.setPixel({x, y}, c);
+        }
+    }
+
+    material.baseColor = first;
+    if (constant) return false;
+
+    material.bake = Material::Bake::Planar;
+    material.baked = std::move(image);
+    material.bakeOrigin = plane.point;
+    material.bakeU = t1 / period;
+    material.bakeV = t2 / period;
+    material.procedural = nullptr;
+    return true;
+}
+
+MaterialId MaterialTable::add(Material material) {
+    materials.push_back(std::move(material));
+    return static_cast<MaterialId>(materials.size() - 1);
+}
+
+MaterialId MaterialTable::withReflectivity(const MaterialId id, const float reflectivity) {
+    const auto key = std::make_tuple(packColor(materials[id].baseColor), materials[id].reflectivity, materials[id].texture);
+    const auto it = shared.find(key);
+    if (it == shared.end() || it->second != id) {
+        materials[id].reflectivity = reflectivity;
+        return id;
+    }
+    Material copy = materials[id];
+    copy.reflectivity = reflectivity;
+    return add(std::move(copy));
+}
+
+MaterialId MaterialTable::fromObject(Object* object, const std::string& texture) {
+    Material material;
+    material.baseColor = object->getColorAtOrigin();
+    material.reflectivity = object->getReflectivity();
+    material.texture = texture;
+
+    if (auto* sphere = dynamic_cast<Sphere*>(object)) {
+        if (bakeSphereColor(material, *sphere)) return add(std::move(material));
+    } else if (auto* plane = dynamic_cast<Plane*>(object)) {
+        // A plane is unbounded, so its callback can only be baked once a period is known
+        // (see bakePlaneColor). Keep it unless a coarse probe shows it is constant.
+        Vector3 t1, t2;
+        planeTangents(plane->normal, t1, t2);
+        for (int i = -8; i <= 8; ++i) {
+            for (int j = -8; j <= 8; ++j) {
+                if (plane->color_func(plane->point + t1 * (i * 6.25) + t2 * (j * 6.25)) != material.baseColor) {
+                    material.procedural = plane->color_func;
+                    return add(std::move(material));
+                }
+            }
+        }
+    }
+
+    // Plain materials are shared by every object with the same look
+    return plain(material.baseColor, material.reflectivity, material.texture);
+}
+
+MaterialId MaterialTable::plain(const sf::Color color, const float reflectivity, const std::string& texture) {
+    auto key = std::make_tuple(packColor(color), reflectivity, texture);
+    auto it = shared.find(key);
+    if (it != shared.end()) return it->second;
+    Material material;
+    material.baseColor = color;
+    material.reflectivity = reflectivity;
+    material.texture = texture;
+    MaterialId id = add(std::move(material));
+    shared.emplace(std::move(key), id);
+    return id;
+}
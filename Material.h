@@ -0,0 +1,70 @@
+#ifndef RENDERING_PROJECT_MATERIAL_H
+#define RENDERING_PROJECT_MATERIAL_H
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "Vector3.h"
+
+struct Object;
+struct Sphere;
+struct Plane;
+
+using MaterialId = std::uint16_t;
+
+// Surface description shared by every object that references it
+struct Material {
+    enum class Bake { None, Spherical, Planar };
+
+    sf::Color baseColor = sf::Color::White;
+    float reflectivity = 0.0f;
+    std::string texture;                                   // image file, empty = none
+
+    // Procedural color baked into an image; `bake` says how a surface point maps to it
+    Bake bake = Bake::None;
+    sf::Image baked;
+    Vector3 bakeOrigin;                                    // sphere center / plane point
+    Vector3 bakeU, bakeV;                                  // plane tangents, scaled by 1 / period
+    double bakeRadius = 1.0;
+
+    // Last resort for color functions that could not be baked (evaluated per hit)
+    std::function<sf::Color(const Vector3&)> procedural;
+
+    [[nodiscard]] sf::Color colorAt(const Vector3& p) const;
+};
+
+// Bakes the sphere's color function into an equirectangular image (the same UV layout as the
+// shader's calculateSphereUV). Returns false if the function turned out to be constant, in
+// which case only baseColor is set.
+bool bakeSphereColor(Material& material, const Sphere& sphere, unsigned width = 256, unsigned height = 128);
+// Bakes one `period` x `period` tile of a plane's color function; only valid for functions
+// that repeat with that period, so this is never done automatically.
+bool bakePlaneColor(Material& material, const Plane& plane, double period, unsigned resolution = 256);
+
+struct MaterialTable {
+    std::vector<Material> materials;
+
+    MaterialId add(Material material);
+    // Material derived from an object's color, reflectivity and texture. Plain materials are
+    // shared between objects; sphere color functions are baked, other callbacks kept as-is.
+    MaterialId fromObject(Object* object, const std::string& texture);
+    // The shared plain material with this look, added on first use
+    MaterialId plain(sf::Color color, float reflectivity, const std::string& texture);
+    // Material `id` with a different reflectivity. A material of its own is changed in place;
+    // a shared one is first copied, so the other objects keep their look. Returns the id to use.
+    MaterialId withReflectivity(MaterialId id, float reflectivity);
+
+    const Material& operator[](MaterialId id) const { return materials[id]; }
+    Material& operator[](MaterialId id) { return materials[id]; }
+    [[nodiscard]] std::size_t size() const { return materials.size(); }
+
+private:
+    std::map<std::tuple<std::uint32_t, float, std::string>, MaterialId> shared;
+};
+
+
+#endif //RENDERING_PROJECT_MATERIAL_H
@@ -0,0 +1,71 @@
+#ifndef RENDERING_PROJECT_MATRIX3_H
+#define RENDERING_PROJECT_MATRIX3_H
+
+#include "Vector3.h"
+#include "Quaternion.h"
+#include <cmath>
+#include <cstddef>
+
+
+// Row-major 3x3 matrix, used for rotations that are applied many times: building it from a
+// quaternion costs one normalisation, after which a rotation is nine multiply-adds
+// instead of the two quaternion products (and inverse) of Vector3::rotated().
+struct Matrix3 {
+    double m[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+    static Matrix3 identity() { return {}; }
+
+    // Rotation matrix of q; q does not have to be normalised
+    static Matrix3 fromQuaternion(const Quaternion& q) {
+        const Quaternion u = q.normalize();
+        const double w = u.getW();
+        const double x = u.getVector().getX(), y = u.getVector().getY(), z = u.getVector().getZ();
+        Matrix3 r;
+        r.m[0][0] = 1 - 2 * (y*y + z*z); r.m[0][1] = 2 * (x*y - w*z);     r.m[0][2] = 2 * (x*z + w*y);
+        r.m[1][0] = 2 * (x*y + w*z);     r.m[1][1] = 1 - 2 * (x*x + z*z); r.m[1][2] = 2 * (y*z - w*x);
+        r.m[2][0] = 2 * (x*z - w*y);     r.m[2][1] = 2 * (y*z + w*x);     r.m[2][2] = 1 - 2 * (x*x + y*y);
+        return r;
+    }
+
+    // The inverse of a rotation
+    [[nodiscard]] Matrix3 transposed() const {
+        Matrix3 t;
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j) t.m[i][j] = m[j][i];
+        return t;
+    }
+
+    Vector3 operator* (const Vector3& v) const {
+        return {m[0][0]*v.getX() + m[0][1]*v.getY() + m[0][2]*v.getZ(),
+                m[1][0]*v.getX() + m[1][1]*v.getY() + m[1][2]*v.getZ(),
+                m[2][0]*v.getX() + m[2][1]*v.getY() + m[2][2]*v.getZ()};
+    }
+
+    Matrix3 operator* (const Matrix3& o) const {
+        Matrix3 r;
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j) r.m[i][j] = m[i][0]*o.m[0][j] + m[i][1]*o.m[1][j] + m[i][2]*o.m[2][j];
+        return r;
+    }
+
+    // Batched affine map out[i] = (M * (in[i] - offset)) * scale over coordinate arrays
+    // (x, y, z stored separately), written as one flat loop the compiler can vectorise.
+    // in and out may alias.
+    void transformPoints(const double* inX, const double* inY, const double* inZ,
+                         double* outX, double* outY, double* outZ, std::size_t count,
+                         const Vector3& offset = Vector3(), double scale = 1.0) const {
+        const double ox = offset.getX(), oy = offset.getY(), oz = offset.getZ();
+        const double a = m[0][0]*scale, b = m[0][1]*scale, c = m[0][2]*scale;
+        const double d = m[1][0]*scale, e = m[1][1]*scale, f = m[1][2]*scale;
+        const double g = m[2][0]*scale, h = m[2][1]*scale, k = m[2][2]*scale;
+        for (std::size_t i = 0; i < count; ++i) {
+            const double x = inX[i] - ox, y = inY[i] - oy, z = inZ[i] - oz;
+            outX[i] = a*x + b*y + c*z;
+            outY[i] = d*x + e*y + f*z;
+            outZ[i] = g*x + h*y + k*z;
+        }
+    }
+};
+
+
+#endif //RENDERING_PROJECT_MATRIX3_H
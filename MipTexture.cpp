@@ -0,0 +1,141 @@
+#include "MipTexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPTEXTURE_SSE2 1
+#endif
+
+
+namespace {
+    // Largest integer <= x, for |x| well inside the range of long long
+    long long floorToInt(const double x) {
+        const auto i = static_cast<long long>(x);
+        return i - (x < static_cast<double>(i));
+    }
+
+    // Texel coordinate of a repeating texture coordinate t on an axis of `size` texels: the
+    // texel left of the sample (wrapped) and the weight of the one right of it
+    unsigned texelOf(double t, const unsigned size, float& weight) {
+        t = (t - static_cast<double>(floorToInt(t))) * size - 0.5;  // -0.5 .. size - 0.5
+        const long long i = floorToInt(t);
+        weight = static_cast<float>(t - static_cast<double>(i));
+        return i < 0 ? size - 1 : static_cast<unsigned>(i);
+    }
+
+    void unpack(const std::uint32_t texel, unsigned channels[4]) {
+        std::uint8_t bytes[4];
+        std::memcpy(bytes, &texel, 4);
+        for (int c = 0; c < 4; ++c) channels[c] = bytes[c];
+    }
+}
+
+MipTexture::MipTexture(const sf::Image& image) {
+    const sf::Vector2u size = image.getSize();
+    if (size.x == 0 || size.y == 0) return;
+
+    // Level sizes halve (rounding down, at least 1) until 1x1; levels are padded to whole tiles
+    std::size_t total = 0;
+    for (unsigned w = size.x, h = size.y;; w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+        Level level;
+        level.width = w;
+        level.height = h;
+        level.tilesX = (w + 3) / 4;
+        level.offset = total;
+        total += static_cast<std::size_t>(level.tilesX) * ((h + 3) / 4) * 16;
+        levels.push_back(level);
+        if (w == 1 && h == 1) break;
+    }
+    texels.assign(total, 0);
+
+    const std::uint8_t* pixels = image.getPixelsPtr();
+    for (unsigned y = 0; y < size.y; ++y)
+        for (unsigned x = 0; x < size.x; ++x)
+            std::memcpy(&texels[indexOf(levels[0], x, y)], pixels + (static_cast<std::size_t>(y) * size.x + x) * 4, 4);
+
+    // Each level is the 2x2 box filter of the one above; odd edges reuse the last row / column
+    for (std::size_t l = 1; l < levels.size(); ++l) {
+        const Level& above = levels[l - 1];
+        const Level& level = levels[l];
+        for (unsigned y = 0; y < level.height; ++y) {
+            const unsigned y0 = std::min(2 * y, above.height - 1), y1 = std::min(2 * y + 1, above.height - 1);
+            for (unsigned x = 0; x < level.width; ++x) {
+                const unsigned x0 = std::min(2 * x, above.width - 1), x1 = std::min(2 * x + 1, above.width - 1);
+                unsigned sum[4] = {0, 0, 0, 0};
+                for (const std::size_t i : {indexOf(above, x0, y0), indexOf(above, x1, y0), indexOf(above, x0, y1), indexOf(above, x1, y1)}) {
+                    unsigned c[4];
+                    unpack(texels[i], c);
+                    for (int k = 0; k < 4; ++k) sum[k] += c[k];
+                }
+                std::uint8_t out[4];
+                for (int k = 0; k < 4; ++k) out[k] = static_cast<std::uint8_t>((sum[k] + 2) / 4);
+                std::memcpy(&texels[indexOf(level, x, y)], out, 4);
+            }
+        }
+    }
+}
+
+double MipTexture::lod(const double dudx, const double dvdx, const double dudy, const double dvdy) const {
+    if (levels.empty()) return 0.0;
+    // Texels covered along the longer of the two pixel axes
+    const double w = levels[0].width, h = levels[0].height;
+    const double ux = dudx * w, vx = dvdx * h, uy = dudy * w, vy = dvdy * h;
+    const double rho2 = std::max(ux * ux + vx * vx, uy * uy + vy * vy);
+    if (!(rho2 > 1.0)) return 0.0;
+    return std::min(0.5 * std::log2(rho2), static_cast<double>(levels.size() - 1));
+}
+
+MipTexture::Rgba MipTexture::sample(const double u, const double v, const double dudx, const double dvdx,
+                                    const double dudy, const double dvdy) const {
+    if (levels.empty()) return {};
+    const double lambda = lod(dudx, dvdx, dudy, dvdy);
+    const auto fine = static_cast<unsigned>(lambda);
+    const auto blend = static_cast<float>(lambda - fine);
+    const Rgba a = bilinear(fine, u, v);
+    if (blend <= 0.0f || fine + 1 >= levels.size()) return a;
+    const Rgba b = bilinear(fine + 1, u, v);
+    return {a.r + (b.r - a.r) * blend, a.g + (b.g - a.g) * blend, a.b + (b.b - a.b) * blend, a.a + (b.a - a.a) * blend};
+}
+
+MipTexture::Rgba MipTexture::bilinear(const unsigned level, const double u, const double v) const {
+    const Level& l = levels[level];
+    // Texel centres sit at (i + 0.5) / size
+    constexpr double limit = 1e15;  // also rejects NaN
+    if (!(std::abs(u) < limit && std::abs(v) < limit)) return {};
+    float tx, ty;
+    const unsigned x0 = texelOf(u, l.width, tx), y0 = texelOf(v, l.height, ty);
+    const unsigned x1 = x0 + 1 == l.width ? 0 : x0 + 1;
+    const unsigned y1 = y0 + 1 == l.height ? 0 : y0 + 1;
+    const float w00 = (1.0f - tx) * (1.0f - ty), w10 = tx * (1.0f - ty), w01 = (1.0f - tx) * ty, w11 = tx * ty;
+
+    const std::uint32_t t00 = texels[indexOf(l, x0, y0)], t10 = texels[indexOf(l, x1, y0)];
+    const std::uint32_t t01 = texels[indexOf(l, x0, y1)], t11 = texels[indexOf(l, x1, y1)];
+
+#ifdef MIPTEXTURE_SSE2
+    // One texel per register, its four channels widened to floats in the four lanes
+    const __m128i zero = _mm_setzero_si128();
+    const auto widen = [zero](const std::uint32_t t) {
+        const __m128i bytes = _mm_cvtsi32_si128(static_cast<int>(t));
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+    };
+    __m128 sum = _mm_mul_ps(widen(t00), _mm_set1_ps(w00));
+    sum = _mm_add_ps(sum, _mm_mul_ps(widen(t10), _mm_set1_ps(w10)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(widen(t01), _mm_set1_ps(w01)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(widen(t11), _mm_set1_ps(w11)));
+    alignas(16) float out[4];
+    _mm_store_ps(out, _mm_mul_ps(sum, _mm_set1_ps(1.0f / 255.0f)));
+    return {out[0], out[1], out[2], out[3]};
+#else
+    unsigned c00[4], c10[4], c01[4], c11[4];
+    unpack(t00, c00);
+    unpack(t10, c10);
+    unpack(t01, c01);
+    unpack(t11, c11);
+    float out[4];
+    for (int k = 0; k < 4; ++k) out[k] = (c00[k] * w00 + c10[k] * w10 + c01[k] * w01 + c11[k] * w11) * (1.0f / 255.0f);
+    return {out[0], out[1], out[2], out[3]};
+#endif
+}
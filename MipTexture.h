@@ -0,0 +1,57 @@
+#ifndef RENDERING_PROJECT_MIPTEXTURE_H
+#define RENDERING_PROJECT_MIPTEXTURE_H
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Texture for the CPU renderer: a full mip chain (box-filtered down to 1x1), every level
+// stored in 4x4 texel tiles with the texels of a tile in Morton order. A tile is 64 bytes,
+// the size of a cache line, so the 2x2 texels of a bilinear fetch mostly come from one
+// tile, and neighbouring fetches along either screen axis stay in the tiles just loaded.
+// Sampling picks the level from the UV derivatives across a pixel (ray differentials), so
+// minified surfaces read a level whose texels are about pixel-sized instead of skipping
+// through the full-size image. Addressing repeats, like the GPU textures.
+class MipTexture {
+public:
+    // Texel value, 0..1 per channel
+    struct Rgba {
+        float r = 1.0f, g = 1.0f, b = 1.0f, a = 1.0f;
+    };
+
+    MipTexture() = default;
+    explicit MipTexture(const sf::Image& image);
+
+    [[nodiscard]] bool empty() const { return levels.empty(); }
+    [[nodiscard]] unsigned levelCount() const { return static_cast<unsigned>(levels.size()); }
+    [[nodiscard]] unsigned width(unsigned level = 0) const { return levels[level].width; }
+    [[nodiscard]] unsigned height(unsigned level = 0) const { return levels[level].height; }
+    [[nodiscard]] std::size_t bytes() const { return texels.size() * sizeof(std::uint32_t); }
+
+    // Level of detail (fractional mip level) for UV derivatives along the pixel's x and y
+    [[nodiscard]] double lod(double dudx, double dvdx, double dudy, double dvdy) const;
+    // Trilinear sample at (u, v) (0..1 across the image, v = 0 at the top row)
+    [[nodiscard]] Rgba sample(double u, double v, double dudx, double dvdx, double dudy, double dvdy) const;
+    // Bilinear sample of one level
+    [[nodiscard]] Rgba bilinear(unsigned level, double u, double v) const;
+
+private:
+    struct Level {
+        unsigned width = 0, height = 0;
+        unsigned tilesX = 0;        // 4x4 tiles per tile row
+        std::size_t offset = 0;     // first texel in `texels`
+    };
+    std::vector<Level> levels;
+    std::vector<std::uint32_t> texels;  // RGBA8, byte order as in sf::Image
+
+    [[nodiscard]] std::size_t indexOf(const Level& level, unsigned x, unsigned y) const {
+        // Tile, then the Morton code of (x, y) within it: y1 x1 y0 x0
+        const unsigned morton = (x & 1u) | ((y & 1u) << 1) | ((x & 2u) << 1) | ((y & 2u) << 2);
+        return level.offset + ((static_cast<std::size_t>(y >> 2) * level.tilesX + (x >> 2)) << 4) + morton;
+    }
+};
+
+
+#endif //RENDERING_PROJECT_MIPTEXTURE_H
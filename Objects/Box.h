@@ -17,8 +17,8 @@ public:
         : center(c), halfSize(hs), color(col) {}
     Box(const Vector3& c, const Vector3& hs, sf::Color col, float refl)
         : center(c), halfSize(hs), color(col), reflectivity(refl) {}
-    Box(const Vector3& c, const Vector3& hs, sf::Color col, const std::string& tex = "")
-        : center(c), halfSize(hs), color(col), texture(tex) {}
+    Box(const Vector3& c, const Vector3& hs, sf::Color col, const std::string& tex = "", float refl = 0.0f)
+        : center(c), halfSize(hs), color(col), texture(tex), reflectivity(refl) {}
 
     double distanceToSurface(const Vector3& p) override {
         Vector3 q = absVec(p - center) - halfSize;
@@ -51,6 +51,12 @@ public:
     sf::Color getColorAtOrigin() const override { return color; }
     Vector3 getNormalAtOrigin() const override { return Vector3(0,0,0); } // shader will compute
     float getReflectivity() const override { return reflectivity; }
+    BoundingSphere getBounds() const override { return {center, halfSize.magnitude()}; }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "reflectivity") reflectivity = static_cast<float>(value);
+        else return setVectorComponent(center, "center", name, value) || setVectorComponent(halfSize, "halfSize", name, value);
+        return true;
+    }
 };
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "SDFUtils.h"
 #include "Object.h"
+#include <string>
 
 struct Capsule : public Object {
     Vector3 a, b;
@@ -33,9 +34,18 @@ public:
         return color;
     }
 
+    sf::Color getColorAtOrigin() const override { return color; }
+
     double getHeight() const {
         return (b - a).magnitude();
     }
+
+    BoundingSphere getBounds() const override { return {(a + b) * 0.5, getHeight() * 0.5 + radius}; }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "radius") radius = value;
+        else return setVectorComponent(a, "a", name, value) || setVectorComponent(b, "b", name, value);
+        return true;
+    }
 };
 
 #endif
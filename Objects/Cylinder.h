@@ -3,6 +3,7 @@
 
 #include "SDFUtils.h"
 #include "Object.h"
+#include <string>
 
 struct Cylinder : public Object {
     Vector3 center;
@@ -17,7 +18,7 @@ public:
     double distanceToSurface(const Vector3& p) override {
         Vector3 q = p - center;
         double dxz = sqrt(q.getX()*q.getX() + q.getZ()*q.getZ()) - radius;
-        double dy  = abs(q.getY()) - halfHeight;
+        double dy  = std::abs(q.getY()) - halfHeight;
 
         double outside = sqrt(
             std::max(dxz, 0.0)*std::max(dxz, 0.0) +
@@ -46,6 +47,13 @@ public:
     float getHeight() const { return halfHeight; }
     sf::Color getColorAtOrigin() const override { return color; }
     Vector3 getNormalAtOrigin() const override { return Vector3(0,0,0); } // shader computes
+    BoundingSphere getBounds() const override { return {center, std::sqrt(radius*radius + halfHeight*halfHeight)}; }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "radius") radius = value;
+        else if (name == "halfHeight") halfHeight = value;
+        else return setVectorComponent(center, "center", name, value);
+        return true;
+    }
 };
 
 #endif
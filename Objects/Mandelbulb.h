@@ -3,6 +3,7 @@
 
 #include "Object.h"
 #include "../Vector3.h"
+#include "../Lod.h"
 #include <SFML/Graphics.hpp>
 #include <cmath>
 #include <string>
@@ -22,8 +23,8 @@ public:
         : center(c), iterations(iter), power(p), bailout(2.0), scale(s), color(col) {}
     Mandelbulb(const Vector3& c, int iter, double p, sf::Color col, double s, float refl)
         : center(c), iterations(iter), power(p), bailout(2.0), scale(s), color(col), reflectivity(refl) {}
-    Mandelbulb(const Vector3& c, int iter = 8, double p = 8.0, sf::Color col = sf::Color::Cyan, double s = 1.0, const std::string& tex = "")
-        : center(c), iterations(iter), power(p), bailout(2.0), scale(s), color(col), texture(tex) {}
+    Mandelbulb(const Vector3& c, int iter = 8, double p = 8.0, sf::Color col = sf::Color::Cyan, double s = 1.0, const std::string& tex = "", float refl = 0.0f)
+        : center(c), iterations(iter), power(p), bailout(2.0), scale(s), color(col), texture(tex), reflectivity(refl) {}
 
     // Mandelbulb distance estimator
     // Formula: z = z^n + c where z starts at origin
@@ -42,7 +43,9 @@ public:
         double dr = 1.0;     // Derivative accumulator
         
         // Iterate the Mandelbulb formula
-        for (int i = 0; i < iterations; i++) {
+        // Iterations below the pixel footprint of the current march add no visible detail
+        const int lodIterations = Lod::fractalIterations(iterations, scale, power, Lod::footprint);
+        for (int i = 0; i < lodIterations; i++) {
             double r = z.magnitude();
             
             // Early exit if escaped
@@ -132,6 +135,15 @@ public:
     sf::Color getColorAtOrigin() const override { return color; }
     Vector3 getNormalAtOrigin() const override { return Vector3(0, 1, 0); }
     float getReflectivity() const override { return reflectivity; }
+    BoundingSphere getBounds() const override { return {center, scale * 3.0}; }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "power") power = value;
+        else if (name == "scale") scale = value;
+        else if (name == "iterations") iterations = static_cast<int>(std::lround(value));
+        else if (name == "reflectivity") reflectivity = static_cast<float>(value);
+        else return setVectorComponent(center, "center", name, value);
+        return true;
+    }
 };
 
 #endif
@@ -5,16 +5,78 @@
 #ifndef RENDERING_PROJECT_OBJECT_H
 #define RENDERING_PROJECT_OBJECT_H
 #include "../Vector3.h"
+#include "../Matrix3.h"
 #include "SFML/Graphics/Color.hpp"
 #include "SDFUtils.h"
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
 
 
 class Vector3;
 
+// Conservative world-space bounds; an infinite radius means "unbounded" (planes, terrain)
+struct BoundingSphere {
+    Vector3 center;
+    double radius = std::numeric_limits<double>::infinity();
+
+    [[nodiscard]] bool isBounded() const { return std::isfinite(radius); }
+
+    [[nodiscard]] BoundingSphere merged(const BoundingSphere& other) const {
+        if (!isBounded() || !other.isBounded()) return {};
+        Vector3 d = other.center - center;
+        double dist = d.magnitude();
+        if (dist + other.radius <= radius) return *this;
+        if (dist + radius <= other.radius) return other;
+        double r = (dist + radius + other.radius) * 0.5;
+        return {center + d * ((r - radius) / dist), r};
+    }
+};
+
+struct Object;
+
+// One SDF evaluation: the distance together with the leaf primitive that produced it
+struct SdfSample {
+    double distance = std::numeric_limits<double>::infinity();
+    Object* leaf = nullptr;    // primitive whose surface is closest
+    Object* object = nullptr;  // top-level object containing the leaf (filled in by Scene::query)
+    int material = -1;         // material of the surface at this point
+    bool inverted = false;     // leaf was subtracted, so its outward normal points into the solid
+    Vector3 gradient;          // unit gradient, only filled when requested
+    // Instancing nodes evaluate their child in its own space: local is the point the
+    // leaf saw, toWorld turns the leaf's normal back into world space
+    Vector3 local;
+    bool rotated = false;
+    Matrix3 toWorld;
+};
+
+// Updates one component of a vector parameter addressed as "<prefix>.x", ".y" or ".z"
+inline bool setVectorComponent(Vector3& v, const std::string& prefix, const std::string& name, double value) {
+    if (name.size() != prefix.size() + 2 || name.compare(0, prefix.size(), prefix) != 0 || name[prefix.size()] != '.') return false;
+    switch (name.back()) {
+        case 'x': v = Vector3(value, v.getY(), v.getZ()); return true;
+        case 'y': v = Vector3(v.getX(), value, v.getZ()); return true;
+        case 'z': v = Vector3(v.getX(), v.getY(), value); return true;
+        default: return false;
+    }
+}
+
 struct Object {
+    int id = -1;        // ObjectId within the owning scene, -1 = not owned by a scene
+    int material = -1;  // index into the owning scene's MaterialTable, -1 = not assigned
+    bool dynamic = false;  // changes between frames, so it is left out of cached data (shadow map)
+    Object* parent = nullptr;  // enclosing CSG node, if any; changes propagate up through it
+
     virtual ~Object() = default;
 
     virtual double distanceToSurface(const Vector3&) = 0;
+    // distanceToSurface() at `count` points given as coordinate arrays. Nodes that can share
+    // work across the batch (transforms, CSG) override it.
+    virtual void distances(const double* xs, const double* ys, const double* zs, double* out, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) out[i] = distanceToSurface(Vector3(xs[i], ys[i], zs[i]));
+    }
     virtual sf::Color getColorAt(const Vector3&) = 0;
     virtual Vector3 getNormalAt(const Vector3&) = 0;
 
@@ -23,6 +85,30 @@ struct Object {
     virtual sf::Color getColorAtOrigin() const { return sf::Color::White; }
     virtual Vector3 getNormalAtOrigin() const { return Vector3(0,1,0); }
     virtual float getReflectivity() const { return 0.0f; }  // Default: no reflection
+    virtual BoundingSphere getBounds() const { return {}; }  // Default: unbounded
+
+    // Distance and responsible leaf in one traversal; CSG nodes override this
+    virtual SdfSample sample(const Vector3& p) {
+        SdfSample s{distanceToSurface(p), this, this, material};
+        s.local = p;
+        return s;
+    }
+
+    // sample() plus, if asked for, the gradient - taken from the winning leaf alone
+    SdfSample query(const Vector3& p, bool wantGradient = false) {
+        SdfSample s = sample(p);
+        if (wantGradient) s.gradient = surfaceNormal(s);
+        return s;
+    }
+
+    // World-space outward normal of a sample's surface, from its leaf alone
+    static Vector3 surfaceNormal(const SdfSample& s) {
+        Vector3 n = s.leaf->getNormalAt(s.local) * (s.inverted ? -1.0 : 1.0);
+        return s.rotated ? s.toWorld * n : n;
+    }
+
+    // Sets a named numeric parameter (used by the animation timeline); false if unknown
+    virtual bool setParameter(const std::string&, double) { return false; }
 };
 
 
@@ -8,6 +8,7 @@
 #include "Object.h"
 #include <functional>
 #include <utility>
+#include <string>
 
 struct Plane : public Object {
     Vector3 point;          // Any point on the plane
@@ -65,6 +66,11 @@ public:
     sf::Color getColorAtOrigin() const override { return color_func(const_cast<Vector3&>(point)); }
     Vector3 getNormalAtOrigin() const override { return normal; }
     float getReflectivity() const override { return reflectivity; }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "reflectivity") reflectivity = static_cast<float>(value);
+        else return setVectorComponent(point, "point", name, value);
+        return true;
+    }
 };
 
 #endif // RENDERING_PROJECT_PLANE_H
@@ -3,6 +3,7 @@
 
 #include "Object.h"
 #include "../Vector3.h"
+#include "../Lod.h"
 #include <SFML/Graphics.hpp>
 #include <cmath>
 #include <string>
@@ -35,7 +36,9 @@ public:
         double dr = 1.0;  // Derivative accumulator
         
         // Iterate the quaternion Julia set formula: z = z^2 + c
-        for (int i = 0; i < iterations; i++) {
+        // Iterations below the pixel footprint of the current march add no visible detail
+        const int lodIterations = Lod::fractalIterations(iterations, scale, 2.0, Lod::footprint);
+        for (int i = 0; i < lodIterations; i++) {
             double r = z.magnitude();
             
             // Early exit if escaped
@@ -124,6 +127,13 @@ public:
     float getRadiusOrSize() const override { return static_cast<float>(scale * 2.0); }
     sf::Color getColorAtOrigin() const override { return color; }
     Vector3 getNormalAtOrigin() const override { return Vector3(0, 1, 0); }
+    BoundingSphere getBounds() const override { return {center, scale * 2.0}; }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "scale") scale = value;
+        else if (name == "iterations") iterations = static_cast<int>(std::lround(value));
+        else return setVectorComponent(center, "center", name, value) || setVectorComponent(c, "c", name, value);
+        return true;
+    }
 };
 
 #endif
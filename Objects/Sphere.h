@@ -23,8 +23,8 @@ struct Sphere : public Object {
         center(center), radius(radius), color_func(std::move(color_func)), texture("") {}
     Sphere(const Vector3& center, double radius, sf::Color color) :
         Sphere(center, radius, [color](const Vector3&){ return color; }) {}
-    Sphere(const Vector3& center, double radius, sf::Color color, const std::string& tex) :
-        center(center), radius(radius), color_func([color](const Vector3&){ return color; }), texture(tex) {}
+    Sphere(const Vector3& center, double radius, sf::Color color, const std::string& tex, float reflectivity = 0.0f) :
+        center(center), radius(radius), reflectivity(reflectivity), color_func([color](const Vector3&){ return color; }), texture(tex) {}
     Sphere(const Vector3& center, double radius, sf::Color color, float reflectivity) :
         center(center), radius(radius), reflectivity(reflectivity), color_func([color](const Vector3&){ return color; }) {}
     double distanceToSurface(const Vector3& point) override { return (point - center).magnitude() - radius; }
@@ -39,6 +39,13 @@ struct Sphere : public Object {
     sf::Color getColorAtOrigin() const override { return color_func(const_cast<Vector3&>(center)); }
     Vector3 getNormalAtOrigin() const override { return (Vector3(0,0,0)); }
     float getReflectivity() const override { return reflectivity; }
+    BoundingSphere getBounds() const override { return {center, radius}; }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "radius") radius = value;
+        else if (name == "reflectivity") reflectivity = static_cast<float>(value);
+        else return setVectorComponent(center, "center", name, value);
+        return true;
+    }
 };
 
 
@@ -3,9 +3,12 @@
 
 #include "Object.h"
 #include "../Vector3.h"
+#include "../Lod.h"
 #include <SFML/Graphics/Color.hpp>
 #include <cmath>
 #include <functional>
+#include <string>
+#include <utility>
 
 // Procedural heightfield terrain. Distance estimator compatible with sphere tracing:
 // d(p) = p.z - height(p.xy)   // Note: this project uses Z as up-axis
@@ -57,19 +60,19 @@ struct Terrain : public Object {
     Terrain& setWarp(float strength, bool enabled=true) { warpStrength = strength; warp = enabled; return *this; }
     Terrain& setRidged(bool enabled) { ridged = enabled; return *this; }
 
-    // CPU distance estimator (kept relatively light and deterministic)
+    // CPU distance estimator, the same as terrainSDF() in the shader: the surface is raised
+    // by originXZ.z as well
     double distanceToSurface(const Vector3& p) override {
-        // Z-up: d(p) = p.z - height(p.x, p.y)
-        return p.getZ() - heightAt(p.getX(), p.getY());
+        // Z-up: d(p) = p.z - origin.z - height(p.x, p.y)
+        return p.getZ() - originXZ.getZ() - heightAt(p.getX(), p.getY());
     }
 
     Vector3 getNormalAt(const Vector3& p) override {
-        // Finite differences consistent with GLSL epsilon scale
-        const double e = 1e-3;
-        double hx = heightAt(p.getX() + e, p.getY()) - heightAt(p.getX() - e, p.getY());
-        double hy = heightAt(p.getX(), p.getY() + e) - heightAt(p.getX(), p.getY() - e);
-        // For d(p) = z - h(x,y), gradient is ( -dh/dx, -dh/dy, 1 )
-        return Vector3(-hx * 0.5, -hy * 0.5, 1.0).normalized(); // scale halves to keep magnitude stable
+        // For d(p) = z - h(x,y), gradient is ( -dh/dx, -dh/dy, 1 ); the FBM pass that gives
+        // the height gives its derivatives too
+        float dx, dy;
+        heightAt(p.getX(), p.getY(), dx, dy);
+        return Vector3(-dx, -dy, 1.0).normalized();
     }
 
     sf::Color getColorAt(const Vector3&) override { return color; }
@@ -79,6 +82,17 @@ struct Terrain : public Object {
     float getRadiusOrSize() const override { return amplitude; }
     sf::Color getColorAtOrigin() const override { return color; }
     Vector3 getNormalAtOrigin() const override { return Vector3((double)octaves, lacunarity, gain); }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "amplitude") amplitude = static_cast<float>(value);
+        else if (name == "frequency") frequency = static_cast<float>(value);
+        else if (name == "seed") seed = static_cast<float>(value);
+        else if (name == "octaves") octaves = static_cast<int>(std::lround(value));
+        else if (name == "lacunarity") lacunarity = static_cast<float>(value);
+        else if (name == "gain") gain = static_cast<float>(value);
+        else if (name == "warpStrength") warpStrength = static_cast<float>(value);
+        else return setVectorComponent(originXZ, "origin", name, value);
+        return true;
+    }
 
     // Custom getters for renderer packing
     float getFrequency() const { return frequency; }
@@ -86,82 +100,113 @@ struct Terrain : public Object {
     bool  isRidged() const { return ridged; }
     bool  isWarpEnabled() const { return warp; }
 
+    // Range of the surface's z: every octave adds value noise in [0, 1] times its weight
+    [[nodiscard]] std::pair<double, double> heightRange() const {
+        double lo = 0.0, hi = 0.0, amp = 1.0;
+        for (int i = 0; i < std::max(1, std::min(8, octaves)); ++i, amp *= gain) {
+            lo += std::min(amp, 0.0);
+            hi += std::max(amp, 0.0);
+        }
+        const double base = originXZ.getZ();
+        return {base + std::min(amplitude * lo, amplitude * hi), base + std::max(amplitude * lo, amplitude * hi)};
+    }
+
     // Public hooks for shading systems
     float heightAtXZ(double x, double z) const { return heightAt(x, z); }
-    float heightAtPoint(const Vector3& p) const { return heightAt(p.getX(), p.getZ()); }
+    float heightAtPoint(const Vector3& p) const { return heightAt(p.getX(), p.getY()); }
     float slopeFactorAt(const Vector3& p) {
         Vector3 n = getNormalAt(p);
         return 1.0f - static_cast<float>(std::max(0.0, std::min(1.0, n.getZ() == 0 && n.getX() == 0 && n.getY() == 0 ? 0.0 : n.getY())));
     }
 
 private:
-    // Simple 2D value noise with smooth interpolation, seeded
-    static inline float hash(float x) {
-        // Keep deterministic and cheap
-        float s = std::sin(x) * 43758.5453f;
-        return s - std::floor(s);
+    // Noise is a port of hash12 / valueNoise / fbm2D in shaders/raymarch.frag, in float like
+    // the shader, so both back ends see the same hills
+    static float fract(float x) { return x - std::floor(x); }
+
+    static float hash12(float x, float y) {
+        float ax = fract(x * 0.1031f), ay = fract(y * 0.1031f), az = fract(x * 0.1031f);
+        const float k = ax * (ay + 33.33f) + ay * (az + 33.33f) + az * (ax + 33.33f);
+        ax += k; ay += k; az += k;
+        return fract((ax + ay) * az);
     }
 
-    static inline float hash2(float x, float y) { return hash(x * 127.1f + y * 311.7f); }
-
-    float valueNoise2D(float x, float y) const {
-        float sx = std::floor(x);
-        float sy = std::floor(y);
-        float fx = x - sx;
-        float fy = y - sy;
-
-        // incorporate seed by offsetting lattice space
-        float ox = sx + std::floor(seed * 53.0f);
-        float oy = sy + std::floor(seed * 91.0f);
-
-        float v00 = hash2(ox + 0.0f, oy + 0.0f);
-        float v10 = hash2(ox + 1.0f, oy + 0.0f);
-        float v01 = hash2(ox + 0.0f, oy + 1.0f);
-        float v11 = hash2(ox + 1.0f, oy + 1.0f);
-
-        auto smooth = [](float t){ return t*t*(3.0f - 2.0f*t); };
-        float tx = smooth(fx);
-        float ty = smooth(fy);
-        float a = v00 + (v10 - v00) * tx;
-        float b = v01 + (v11 - v01) * ty;
-        return a + (b - a) * ty;
+    // Smoothly interpolated lattice noise in [0, 1] and its derivatives, in one evaluation
+    float valueNoise2D(float x, float y, float& dx, float& dy) const {
+        const float ix = std::floor(x), iy = std::floor(y);
+        const float fx = x - ix, fy = y - iy;
+        const float sx = seed * 57.0f, sy = seed * 113.0f;
+        const float a = hash12(ix + sx, iy + sy);
+        const float b = hash12(ix + 1.0f + sx, iy + sy);
+        const float c = hash12(ix + sx, iy + 1.0f + sy);
+        const float d = hash12(ix + 1.0f + sx, iy + 1.0f + sy);
+
+        const float ux = fx * fx * (3.0f - 2.0f * fx), uy = fy * fy * (3.0f - 2.0f * fy);
+        const float k = a - b - c + d;
+        dx = 6.0f * fx * (1.0f - fx) * (b - a + k * uy);
+        dy = 6.0f * fy * (1.0f - fy) * (c - a + k * ux);
+        return a + (b - a) * ux + (c - a) * uy + k * ux * uy;
     }
-    float fbm2D(float x, float y) const {
-        float amp = 1.0f;
-        float freq = frequency;
-        float sum = 0.0f;
-        int oct = std::max(1, std::min(8, octaves)); // clamp for perf/stability
 
-        float px = x;
-        float py = y;
+    // fBm and its gradient with respect to (x, y), including the domain warp
+    float fbm2D(float x, float y, float& gx, float& gy) const {
+        int oct = std::max(1, std::min(8, octaves)); // clamp for perf/stability
+        oct = Lod::octaves(oct, frequency, lacunarity, Lod::footprint);
 
-        if (warp && warpStrength > 0.0f) {
+        float px = x, py = y;
+        float wdx = 0.0f, wdy = 0.0f, vdx = 0.0f, vdy = 0.0f, wf = 0.0f;
+        const bool warped = warp && warpStrength > 0.0f;
+        if (warped) {
             // light domain warp using lower-frequency noise to avoid aliasing
-            float wf = std::max(0.01f, frequency * 0.5f);
-            float wx = valueNoise2D(x * wf + 13.1f * seed, y * wf + 37.7f * seed);
-            float wy = valueNoise2D(x * wf + 91.4f * seed + 17.0f, y * wf + 27.9f * seed + 11.0f);
+            wf = std::max(0.01f, frequency * 0.5f);
+            const float wx = valueNoise2D(x * wf + 13.1f * seed, y * wf + 37.7f * seed, wdx, wdy);
+            const float wy = valueNoise2D(x * wf + 91.4f * seed + 17.0f, y * wf + 27.9f * seed + 11.0f, vdx, vdy);
             px += (wx * 2.0f - 1.0f) * warpStrength;
             py += (wy * 2.0f - 1.0f) * warpStrength;
         }
 
+        float amp = 1.0f, freq = frequency, sum = 0.0f;
+        gx = gy = 0.0f;
         for (int i = 0; i < oct; ++i) {
-            float n = valueNoise2D(px * freq + 17.0f * seed, py * freq + 29.0f * seed);
+            float dx, dy;
+            float n = valueNoise2D(px * freq + 17.0f * seed, py * freq + 29.0f * seed, dx, dy);
             if (ridged) {
                 // ridged: sharpen peaks
+                const float s = n >= 0.5f ? -2.0f : 2.0f;
                 n = 1.0f - std::fabs(2.0f * n - 1.0f);
+                dx *= s;
+                dy *= s;
             }
             sum += n * amp;
+            gx += dx * freq * amp;
+            gy += dy * freq * amp;
             freq *= lacunarity;
             amp *= gain;
         }
+
+        if (warped) {
+            // Chain rule through the warp: d(px, py)/d(x, y) = I + 2 * strength * wf * (dw; dv)
+            const float s = 2.0f * warpStrength * wf;
+            const float hx = gx, hy = gy;
+            gx = hx + s * (hx * wdx + hy * vdx);
+            gy = hy + s * (hx * wdy + hy * vdy);
+        }
         return sum;
     }
 
-    float heightAt(double x, double z) const {
+    float heightAt(double x, double y, float& dx, float& dy) const {
         // World-space continuity: we always evaluate in world coordinates minus origin offset
-        float px = static_cast<float>(x - originXZ.getX());
-        float pz = static_cast<float>(z - originXZ.getZ());
-        return amplitude * fbm2D(px, pz);
+        const float px = static_cast<float>(x - originXZ.getX());
+        const float py = static_cast<float>(y - originXZ.getZ());
+        const float h = amplitude * fbm2D(px, py, dx, dy);
+        dx *= amplitude;
+        dy *= amplitude;
+        return h;
+    }
+
+    float heightAt(double x, double y) const {
+        float dx, dy;
+        return heightAt(x, y, dx, dy);
     }
 };
 
@@ -3,6 +3,7 @@
 
 #include "SDFUtils.h"
 #include "Object.h"
+#include <string>
 
 struct Torus : public Object {
     Vector3 center;
@@ -33,6 +34,8 @@ public:
         return color;
     }
 
+    sf::Color getColorAtOrigin() const override { return color; }
+
     double getMajorRadius() const {
         return majorR;
     }
@@ -40,6 +43,14 @@ public:
     double getMinorRadius() const {
         return minorR;
     }
+
+    BoundingSphere getBounds() const override { return {center, majorR + minorR}; }
+    bool setParameter(const std::string& name, double value) override {
+        if (name == "majorR") majorR = value;
+        else if (name == "minorR") minorR = value;
+        else return setVectorComponent(center, "center", name, value);
+        return true;
+    }
 };
 
 #endif
@@ -0,0 +1,46 @@
+#ifndef RENDERING_PROJECT_PARALLEL_H
+#define RENDERING_PROJECT_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+// Upper bound on the threads parallelFor uses, 0 = one per hardware thread. Processes
+// that share a machine with others of their kind (tile workers) lower it.
+inline std::atomic<unsigned> threadLimit{0};
+
+inline unsigned workerCount() {
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned limit = threadLimit.load(std::memory_order_relaxed);
+    return limit > 0 ? std::min(limit, hardware) : hardware;
+}
+
+// Runs fn(begin, end) over [0, count) in chunks of `grain` items. Chunks are handed out
+// dynamically, so uneven work (e.g. rows crossing a fractal) still balances across threads.
+template<class Fn>
+void parallelFor(std::size_t count, Fn&& fn, std::size_t grain = 1) {
+    if (count == 0) return;
+    grain = std::max<std::size_t>(1, grain);
+    const std::size_t chunks = (count + grain - 1) / grain;
+    const unsigned threads = static_cast<unsigned>(std::min<std::size_t>(workerCount(), chunks));
+
+    std::atomic<std::size_t> next{0};
+    auto worker = [&] {
+        for (std::size_t chunk; (chunk = next.fetch_add(1)) < chunks;) {
+            const std::size_t begin = chunk * grain;
+            fn(begin, std::min(count, begin + grain));
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+}
+
+
+#endif //RENDERING_PROJECT_PARALLEL_H
@@ -0,0 +1,210 @@
+#include "PathTracer.h"
+
+#include "Constants.h"
+#include "Lod.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+    const Vector3 SKY(0.5, 0.7, 1.0);         // as seen, the same as the rasterising paths
+    constexpr double SURFACE_BIAS = 0.02;      // new rays start this far off the surface
+    constexpr int ROULETTE_AFTER = 3;          // bounces before paths may be terminated early
+
+    std::uint64_t mix64(std::uint64_t z) {
+        // splitmix64 finaliser
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Counter-based generator: the stream of a sample is fixed by (seed, pixel, sample)
+    class SampleRng {
+        std::uint64_t state;
+    public:
+        SampleRng(const std::uint32_t seed, const std::uint64_t pixel, const std::uint32_t sample) :
+            state(mix64(mix64(mix64(seed) ^ pixel) ^ sample)) {}
+
+        // Uniform in [0, 1)
+        double next() {
+            state += 0x9E3779B97F4A7C15ull;
+            return static_cast<double>(mix64(state) >> 11) * 0x1.0p-53;
+        }
+    };
+
+    Vector3 multiply(const Vector3& a, const Vector3& b) {
+        return {a.getX() * b.getX(), a.getY() * b.getY(), a.getZ() * b.getZ()};
+    }
+
+    // Direction around the unit normal n with density cos(theta) / pi
+    Vector3 cosineSample(const Vector3& n, SampleRng& rng) {
+        const Vector3 t1 = n.cross(std::abs(n.getZ()) < 0.9 ? Z : X).normalized();
+        const Vector3 t2 = n.cross(t1);
+        const double phi = 2.0 * PI * rng.next();
+        const double r2 = rng.next();
+        const double r = std::sqrt(r2);
+        return (t1 * (r * std::cos(phi)) + t2 * (r * std::sin(phi)) + n * std::sqrt(1.0 - r2)).normalized();
+    }
+
+    float luma(const Vector3& c) {
+        return static_cast<float>(0.2126 * c.getX() + 0.7152 * c.getY() + 0.0722 * c.getZ());
+    }
+
+    std::uint8_t toByte(const float v) {
+        return static_cast<std::uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+void PathTracer::begin(const CameraBasis& newCamera, const unsigned newFrameWidth, const unsigned newFrameHeight,
+                       const unsigned x0, const unsigned y0, const unsigned newWidth, const unsigned newHeight) {
+    camera = newCamera;
+    frameWidth = newFrameWidth;
+    frameHeight = newFrameHeight;
+    originX = x0;
+    originY = y0;
+    width = newWidth;
+    height = newHeight;
+
+    const std::size_t pixels = std::size_t(width) * height;
+    for (auto* v : {&sumR, &sumG, &sumB}) v->assign(pixels, 0.0f);
+    sumLuma.assign(pixels, 0.0);
+    sumLuma2.assign(pixels, 0.0);
+    samples.assign(pixels, 0);
+    active.resize(pixels);
+    for (std::size_t i = 0; i < pixels; ++i) active[i] = static_cast<std::uint32_t>(i);
+    totalSamples = 0;
+
+    renderer.prepare(frameHeight);
+    if (denoise) {
+        renderer.gbufferPass(camera, frameWidth, frameHeight, originX, originY, width, height);
+        guide = renderer.gbuffer;
+    }
+}
+
+std::size_t PathTracer::pass() {
+    const unsigned perPass = std::max(1u, samplesPerPass);
+    for (const std::uint32_t i : active) totalSamples += std::min(perPass, maxSamples - samples[i]);
+
+    parallelFor(active.size(), [&](std::size_t a0, std::size_t a1) {
+        for (std::size_t a = a0; a < a1; ++a) {
+            const std::uint32_t i = active[a];
+            const unsigned x = originX + i % width, y = originY + i / width;
+            const unsigned count = std::min(perPass, maxSamples - samples[i]);
+            for (unsigned k = 0; k < count; ++k) {
+                const Vector3 c = trace(x, y, samples[i] + k);
+                sumR[i] += static_cast<float>(c.getX());
+                sumG[i] += static_cast<float>(c.getY());
+                sumB[i] += static_cast<float>(c.getZ());
+                const double l = std::min(luma(c), 1.0f);
+                sumLuma[i] += l;
+                sumLuma2[i] += l * l;
+            }
+            samples[i] += count;
+        }
+    }, 16);
+
+    // Converged pixels leave the queue; the rest keep their order
+    std::size_t kept = 0;
+    for (const std::uint32_t i : active)
+        if (!converged(i)) active[kept++] = i;
+    active.resize(kept);
+    return kept;
+}
+
+bool PathTracer::converged(const std::size_t i) const {
+    const double n = samples[i];
+    if (samples[i] >= maxSamples) return true;
+    if (samples[i] < std::max(minSamples, 2u)) return false;
+    const double mean = sumLuma[i] / n;
+    const double variance = std::max(0.0, (sumLuma2[i] - n * mean * mean) / (n - 1.0));
+    return variance / n <= noiseTolerance * noiseTolerance;
+}
+
+void PathTracer::resolve(std::vector<std::uint8_t>& rgba) {
+    const std::size_t pixels = samples.size();
+    std::vector<float> r(pixels), g(pixels), b(pixels);
+    for (std::size_t i = 0; i < pixels; ++i) {
+        const float scale = samples[i] > 0 ? 1.0f / static_cast<float>(samples[i]) : 0.0f;
+        r[i] = sumR[i] * scale;
+        g[i] = sumG[i] * scale;
+        b[i] = sumB[i] * scale;
+    }
+    if (denoise && guide.size() == pixels) denoiser.apply(guide, r, g, b);
+
+    rgba.resize(pixels * 4);
+    for (std::size_t i = 0; i < pixels; ++i) {
+        rgba[i * 4 + 0] = toByte(r[i]);
+        rgba[i * 4 + 1] = toByte(g[i]);
+        rgba[i * 4 + 2] = toByte(b[i]);
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+void PathTracer::render(const CameraBasis& newCamera, const unsigned newFrameWidth, const unsigned newFrameHeight,
+                        const unsigned x0, const unsigned y0, const unsigned newWidth, const unsigned newHeight,
+                        std::vector<std::uint8_t>& rgba) {
+    begin(newCamera, newFrameWidth, newFrameHeight, x0, y0, newWidth, newHeight);
+    while (pass() > 0) {}
+    resolve(rgba);
+}
+
+Vector3 PathTracer::trace(const unsigned x, const unsigned y, const std::uint32_t sample) const {
+    SampleRng rng(seed, std::uint64_t(y) * frameWidth + x, sample);
+    const Scene& scene = renderer.scene;
+    const Vector3 lightDir = renderer.light.normalized();
+
+    // Jittered within the pixel, to first order through the ray differentials
+    Vector3 dx, dy;
+    camera.pixelDirDifferentials(x, y, frameWidth, frameHeight, renderer.fov, dx, dy);
+    const double jx = rng.next() - 0.5, jy = rng.next() - 0.5;
+    Vector3 dir = (camera.pixelDir(x, y, frameWidth, frameHeight, renderer.fov) + dx * jx + dy * jy).normalized();
+    Vector3 origin = camera.o;
+
+    Vector3 radiance, throughput(1.0, 1.0, 1.0);
+    double path = 0.0;       // for the pixel footprint
+    bool diffuse = false;    // the last bounce was diffuse, so the sky arrives as light
+    for (int bounce = 0; bounce <= maxBounces; ++bounce) {
+        SdfSample hit;
+        const double t = renderer.march(origin, dir, hit, path);
+        if (!hit.leaf) {
+            radiance += multiply(throughput, SKY * (diffuse ? skyLight : 1.0));
+            break;
+        }
+        path += t;
+        const Vector3 p = origin + dir * t;
+        Lod::Scope lod(renderer.footprint(path));
+        Vector3 n = CpuRenderer::surfaceNormal(hit, dir);
+        if (n.dot(dir) > 0.0) n = n * -1;
+
+        const auto material = static_cast<MaterialId>(hit.material);
+        const double reflectivity = std::clamp(static_cast<double>(scene.materials[material].reflectivity), 0.0, 1.0);
+        if (rng.next() < reflectivity) {
+            // Mirror lobe; picked with its own weight, so the throughput is unchanged
+            dir = (dir - n * (2.0 * dir.dot(n))).normalized();
+            origin = p + n * SURFACE_BIAS;
+            diffuse = false;
+            continue;
+        }
+
+        // Full-resolution texels: the samples themselves filter the pixel
+        const Vector3 albedo = renderer.baseColor(material, hit.object, p, n, Vector3(), Vector3());
+        const double facing = n.dot(lightDir);
+        if (facing > 0.0) {
+            const double lit = renderer.shadow(p, n);
+            if (lit > 0.0) radiance += multiply(throughput, albedo * (sunIntensity * facing * lit));
+        }
+
+        throughput = multiply(throughput, albedo);
+        if (bounce >= ROULETTE_AFTER) {
+            // Russian roulette on the brightest channel keeps the estimate unbiased
+            const double survive = std::min(0.95, std::max({throughput.getX(), throughput.getY(), throughput.getZ()}));
+            if (rng.next() >= survive) break;
+            throughput /= survive;
+        }
+        dir = cosineSample(n, rng);
+        origin = p + n * SURFACE_BIAS;
+        diffuse = true;
+    }
+    return radiance;
+}
@@ -0,0 +1,80 @@
+#ifndef RENDERING_PROJECT_PATHTRACER_H
+#define RENDERING_PROJECT_PATHTRACER_H
+
+#include "CameraBasis.h"
+#include "CpuRenderer.h"
+#include "Denoiser.h"
+#include "GBuffer.h"
+#include "Vector3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Progressive path tracer for offline renders, built on the CPU renderer's marcher,
+// materials and shadow rays. Surfaces are diffuse with their material color as albedo,
+// plus a mirror lobe taken with probability getReflectivity(). Light comes from the sun
+// (CpuRenderer::light, sampled directly with a shadow ray at every diffuse bounce) and
+// the sky.
+// Samples accumulate per pixel, pass by pass. Once a pixel has minSamples, it stops as
+// soon as the standard error of its mean drops below noiseTolerance, so later passes only
+// trace the pixels that are still noisy (fractal crevices, the shadowed side of objects,
+// partly reflective surfaces).
+// The random numbers of a sample depend only on the seed, the frame pixel and the sample
+// index, and a pixel's stopping point only on its own samples. A tile therefore comes out
+// the same on any thread, in any order, on any machine running the same build.
+// With `denoise` set, resolve() runs the estimate through the a-trous filter, guided by a
+// G-buffer marched through the pixel centres in begin(); a handful of samples per pixel
+// then give a usable image.
+class PathTracer {
+public:
+    unsigned minSamples = 16;        // taken before a pixel may stop
+    unsigned maxSamples = 1024;
+    unsigned samplesPerPass = 4;
+    double noiseTolerance = 0.004;   // standard error of the displayed luminance, ~one 8-bit step
+    int maxBounces = 6;
+    double sunIntensity = 0.8;       // radiance reflected by a white surface facing the sun
+    double skyLight = 0.35;          // the sky lights diffuse surfaces at this fraction of how it looks
+    std::uint32_t seed = 0;
+    bool denoise = false;
+    Denoiser denoiser;
+
+    explicit PathTracer(CpuRenderer& renderer) : renderer(renderer) {}
+
+    // Clears the accumulation buffer for the width x height pixels at (x0, y0) of a
+    // frameWidth x frameHeight frame seen through `camera`
+    void begin(const CameraBasis& camera, unsigned frameWidth, unsigned frameHeight,
+               unsigned x0, unsigned y0, unsigned width, unsigned height);
+    // Adds samplesPerPass samples to every pixel still sampling; returns how many still are
+    std::size_t pass();
+    // Current estimate into `rgba` (width * height * 4 bytes, top row first), denoised if enabled
+    void resolve(std::vector<std::uint8_t>& rgba);
+    // begin(), passes until every pixel has stopped, resolve()
+    void render(const CameraBasis& camera, unsigned frameWidth, unsigned frameHeight,
+                unsigned x0, unsigned y0, unsigned width, unsigned height, std::vector<std::uint8_t>& rgba);
+
+    [[nodiscard]] std::size_t activePixels() const { return active.size(); }
+    [[nodiscard]] std::uint64_t samplesTaken() const { return totalSamples; }
+    [[nodiscard]] unsigned samplesAt(unsigned x, unsigned y) const { return samples[std::size_t(y) * width + x]; }
+
+private:
+    CpuRenderer& renderer;
+    CameraBasis camera{Vector3(), Vector3(0, 1, 0), Vector3(0, 0, 1)};
+    unsigned frameWidth = 0, frameHeight = 0;
+    unsigned originX = 0, originY = 0;
+    unsigned width = 0, height = 0;
+
+    std::vector<float> sumR, sumG, sumB;
+    std::vector<double> sumLuma, sumLuma2;  // of the displayed (clamped) luminance, for the error estimate
+    std::vector<std::uint32_t> samples;
+    std::vector<std::uint32_t> active;      // pixels still sampling
+    std::uint64_t totalSamples = 0;
+    GBuffer guide;                          // for the denoiser
+
+    // Radiance along one path through frame pixel (x, y)
+    [[nodiscard]] Vector3 trace(unsigned x, unsigned y, std::uint32_t sample) const;
+    [[nodiscard]] bool converged(std::size_t i) const;
+};
+
+
+#endif //RENDERING_PROJECT_PATHTRACER_H
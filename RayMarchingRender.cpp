@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "CameraBasis.h"
+#include "Lod.h"
 #include "Objects/Sphere.h"
 #include "Objects/Plane.h"
 #include "Objects/Box.h"
@@ -19,74 +20,228 @@
 #include "CSGoperations/Union.h"
 #include "CSGoperations/Difference.h"
 #include "CSGoperations/Intersection.h"
+#include "CSGoperations/Repetition.h"
+#include "CSGoperations/Instances.h"
+#include "CSGoperations/Transform.h"
 #include <map>
+#include <iostream>
 #include <algorithm>
+#include <cmath>
+
+
+void RayMarchingRender::packObject(const unsigned i) {
+    Object* o = objects[i];
+
+    // Assign objType based on dynamic cast
+    if (dynamic_cast<Sphere*>(o)) packed.type[i] = 0.0f;
+    else if (dynamic_cast<Plane*>(o)) packed.type[i] = 1.0f;
+    else if (dynamic_cast<Box*>(o)) packed.type[i] = 2.0f;
+    else if (dynamic_cast<Cylinder*>(o)) packed.type[i] = 3.0f;
+    else if (dynamic_cast<Capsule*>(o)) packed.type[i] = 4.0f;
+    else if (dynamic_cast<Torus*>(o)) packed.type[i] = 5.0f;
+    else if (usesCsgProgram(o)) packed.type[i] = 12.0f;
+    else if (dynamic_cast<Mandelbulb*>(o)) packed.type[i] = 9.0f;
+    else if (dynamic_cast<Terrain*>(o)) packed.type[i] = 10.0f;
+    else if (dynamic_cast<QuaternionJulia*>(o)) packed.type[i] = 11.0f;
+    else packed.type[i] = -1.0f;
+
+    // For primitives and CSG, set data
+    if (packed.type[i] == 12.0f) {
+        // CSG trees run as programs; the instruction range is filled in when the
+        // program is rebuilt after packing
+        const BoundingSphere bounds = o->getBounds();
+        const Vector3 center = bounds.isBounded() ? bounds.center : Vector3();
+        packed.pos[i] = sf::Glsl::Vec3(static_cast<float>(center.getX()),
+                                static_cast<float>(center.getY()),
+                                static_cast<float>(center.getZ()));
+        packed.color[i] = packed.color2[i] = sf::Glsl::Vec3(1.f, 1.f, 1.f);
+        csgDirty = true;
+    } else {
+        // For primitives
+        Vector3 center = o->getCenterOrPoint();
+        packed.pos[i] = sf::Glsl::Vec3(static_cast<float>(center.getX()),
+                                static_cast<float>(center.getY()),
+                                static_cast<float>(center.getZ()));
+
+        packed.radius[i] = o->getRadiusOrSize();
+        packed.radius2[i] = 0.0f;
+
+        if (packed.type[i] == 2.0f) { // box - store full size in objNormal
+            Box* box = dynamic_cast<Box*>(o);
+            Vector3 halfSize = box->getSize();
+            packed.normal[i] = sf::Glsl::Vec3(static_cast<float>(halfSize.getX()),
+                                     static_cast<float>(halfSize.getY()),
+                                     static_cast<float>(halfSize.getZ()));
+            packed.radius[i] = static_cast<float>(halfSize.getX()); // Keep X for compatibility
+        } else if (packed.type[i] == 4.0f) { // capsule
+            packed.radius2[i] = dynamic_cast<Capsule*>(o)->getHeight();
+        } else if (packed.type[i] == 5.0f) { // torus
+            packed.radius[i] = dynamic_cast<Torus*>(o)->getMajorRadius();
+            packed.radius2[i] = dynamic_cast<Torus*>(o)->getMinorRadius();
+        } else if (packed.type[i] == 9.0f) { // mandelbulb
+            Mandelbulb* mb = dynamic_cast<Mandelbulb*>(o);
+            packed.radius[i] = static_cast<float>(mb->scale);
+            packed.radius2[i] = static_cast<float>(mb->power);
+            // Store iterations in objNormal.x (we'll extract it in shader)
+            // Don't overwrite this - Mandelbulb doesn't use getNormalAtOrigin()
+            packed.normal[i] = sf::Glsl::Vec3(static_cast<float>(mb->iterations), 0.0f, 0.0f);
+        } else if (packed.type[i] == 10.0f) { // terrain
+            // Pack terrain parameters using existing arrays to avoid new uniforms
+            // u_objPos = (origin.x, seed, origin.z)
+            // u_objRadius = amplitude
+            // u_objRadius2 = base frequency
+            // u_objNormal = (octaves, lacunarity, gain)
+            // u_objColor2 = (warpStrength, ridgedToggle, warpToggle)
+            Terrain* t = dynamic_cast<Terrain*>(o);
+            // Center already set from getCenterOrPoint(): (origin.x, seed, origin.z)
+            packed.radius[i] = t->getRadiusOrSize();
+            packed.radius2[i] = t->getFrequency();
+            // getNormalAtOrigin encodes (octaves, lacunarity, gain)
+            Vector3 ng = t->getNormalAtOrigin();
+            packed.normal[i] = sf::Glsl::Vec3(static_cast<float>(ng.getX()), static_cast<float>(ng.getY()), static_cast<float>(ng.getZ()));
+            packed.color2[i] = sf::Glsl::Vec3(t->getWarpStrength(), t->isRidged() ? 1.0f : 0.0f, t->isWarpEnabled() ? 1.0f : 0.0f);
+            packed.extra[i] = t->originXZ.getZ();
+        } else if (packed.type[i] == 11.0f) { // quaternion julia
+            QuaternionJulia* qj = dynamic_cast<QuaternionJulia*>(o);
+            packed.radius[i] = static_cast<float>(qj->scale);
+            packed.radius2[i] = 0.0f;
+            // Store Julia constant c in objNormal, iterations in objNormal.x
+            Vector3 juliaC = qj->c;
+            packed.normal[i] = sf::Glsl::Vec3(static_cast<float>(qj->iterations),
+                                     static_cast<float>(juliaC.getX()),
+                                     static_cast<float>(juliaC.getY()));
+            // Store z component of c in objRadius2 (we'll use it in shader)
+            packed.radius2[i] = static_cast<float>(juliaC.getZ());
+        } else {
+            // For other objects, set normal from getNormalAtOrigin()
+            Vector3 n = o->getNormalAtOrigin();
+            packed.normal[i] = sf::Glsl::Vec3(static_cast<float>(n.getX()),
+                                    static_cast<float>(n.getY()),
+                                    static_cast<float>(n.getZ()));
+        }
 
-std::pair<double, Object*> RayMarchingRender::distanceToClosest(const Vector3& p) {
-    double closest_distance = std::numeric_limits<double>::infinity();
-    Object* closest_object = nullptr;
-
-    for (auto* object : objects) {
-        double dist = object->distanceToSurface(p);
-        if (dist < closest_distance) {
-            closest_distance = dist;
-            closest_object = object;
+        sf::Color c = o->getColorAtOrigin();
+        packed.color[i] = sf::Glsl::Vec3(c.r / 255.f, c.g / 255.f, c.b / 255.f);
+        // Do not override objColor2 for terrain (used to pack warp/ridged toggles)
+        if (packed.type[i] != 10.0f) {
+            packed.color2[i] = packed.color[i]; // same for primitives
         }
     }
 
-    return {closest_distance, closest_object};
+    // Get reflectivity for all objects
+    packed.reflectivity[i] = o->getReflectivity();
 }
 
 
+void RayMarchingRender::rebuildCsgProgram(const unsigned count) {
+    // The whole program is rebuilt whenever one tree changed: it is at most
+    // MAX_INSTRUCTIONS long, and the ranges of the other trees would shift anyway
+    csgProgram.clear();
+    for (unsigned i = 0; i < count; ++i) {
+        if (!usesCsgProgram(objects[i])) continue;
+        unsigned begin, end;
+        if (csgProgram.append(objects[i], begin, end)) {
+            packed.type[i] = 12.0f;
+            packed.radius[i] = static_cast<float>(begin);
+            packed.radius2[i] = static_cast<float>(end);
+        } else {
+            packed.type[i] = -1.0f;
+            if (csgWarned.insert(objects[i]).second)
+                std::cerr << "CSG object " << i << " cannot be rendered on the GPU "
+                             "(unsupported primitive, too deep or program full)\n";
+        }
+    }
+    if (csgProgram.size() > 0) {
+        shader.setUniformArray("u_csgProgram", csgProgram.rows.data(), csgProgram.rows.size());
+    }
+    csgDirty = false;
+}
 
-std::tuple<double, Vector3, Object&>
-RayMarchingRender::intersection(const Vector3& origin, const Vector3& dir) {
-    Vector3 pos = origin;
-    double distance_marched = 0.0;
-
-    constexpr double hit_epsilon  = 0.01;
-    constexpr double max_distance = 200.0;
-    constexpr unsigned max_steps  = 64;
-
-    Object* hit_obj = nullptr;
 
-    for (unsigned step = 0;
-         step < max_steps && distance_marched < max_distance;
-         ++step)
-    {
-        auto [d, obj] = distanceToClosest(pos);
-        if (!obj) break;                // no objects in scene – safety
+bool RayMarchingRender::usesCsgProgram(Object* object) {
+    return dynamic_cast<Union*>(object) || dynamic_cast<Intersection*>(object) || dynamic_cast<Difference*>(object)
+        || dynamic_cast<Repetition*>(object) || dynamic_cast<Instances*>(object) || dynamic_cast<Transform*>(object);
+}
 
-        if (d < hit_epsilon) {          // HIT: stop *before* marching past
-            hit_obj = obj;
-            break;
-        }
 
-        // Sphere-trace step
-        pos += dir * d;                 // no temp
-        distance_marched += d;
+void RayMarchingRender::uploadTileLists(const unsigned count, const CameraBasis& camera) {
+    std::vector<BoundingSphere> bounds(count);
+    for (unsigned i = 0; i < count; ++i) bounds[i] = scene ? scene->bounds[scene->idOf(objects[i])] : objects[i]->getBounds();
+    // Grown by the shader's hit tolerance: max(EPS, half the pixel footprint)
+    screenBins.build(bounds, camera, renderWidth, renderHeight, fov, 0, 0, renderWidth, renderHeight,
+                     0.001, Lod::hitEpsilon(0.0, Lod::pixelAngle(fov, renderHeight)));
+
+    const unsigned texWidth = screenBins.columns() * TILE_LIST_TEXELS;
+    std::vector<std::uint8_t> pixels(std::size_t(texWidth) * screenBins.rows() * 4, 0);
+    for (std::size_t t = 0; t < screenBins.tileCount(); ++t) {
+        const std::span<const std::uint32_t> list = screenBins.objects(t);
+        std::uint8_t* texels = &pixels[((t / screenBins.columns()) * texWidth + (t % screenBins.columns()) * TILE_LIST_TEXELS) * 4];
+        texels[0] = static_cast<std::uint8_t>(list.size());
+        for (std::size_t k = 0; k < list.size(); ++k) texels[4 + k] = static_cast<std::uint8_t>(list[k]);
     }
-
-    if (!hit_obj) {
-        return {-1.0, pos, *objects[0]};
+    const sf::Vector2u size(texWidth, screenBins.rows());
+    if (tileListTexture.getSize() == size || tileListTexture.resize(size)) {
+        tileListTexture.update(pixels.data());
     }
+}
+
 
-    return {distance_marched, pos, *hit_obj};
+void RayMarchingRender::onObjectChanged(const Object& object) {
+    // Changes inside CSG trees arrive for every node up to the top-level object
+    auto it = std::find(objects.begin(), objects.end(), &object);
+    const auto index = static_cast<std::size_t>(it - objects.begin());
+    if (index < repack.size()) repack[index] = 1;
 }
 
 
 void RayMarchingRender::renderFrame(Ray ray) {
+    renderFrame([&ray] { return ray; });
+}
+
+
+void RayMarchingRender::renderFrame(const std::function<Ray()>& latchCamera) {
+    if (scene) scene->commitChanges();
+    updateRenderSize();
+
+    if (useCpu && scene) {
+        renderFrameCPU(latchCamera());
+        return;
+    }
+
     // GPU path: ensure shader loaded
     if (!ensureShaderLoaded()) {
         return; // fallback: shader failed to load
     }
 
-    // Load textures from objects if not already loaded
-    if (textures.empty()) {
-        loadTexturesFromObjects();
+    // Sampler slots are handed out again as visible objects request their textures
+    textureResidency.beginFrame();
+
+    // Object data is packed once and afterwards only for objects the scene reports as
+    // changed; without a scene there are no change notifications, so everything is repacked
+    unsigned count = std::min<unsigned>(objects.size(), MAX_OBJECTS);
+    if (!scene || packed.type.size() != count) {
+        packed.resize(count);
+        repack.assign(count, 1);
+    }
+    for (unsigned i = 0; i < count; ++i) {
+        if (!repack[i]) continue;
+        packObject(i);
+        repack[i] = 0;
+    }
+    if (csgDirty) rebuildCsgProgram(count);
+
+    // Static shadows are only recomputed when the light or static geometry changed
+    if (shadowCache.update(objects, light, scene ? scene->staticVersion() : 0) && shadowCache.isEnabled()) {
+        std::vector<std::uint8_t> depthPixels;
+        shadowCache.packRGBA(depthPixels);
+        const sf::Vector2u size(shadowCache.resolution, shadowCache.resolution);
+        if (shadowTexture.getSize() == size || shadowTexture.resize(size)) {
+            shadowTexture.update(depthPixels.data());
+        }
     }
 
-    // Prepare camera basis
+    // Everything above is independent of the camera; it is latched only now, as late as possible
+    Ray ray = latchCamera();
     Vector3 camOrigin = ray.getOrigin();
     Vector3 camForward = ray.getDirection().normalized();
     Vector3 camRight = camForward.cross(Z).normalized();
@@ -95,154 +250,29 @@ void RayMarchingRender::renderFrame(Ray ray) {
     }
     Vector3 camUp = camRight.cross(camForward).normalized();
 
-    // Gather object data (limit to MAX_OBJECTS)
-    unsigned count = std::min<unsigned>(objects.size(), MAX_OBJECTS);
-    std::vector<sf::Glsl::Vec3> objPos(count);
-    std::vector<float> objRadius(count);
-    std::vector<float> objRadius2(count);
-    std::vector<sf::Glsl::Vec3> objColor(count);
-    std::vector<sf::Glsl::Vec3> objColor2(count);
-    std::vector<float> objType(count);
-    std::vector<sf::Glsl::Vec3> objNormal(count);
-    std::vector<float> objTextureIndex(count);  // Use float for shader compatibility
-    std::vector<float> objExtra(count);
-    std::vector<float> objReflectivity(count);
+    // View frustum matching the shader's projection (vertical FOV = fov)
+    const CameraBasis basis(camOrigin, camForward, Z);
+    const double tanHalfY = std::tan(fov / 2);
+    const double tanHalfX = tanHalfY * renderWidth / renderHeight;
 
     for (unsigned i = 0; i < count; ++i) {
         Object* o = objects[i];
-
-        // Assign objType based on dynamic cast
-        if (dynamic_cast<Sphere*>(o)) objType[i] = 0.0f;
-        else if (dynamic_cast<Plane*>(o)) objType[i] = 1.0f;
-        else if (dynamic_cast<Box*>(o)) objType[i] = 2.0f;
-        else if (dynamic_cast<Cylinder*>(o)) objType[i] = 3.0f;
-        else if (dynamic_cast<Capsule*>(o)) objType[i] = 4.0f;
-        else if (dynamic_cast<Torus*>(o)) objType[i] = 5.0f;
-        else if (dynamic_cast<Union*>(o)) objType[i] = 6.0f;
-        else if (dynamic_cast<Intersection*>(o)) objType[i] = 7.0f;
-        else if (dynamic_cast<Difference*>(o)) objType[i] = 8.0f;
-        else if (dynamic_cast<Mandelbulb*>(o)) objType[i] = 9.0f;
-        else if (dynamic_cast<Terrain*>(o)) objType[i] = 10.0f;
-        else if (dynamic_cast<QuaternionJulia*>(o)) objType[i] = 11.0f;
-        else objType[i] = -1.0f;
-
-        // For primitives and CSG, set data
-        if (objType[i] >= 6.0f && objType[i] <= 8.0f) { // CSG: Union(6), Intersection(7), Difference(8)
-            // Assume Union/Intersection/Difference of two spheres
-            Object* childA = nullptr;
-            Object* childB = nullptr;
-            if (auto* un = dynamic_cast<Union*>(o)) {
-                childA = un->getA();
-                childB = un->getB();
-            } else if (auto* inter = dynamic_cast<Intersection*>(o)) {
-                childA = inter->getA();
-                childB = inter->getB();
-            } else if (auto* diff = dynamic_cast<Difference*>(o)) {
-                childA = diff->getA();
-                childB = diff->getB();
-            }
-            if (childA && childB) {
-                auto* sphA = dynamic_cast<Sphere*>(childA);
-                auto* sphB = dynamic_cast<Sphere*>(childB);
-                if (sphA && sphB) {
-                    objPos[i] = sf::Glsl::Vec3(static_cast<float>(sphA->getCenter().getX()),
-                                               static_cast<float>(sphA->getCenter().getY()),
-                                               static_cast<float>(sphA->getCenter().getZ()));
-                    objRadius[i] = static_cast<float>(sphA->getRadius());
-                    objNormal[i] = sf::Glsl::Vec3(static_cast<float>(sphB->getCenter().getX()),
-                                                  static_cast<float>(sphB->getCenter().getY()),
-                                                  static_cast<float>(sphB->getCenter().getZ()));
-                    objRadius2[i] = static_cast<float>(sphB->getRadius());
-                    sf::Color cA = sphA->getColorAtOrigin();
-                    sf::Color cB = sphB->getColorAtOrigin();
-                    objColor[i] = sf::Glsl::Vec3(cA.r / 255.f, cA.g / 255.f, cA.b / 255.f);
-                    objColor2[i] = sf::Glsl::Vec3(cB.r / 255.f, cB.g / 255.f, cB.b / 255.f);
-                }
-            }
-            // CSG objects don't have textures
-            objTextureIndex[i] = -1.0f;
-        } else {
-            // For primitives
-            Vector3 center = o->getCenterOrPoint();
-            objPos[i] = sf::Glsl::Vec3(static_cast<float>(center.getX()),
-                                        static_cast<float>(center.getY()),
-                                        static_cast<float>(center.getZ()));
-
-            objRadius[i] = o->getRadiusOrSize();
-            objRadius2[i] = 0.0f;
-
-            if (objType[i] == 2.0f) { // box - store full size in objNormal
-                Box* box = dynamic_cast<Box*>(o);
-                Vector3 halfSize = box->getSize();
-                objNormal[i] = sf::Glsl::Vec3(static_cast<float>(halfSize.getX()),
-                                             static_cast<float>(halfSize.getY()),
-                                             static_cast<float>(halfSize.getZ()));
-                objRadius[i] = static_cast<float>(halfSize.getX()); // Keep X for compatibility
-            } else if (objType[i] == 4.0f) { // capsule
-                objRadius2[i] = dynamic_cast<Capsule*>(o)->getHeight();
-            } else if (objType[i] == 5.0f) { // torus
-                objRadius[i] = dynamic_cast<Torus*>(o)->getMajorRadius();
-                objRadius2[i] = dynamic_cast<Torus*>(o)->getMinorRadius();
-            } else if (objType[i] == 9.0f) { // mandelbulb
-                Mandelbulb* mb = dynamic_cast<Mandelbulb*>(o);
-                objRadius[i] = static_cast<float>(mb->scale);
-                objRadius2[i] = static_cast<float>(mb->power);
-                // Store iterations in objNormal.x (we'll extract it in shader)
-                // Don't overwrite this - Mandelbulb doesn't use getNormalAtOrigin()
-                objNormal[i] = sf::Glsl::Vec3(static_cast<float>(mb->iterations), 0.0f, 0.0f);
-            } else if (objType[i] == 10.0f) { // terrain
-                // Pack terrain parameters using existing arrays to avoid new uniforms
-                // u_objPos = (origin.x, seed, origin.z)
-                // u_objRadius = amplitude
-                // u_objRadius2 = base frequency
-                // u_objNormal = (octaves, lacunarity, gain)
-                // u_objColor2 = (warpStrength, ridgedToggle, warpToggle)
-                Terrain* t = dynamic_cast<Terrain*>(o);
-                // Center already set from getCenterOrPoint(): (origin.x, seed, origin.z)
-                objRadius[i] = t->getRadiusOrSize();
-                objRadius2[i] = t->getFrequency();
-                // getNormalAtOrigin encodes (octaves, lacunarity, gain)
-                Vector3 ng = t->getNormalAtOrigin();
-                objNormal[i] = sf::Glsl::Vec3(static_cast<float>(ng.getX()), static_cast<float>(ng.getY()), static_cast<float>(ng.getZ()));
-                objColor2[i] = sf::Glsl::Vec3(t->getWarpStrength(), t->isRidged() ? 1.0f : 0.0f, t->isWarpEnabled() ? 1.0f : 0.0f);
-                objExtra[i] = t->originXZ.getZ();
-            } else if (objType[i] == 11.0f) { // quaternion julia
-                QuaternionJulia* qj = dynamic_cast<QuaternionJulia*>(o);
-                objRadius[i] = static_cast<float>(qj->scale);
-                objRadius2[i] = 0.0f;
-                // Store Julia constant c in objNormal, iterations in objNormal.x
-                Vector3 juliaC = qj->c;
-                objNormal[i] = sf::Glsl::Vec3(static_cast<float>(qj->iterations),
-                                             static_cast<float>(juliaC.getX()),
-                                             static_cast<float>(juliaC.getY()));
-                // Store z component of c in objRadius2 (we'll use it in shader)
-                objRadius2[i] = static_cast<float>(juliaC.getZ());
-            } else {
-                // For other objects, set normal from getNormalAtOrigin()
-                Vector3 n = o->getNormalAtOrigin();
-                objNormal[i] = sf::Glsl::Vec3(static_cast<float>(n.getX()),
-                                            static_cast<float>(n.getY()),
-                                            static_cast<float>(n.getZ()));
-            }
-
-            sf::Color c = o->getColorAtOrigin();
-            objColor[i] = sf::Glsl::Vec3(c.r / 255.f, c.g / 255.f, c.b / 255.f);
-            // Do not override objColor2 for terrain (used to pack warp/ridged toggles)
-            if (objType[i] != 10.0f) {
-                objColor2[i] = objColor[i]; // same for primitives
-            }
-
-            // Get texture index for this object
-            std::string texPath = getTexturePath(o);
-            if (!texPath.empty() && textureMap.find(texPath) != textureMap.end()) {
-                objTextureIndex[i] = static_cast<float>(textureMap[texPath]);
-            } else {
-                objTextureIndex[i] = -1.0f; // No texture
+        packed.shadowCached[i] = shadowCache.covers(o) ? 1.0f : 0.0f;
+
+        // Textures are only made resident for objects that are actually on screen,
+        // at a resolution matching their projected size (CSG objects don't have textures)
+        packed.textureIndex[i] = -1.0f; // No texture
+        if (packed.type[i] == 12.0f) continue;
+        std::string texPath = getTexturePath(o);
+        if (!texPath.empty()) {
+            BoundingSphere bounds = scene ? scene->bounds[scene->idOf(o)] : o->getBounds();
+            double projected = bounds.isBounded()
+                ? basis.projectedDiameter(bounds.center, bounds.radius, tanHalfX, tanHalfY, renderHeight)
+                : std::numeric_limits<double>::infinity();
+            if (projected > 0.0) {
+                packed.textureIndex[i] = static_cast<float>(textureResidency.request(texPath, projected));
             }
         }
-
-        // Get reflectivity for all objects
-        objReflectivity[i] = o->getReflectivity();
     }
 
     // for (unsigned i = 0; i < count; ++i) {
@@ -272,7 +302,10 @@ void RayMarchingRender::renderFrame(Ray ray) {
     // }
 
     // Set shader uniforms
-    shader.setUniform("u_resolution", sf::Glsl::Vec2(static_cast<float>(width), static_cast<float>(height)));
+    const ResolutionGovernor::Quality& quality = governor.quality();
+    shader.setUniform("u_resolution", sf::Glsl::Vec2(static_cast<float>(renderWidth), static_cast<float>(renderHeight)));
+    shader.setUniform("u_maxSteps", static_cast<int>(quality.maxSteps));
+    shader.setUniform("u_reflectionDepth", quality.reflectionDepth);
     shader.setUniform("u_camOrigin", sf::Glsl::Vec3(static_cast<float>(camOrigin.getX()), static_cast<float>(camOrigin.getY()), static_cast<float>(camOrigin.getZ())));
     shader.setUniform("u_camForward", sf::Glsl::Vec3(static_cast<float>(camForward.getX()), static_cast<float>(camForward.getY()), static_cast<float>(camForward.getZ())));
     shader.setUniform("u_camRight", sf::Glsl::Vec3(static_cast<float>(camRight.getX()), static_cast<float>(camRight.getY()), static_cast<float>(camRight.getZ())));
@@ -281,16 +314,17 @@ void RayMarchingRender::renderFrame(Ray ray) {
     shader.setUniform("u_light", sf::Glsl::Vec3(static_cast<float>(light.getX()), static_cast<float>(light.getY()), static_cast<float>(light.getZ())));
     shader.setUniform("u_objCount", static_cast<int>(count));
     if (count > 0) {
-        shader.setUniformArray("u_objPos", objPos.data(), count);
-        shader.setUniformArray("u_objColor", objColor.data(), count);
-        shader.setUniformArray("u_objColor2", objColor2.data(), count);
-        shader.setUniformArray("u_objNormal", objNormal.data(), count);
-        shader.setUniformArray("u_objRadius", objRadius.data(), count);
-        shader.setUniformArray("u_objRadius2", objRadius2.data(), count);
-        shader.setUniformArray("u_objType", objType.data(), count);
-        shader.setUniformArray("u_objTextureIndex", objTextureIndex.data(), count);
-        shader.setUniformArray("u_objExtra", objExtra.data(), count);
-        shader.setUniformArray("u_objReflectivity", objReflectivity.data(), count);
+        shader.setUniformArray("u_objPos", packed.pos.data(), count);
+        shader.setUniformArray("u_objColor", packed.color.data(), count);
+        shader.setUniformArray("u_objColor2", packed.color2.data(), count);
+        shader.setUniformArray("u_objNormal", packed.normal.data(), count);
+        shader.setUniformArray("u_objRadius", packed.radius.data(), count);
+        shader.setUniformArray("u_objRadius2", packed.radius2.data(), count);
+        shader.setUniformArray("u_objType", packed.type.data(), count);
+        shader.setUniformArray("u_objTextureIndex", packed.textureIndex.data(), count);
+        shader.setUniformArray("u_objExtra", packed.extra.data(), count);
+        shader.setUniformArray("u_objReflectivity", packed.reflectivity.data(), count);
+        shader.setUniformArray("u_objShadowCached", packed.shadowCached.data(), count);
     } else {
         // Set empty arrays to avoid shader errors
         std::vector<sf::Glsl::Vec3> emptyVec3(1);
@@ -303,23 +337,85 @@ void RayMarchingRender::renderFrame(Ray ray) {
         shader.setUniformArray("u_objRadius2", emptyFloat.data(), 1);
         shader.setUniformArray("u_objType", emptyFloat.data(), 1);
         shader.setUniformArray("u_objReflectivity", emptyFloat.data(), 1);
+        shader.setUniformArray("u_objShadowCached", emptyFloat.data(), 1);
+    }
+
+    shader.setUniform("u_tileListsEnabled", useScreenBins ? 1.0f : 0.0f);
+    if (useScreenBins) {
+        uploadTileLists(count, basis);
+        shader.setUniform("u_tileLists", tileListTexture);
+        shader.setUniform("u_tileListSize", sf::Glsl::Vec2(static_cast<float>(tileListTexture.getSize().x), static_cast<float>(tileListTexture.getSize().y)));
+    }
+
+    shader.setUniform("u_shadowMapEnabled", shadowCache.isEnabled() ? 1.0f : 0.0f);
+    if (shadowCache.isEnabled()) {
+        auto vec3 = [](const Vector3& v) {
+            return sf::Glsl::Vec3(static_cast<float>(v.getX()), static_cast<float>(v.getY()), static_cast<float>(v.getZ()));
+        };
+        shader.setUniform("u_shadowMap", shadowTexture);
+        shader.setUniform("u_shadowMapSize", static_cast<float>(shadowCache.resolution));
+        shader.setUniform("u_shadowOrigin", vec3(shadowCache.origin));
+        shader.setUniform("u_shadowAxisU", vec3(shadowCache.axisU));
+        shader.setUniform("u_shadowAxisV", vec3(shadowCache.axisV));
+        shader.setUniform("u_shadowExtent", static_cast<float>(shadowCache.extent));
+        shader.setUniform("u_shadowRange", static_cast<float>(shadowCache.range));
     }
     
     // Set textures to individual shader uniforms (GLSL doesn't support dynamic sampler array indexing)
-    // Only set textures that were successfully loaded
-    if (numTexturesLoaded > 0) shader.setUniform("u_texture0", textures[0]);
-    if (numTexturesLoaded > 1) shader.setUniform("u_texture1", textures[1]);
-    if (numTexturesLoaded > 2) shader.setUniform("u_texture2", textures[2]);
-    if (numTexturesLoaded > 3) shader.setUniform("u_texture3", textures[3]);
-    if (numTexturesLoaded > 4) shader.setUniform("u_texture4", textures[4]);
-    if (numTexturesLoaded > 5) shader.setUniform("u_texture5", textures[5]);
-    if (numTexturesLoaded > 6) shader.setUniform("u_texture6", textures[6]);
-    if (numTexturesLoaded > 7) shader.setUniform("u_texture7", textures[7]);
-
-    // Draw full-screen quad with shader
-    sf::RectangleShape quad(sf::Vector2f(static_cast<float>(width), static_cast<float>(height)));
-    quad.setPosition(sf::Vector2f(0.f, 0.f));
-    window.draw(quad, &shader);
+    // Only the slots requested this frame are bound
+    const auto& slots = textureResidency.slots;
+    for (unsigned slot = 0; slot < slots.size(); ++slot) {
+        shader.setUniform("u_texture" + std::to_string(slot), *slots[slot]);
+    }
+
+    // Draw a quad covering the render resolution into the offscreen target. It is placed at
+    // the bottom, where GL's window coordinates start, so gl_FragCoord runs from 0 as usual.
+    if (target.getSize() != sf::Vector2u(width, height)) {
+        if (!target.resize({width, height})) return;
+        target.setSmooth(true);
+    }
+    sf::RectangleShape quad(sf::Vector2f(static_cast<float>(renderWidth), static_cast<float>(renderHeight)));
+    quad.setPosition(sf::Vector2f(0.f, static_cast<float>(height - renderHeight)));
+    target.clear();
+    target.draw(quad, &shader);
+    target.display();
+    present(target.getTexture(), true);
+}
+
+
+void RayMarchingRender::renderFrameCPU(Ray ray) {
+    if (!cpu) cpu = std::make_unique<CpuRenderer>(*scene, light, fov);
+    cpu->light = light;
+    cpu->fov = fov;
+
+    cpu->maxSteps = governor.quality().maxSteps;
+    cpu->maxReflectionDepth = governor.quality().reflectionDepth;
+
+    CameraBasis basis(ray.getOrigin(), ray.getDirection(), Z);
+    cpu->render(basis, renderWidth, renderHeight, cpuPixels);
+
+    if (cpuFrame.getSize() != sf::Vector2u(width, height)) {
+        if (!cpuFrame.resize({width, height})) return;
+        cpuFrame.setSmooth(true);
+    }
+    cpuFrame.update(cpuPixels.data(), {renderWidth, renderHeight}, {0, 0});
+    present(cpuFrame, false);
+}
+
+
+void RayMarchingRender::updateRenderSize() {
+    const double scale = governor.quality().scale;
+    renderWidth = std::max(1u, std::min(width, static_cast<unsigned>(std::lround(width * scale))));
+    renderHeight = std::max(1u, std::min(height, static_cast<unsigned>(std::lround(height * scale))));
+}
+
+
+void RayMarchingRender::present(const sf::Texture& frame, const bool fromBottom) {
+    const int top = fromBottom ? static_cast<int>(frame.getSize().y - renderHeight) : 0;
+    sf::Sprite sprite(frame);
+    sprite.setTextureRect(sf::IntRect({0, top}, {static_cast<int>(renderWidth), static_cast<int>(renderHeight)}));
+    sprite.setScale({static_cast<float>(width) / renderWidth, static_cast<float>(height) / renderHeight});
+    window.draw(sprite);
 }
 
 
@@ -341,6 +437,7 @@ bool RayMarchingRender::ensureShaderLoaded() {
 }
 
 std::string RayMarchingRender::getTexturePath(Object* obj) {
+    if (scene) return scene->texturePath(obj);
     if (auto* box = dynamic_cast<Box*>(obj)) {
         return box->texture;
     } else if (auto* sphere = dynamic_cast<Sphere*>(obj)) {
@@ -352,51 +449,3 @@ std::string RayMarchingRender::getTexturePath(Object* obj) {
     }
     return "";
 }
-
-void RayMarchingRender::loadTexturesFromObjects() {
-    textures.clear();
-    textureMap.clear();
-    objectTextureIndices.clear();
-
-    // Collect all unique texture paths
-    std::map<std::string, unsigned> pathToIndex;
-    unsigned nextIndex = 0;
-
-    for (Object* obj : objects) {
-        std::string texPath = getTexturePath(obj);
-        if (!texPath.empty() && pathToIndex.find(texPath) == pathToIndex.end()) {
-            pathToIndex[texPath] = nextIndex++;
-        }
-    }
-
-    // Load textures
-    textures.resize(pathToIndex.size());
-    for (const auto& pair : pathToIndex) {
-        const std::string& path = pair.first;
-        unsigned index = pair.second;
-
-        // Try different path variations
-        std::vector<std::string> paths = {
-            path,
-            "../" + path,
-            "./" + path
-        };
-
-        bool loaded = false;
-        for (const auto& tryPath : paths) {
-            if (textures[index].loadFromFile(tryPath)) {
-                textures[index].setRepeated(true);
-                textureMap[path] = index;
-                loaded = true;
-                break;
-            }
-        }
-
-        if (!loaded) {
-            // If loading failed, remove from map
-            textureMap.erase(path);
-        } else {
-            numTexturesLoaded = std::max(numTexturesLoaded, index + 1);
-        }
-    }
-}
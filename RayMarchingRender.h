@@ -8,9 +8,19 @@
 #include "Vector3.h"
 #include "Objects/Object.h"
 #include "Angle.h"
+#include "TextureResidency.h"
+#include "Scene.h"
+#include "CpuRenderer.h"
+#include "ShadowCache.h"
+#include "CsgProgram.h"
+#include "ResolutionGovernor.h"
+#include "ScreenBins.h"
 #include <vector>
+#include <functional>
 #include <map>
+#include <set>
 #include <string>
+#include <memory>
 
 
 #ifndef TEST3D_SFMLRENDER_H
@@ -23,14 +33,50 @@ struct RayMarchingRender {
     double fov;
     sf::RenderWindow window;
     std::vector<Object*> objects;
+    Scene* scene = nullptr;  // when set, CPU queries go through its SoA tables
     sf::Shader shader;
     bool shaderLoaded = false;
-    std::vector<sf::Texture> textures;  // Store loaded textures
-    std::map<std::string, unsigned> textureMap;  // Map texture path to texture index
-    std::vector<int> objectTextureIndices;  // Map object index to texture index (-1 = no texture)
-    unsigned numTexturesLoaded = 0;  // Track how many textures are actually loaded
+    TextureResidency textureResidency;  // Budgeted, lazily loaded object textures
+    ShadowCache shadowCache;            // Static shadows, uploaded as u_shadowMap
+    sf::Texture shadowTexture;
+
+    // Shader uniform arrays, one entry per uploaded object
+    struct PackedObjects {
+        std::vector<sf::Glsl::Vec3> pos, color, color2, normal;
+        std::vector<float> radius, radius2, type, textureIndex, extra, reflectivity, shadowCached;
+
+        void resize(unsigned count) {
+            for (auto* v : {&pos, &color, &color2, &normal}) v->assign(count, sf::Glsl::Vec3());
+            for (auto* v : {&radius, &radius2, &type, &textureIndex, &extra, &reflectivity, &shadowCached}) v->assign(count, 0.0f);
+        }
+    } packed;
+    std::vector<std::uint8_t> repack;  // objects to repack before the next GPU frame
+    CsgProgram csgProgram;             // All CSG objects, uploaded as u_csgProgram
+    bool csgDirty = true;
+    std::set<const Object*> csgWarned;  // CSG objects already reported as not renderable on the GPU
+    int changeListener = -1;
     static constexpr unsigned MAX_OBJECTS = 32;
 
+    // Primary rays only evaluate the objects their screen tile can see. The lists go to
+    // the shader as u_tileLists: a row of texels per tile row, TILE_LIST_TEXELS per tile
+    // (the object count, then four object indices per texel).
+    bool useScreenBins = true;
+    ScreenBins screenBins;
+    sf::Texture tileListTexture;
+    static constexpr unsigned TILE_LIST_TEXELS = 1 + MAX_OBJECTS / 4;
+
+    // Frames are rendered offscreen at governor.quality().scale times the window size and
+    // upscaled into the window; the governor is fed the measured frame times by the caller
+    ResolutionGovernor governor;
+    sf::RenderTexture target;  // window-sized; the GPU path draws into its lower-left corner
+    unsigned renderWidth = 0, renderHeight = 0;
+
+    // CPU back end (only available when rendering a Scene)
+    bool useCpu = false;
+    std::unique_ptr<CpuRenderer> cpu;
+    std::vector<std::uint8_t> cpuPixels;
+    sf::Texture cpuFrame;
+
 
     RayMarchingRender(unsigned width, unsigned height, double fov, const Vector3& light, const std::vector<Object*>& objects) :
         width(width), height(height), fov(fov), objects(objects), light(light),
@@ -38,27 +84,50 @@ struct RayMarchingRender {
 
     RayMarchingRender(const short width, const short height, const double fov, const std::vector<Object*>& objects) :
         RayMarchingRender(width, height, fov, Z*-1, objects) {}
+
+    RayMarchingRender(unsigned width, unsigned height, double fov, const Vector3& light, Scene& scene) :
+        RayMarchingRender(width, height, fov, light, scene.objects) {
+        this->scene = &scene;
+        changeListener = scene.subscribe([this](const Object& object) { onObjectChanged(object); });
+    }
+
+    ~RayMarchingRender() {
+        if (scene) scene->unsubscribe(changeListener);
+    }
+
     void renderFrame(Ray);
+    // Renders with the camera returned by latchCamera, which is called once the camera-
+    // independent preparation (scene changes, packing, shadow map) is done
+    void renderFrame(const std::function<Ray()>& latchCamera);
+    void renderFrameCPU(Ray);
+    // Picks this frame's internal resolution from the governor
+    void updateRenderSize();
+    // Upscales the renderWidth x renderHeight pixels in the lower-left (`fromBottom`, as
+    // rendered through GL) or upper-left corner of `frame` to the whole window
+    void present(const sf::Texture& frame, bool fromBottom);
+    void packObject(unsigned index);
+    void onObjectChanged(const Object& object);
+    // Flattens every CSG object into csgProgram and uploads it
+    void rebuildCsgProgram(unsigned count);
+    // Bins the first `count` objects into screen tiles for this frame's camera and uploads the lists
+    void uploadTileLists(unsigned count, const CameraBasis& camera);
+    // CSG operators and domain nodes (repetition, transforms) are evaluated by the program
+    static bool usesCsgProgram(Object* object);
     bool ensureShaderLoaded();
-    void loadTexturesFromObjects();
     std::string getTexturePath(Object* obj);
-    std::tuple<double, Vector3, Object&> intersection(const Vector3&, const Vector3&);
-    std::pair<double, Object*> distanceToClosest(const Vector3&);
 
-    void setWidth(unsigned newWidth) {
-        width = newWidth;
-        window.create(sf::VideoMode({width, height}), "Presentation");
-    }
+    void setTextureBudget(std::size_t bytes) { textureResidency.setBudget(bytes); }
 
-    void setHeight(unsigned newHeight) {
-        height = newHeight;
-        window.create(sf::VideoMode({width, height}), "Presentation");
-    }
+    // Follows a window the OS has already resized: only the view and the offscreen target
+    // change, nothing is recreated. The window itself is left alone, since this runs on the
+    // render thread while the main thread polls the window's events
+    void setWidth(unsigned newWidth) { setSize(newWidth, height); }
+    void setHeight(unsigned newHeight) { setSize(width, newHeight); }
 
     void setSize(unsigned newWidth, unsigned newHeight) {
         width = newWidth;
         height = newHeight;
-        window.create(sf::VideoMode({width, height}), "Presentation");
+        window.setView(sf::View(sf::FloatRect({0.f, 0.f}, {static_cast<float>(width), static_cast<float>(height)})));
     }
 
 };
@@ -0,0 +1,98 @@
+#include "RayQueue.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+
+namespace {
+    // Spreads the low 10 bits of v so there are two zero bits between each
+    std::uint64_t spreadBits(std::uint64_t v) {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    std::uint64_t quantize(double v, double lo, double scale) {
+        return static_cast<std::uint64_t>(std::clamp((v - lo) * scale, 0.0, 1023.0));
+    }
+
+    template<class T>
+    void permute(std::vector<T>& values, const std::vector<std::uint32_t>& order) {
+        if (values.size() != order.size()) return;
+        std::vector<T> sorted;
+        sorted.reserve(values.size());
+        for (std::uint32_t i : order) sorted.push_back(values[i]);
+        values.swap(sorted);
+    }
+}
+
+void RayQueue::clear() {
+    origin.clear();
+    dir.clear();
+    pixel.clear();
+    throughput.clear();
+    weight.clear();
+    t.clear();
+    hit.clear();
+    normal.clear();
+    visibility.clear();
+}
+
+void RayQueue::push(const Vector3& o, const Vector3& d, const std::uint32_t px, const float pathThroughput, const float pathWeight) {
+    origin.push_back(o);
+    dir.push_back(d);
+    pixel.push_back(px);
+    throughput.push_back(pathThroughput);
+    weight.push_back(pathWeight);
+}
+
+void RayQueue::prepareOutputs() {
+    t.assign(size(), -1.0);
+    hit.assign(size(), SdfSample{});
+    normal.resize(size());
+    visibility.assign(size(), 1.0f);
+}
+
+void RayQueue::sortCoherent() {
+    const std::size_t n = size();
+    if (n < 2) return;
+
+    double lo[3], hi[3];
+    std::fill(lo, lo + 3, std::numeric_limits<double>::infinity());
+    std::fill(hi, hi + 3, -std::numeric_limits<double>::infinity());
+    for (const Vector3& o : origin) {
+        const double c[3] = {o.getX(), o.getY(), o.getZ()};
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], c[a]);
+            hi[a] = std::max(hi[a], c[a]);
+        }
+    }
+    double scale[3];
+    for (int a = 0; a < 3; ++a) scale[a] = hi[a] > lo[a] ? 1023.0 / (hi[a] - lo[a]) : 0.0;
+
+    // Direction octant in the top bits, then the origin's Morton code
+    keys.resize(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const Vector3& o = origin[i];
+        const Vector3& d = dir[i];
+        const std::uint64_t octant = (d.getX() < 0 ? 1u : 0u) | (d.getY() < 0 ? 2u : 0u) | (d.getZ() < 0 ? 4u : 0u);
+        const std::uint64_t morton = spreadBits(quantize(o.getX(), lo[0], scale[0]))
+                                   | spreadBits(quantize(o.getY(), lo[1], scale[1])) << 1
+                                   | spreadBits(quantize(o.getZ(), lo[2], scale[2])) << 2;
+        keys[i] = octant << 30 | morton;
+    }
+
+    order.resize(n);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) { return keys[a] < keys[b]; });
+
+    permute(origin, order);
+    permute(dir, order);
+    permute(pixel, order);
+    permute(throughput, order);
+    permute(weight, order);
+}
@@ -0,0 +1,44 @@
+#ifndef RENDERING_PROJECT_RAYQUEUE_H
+#define RENDERING_PROJECT_RAYQUEUE_H
+
+#include "Objects/Object.h"
+#include "Vector3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Compacted queue of rays in flight between two wavefront stages. Every entry belongs
+// to one pixel and carries its path weights; the march stage fills t / hit, and a
+// queue of hits reuses origin as the hit position and fills normal / visibility.
+struct RayQueue {
+    std::vector<Vector3> origin, dir;
+    std::vector<std::uint32_t> pixel;
+    std::vector<float> throughput;  // product of reflectivities along the path
+    std::vector<float> weight;      // contribution of this ray to its pixel
+
+    // Stage outputs
+    std::vector<double> t;          // hit distance, -1 = miss
+    std::vector<SdfSample> hit;     // leaf, top-level object and material; leaf == nullptr on a miss
+    std::vector<Vector3> normal;
+    std::vector<float> visibility;
+
+    [[nodiscard]] std::size_t size() const { return pixel.size(); }
+    [[nodiscard]] bool empty() const { return pixel.empty(); }
+
+    void clear();
+    void push(const Vector3& o, const Vector3& d, std::uint32_t px, float pathThroughput, float pathWeight);
+    // Sizes the stage output arrays to match the queue
+    void prepareOutputs();
+
+    // Reorders the queue so rays with similar direction (same octant) and nearby
+    // origins (Morton order inside the queue's bounding box) are marched together
+    void sortCoherent();
+
+private:
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> order;
+};
+
+
+#endif //RENDERING_PROJECT_RAYQUEUE_H
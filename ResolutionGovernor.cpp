@@ -0,0 +1,70 @@
+#include "ResolutionGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+    constexpr double SMOOTHING = 0.2;       // weight of the newest frame in the running average
+    constexpr double OVER_BUDGET = 0.95;    // act once frames take longer than budget / 0.95 ...
+    constexpr double UNDER_BUDGET = 1.15;   // ... or less than budget / 1.15
+    constexpr double MAX_SCALE_DROP = 0.85; // per-frame limits on resolution changes
+    constexpr double MAX_SCALE_RISE = 1.05;
+    constexpr double STEP_FACTOR = 1.25;
+    constexpr int SETTLE_FRAMES = 8;        // about the averaging window
+}
+
+void ResolutionGovernor::update(const double frameMs) {
+    if (!enabled || frameMs <= 0.0) {
+        if (!enabled) reset();
+        return;
+    }
+
+    smoothedMs = smoothedMs > 0.0 ? smoothedMs + SMOOTHING * (frameMs - smoothedMs) : frameMs;
+    if (settle > 0) {
+        --settle;
+        return;
+    }
+
+    const double ratio = targetMs / smoothedMs;
+    if (ratio < OVER_BUDGET) degrade(ratio);
+    else if (ratio > UNDER_BUDGET) improve(ratio);
+}
+
+void ResolutionGovernor::reset() {
+    current = {maxScale, maxSteps, maxReflectionDepth};
+    smoothedMs = 0.0;
+    settle = 0;
+}
+
+void ResolutionGovernor::degrade(const double ratio) {
+    if (current.scale > minScale) {
+        rescale(std::max(minScale, current.scale * std::max(std::sqrt(ratio), MAX_SCALE_DROP)));
+    } else if (current.maxSteps > minSteps) {
+        current.maxSteps = std::max(minSteps, static_cast<unsigned>(current.maxSteps / STEP_FACTOR));
+        settle = SETTLE_FRAMES;
+    } else if (current.reflectionDepth > 0) {
+        --current.reflectionDepth;
+        settle = SETTLE_FRAMES;
+    }
+}
+
+void ResolutionGovernor::improve(const double ratio) {
+    if (current.reflectionDepth < maxReflectionDepth) {
+        ++current.reflectionDepth;
+        settle = SETTLE_FRAMES;
+    } else if (current.maxSteps < maxSteps) {
+        current.maxSteps = std::min(maxSteps, static_cast<unsigned>(std::ceil(current.maxSteps * STEP_FACTOR)));
+        settle = SETTLE_FRAMES;
+    } else if (current.scale < maxScale) {
+        rescale(std::min(maxScale, current.scale * std::min(std::sqrt(ratio), MAX_SCALE_RISE)));
+    }
+}
+
+void ResolutionGovernor::rescale(const double scale) {
+    // Frame time is roughly proportional to the pixel count. The running average is moved
+    // by the expected change right away, otherwise its lag makes the scale overshoot.
+    const double factor = scale / current.scale;
+    smoothedMs *= factor * factor;
+    current.scale = scale;
+}
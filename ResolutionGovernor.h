@@ -0,0 +1,44 @@
+#ifndef RENDERING_PROJECT_RESOLUTIONGOVERNOR_H
+#define RENDERING_PROJECT_RESOLUTIONGOVERNOR_H
+
+
+// Holds a frame-time budget by trading image quality. Fed with the measured time of
+// every frame, it adjusts the internal render resolution first (cost ~ scale^2), and
+// only once that is at its minimum the ray step limit and then the reflection depth.
+// Quality is restored in the opposite order when frames come in under budget.
+class ResolutionGovernor {
+public:
+    struct Quality {
+        double scale;         // render resolution / window resolution
+        unsigned maxSteps;    // sphere-tracing steps per ray
+        int reflectionDepth;  // reflection bounces
+    };
+
+    bool enabled = true;
+    double targetMs = 1000.0 / 60.0;
+
+    // Limits; the maxima are what is rendered while the governor is disabled
+    double minScale = 0.35, maxScale = 1.0;
+    unsigned minSteps = 96, maxSteps = 512;
+    int maxReflectionDepth = 2;
+
+    // Takes the duration of the last frame and updates quality() for the next one
+    void update(double frameMs);
+    // Back to full quality, forgetting the measured frame times
+    void reset();
+
+    [[nodiscard]] const Quality& quality() const { return current; }
+    [[nodiscard]] double smoothedFrameMs() const { return smoothedMs; }
+
+private:
+    Quality current{1.0, 512, 2};
+    double smoothedMs = 0.0;
+    int settle = 0;  // frames to wait after a discrete change (steps, depth) before the next
+
+    void degrade(double ratio);
+    void improve(double ratio);
+    void rescale(double scale);
+};
+
+
+#endif //RENDERING_PROJECT_RESOLUTIONGOVERNOR_H
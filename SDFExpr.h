@@ -0,0 +1,192 @@
+#ifndef RENDERING_PROJECT_SDFEXPR_H
+#define RENDERING_PROJECT_SDFEXPR_H
+
+#include "Objects/Object.h"
+#include "Vector3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+
+// Compile-time SDF composition. The same primitives and CSG operators as Objects/ and
+// CSGoperations/, but as value types: a tree such as
+//
+//     constexpr auto shape = sdf::union_(sdf::sphere({0, 0, 1}, 1),
+//                                        sdf::difference(sdf::box({2, 0, 1}, {1, 1, 1}),
+//                                                        sdf::torus({2, 0, 1}, 1, 0.3)));
+//
+// is one object whose type encodes the whole tree, with no heap nodes and no virtual
+// calls, so shape(p) inlines into a single function. Parameters are constexpr, the
+// evaluation itself is not (std::sqrt). Use sdf::march / sdf::distances directly, or
+// wrap the expression in sdf::ExprObject to place it in a Scene as one Object.
+namespace sdf {
+
+    struct Vec {
+        double x = 0, y = 0, z = 0;
+    };
+
+    inline double length(double x, double y) { return std::sqrt(x*x + y*y); }
+    inline double length(double x, double y, double z) { return std::sqrt(x*x + y*y + z*z); }
+
+    // ---- Primitives (same formulas as the runtime objects) ----
+
+    struct Sphere {
+        Vec c; double r;
+        double operator()(double x, double y, double z) const { return length(x - c.x, y - c.y, z - c.z) - r; }
+    };
+
+    struct Box {
+        Vec c, h;
+        double operator()(double x, double y, double z) const {
+            const double qx = std::abs(x - c.x) - h.x, qy = std::abs(y - c.y) - h.y, qz = std::abs(z - c.z) - h.z;
+            return length(std::max(qx, 0.0), std::max(qy, 0.0), std::max(qz, 0.0)) + std::min(std::max(qx, std::max(qy, qz)), 0.0);
+        }
+    };
+
+    struct Plane {
+        Vec point, n;
+        double operator()(double x, double y, double z) const { return (x - point.x)*n.x + (y - point.y)*n.y + (z - point.z)*n.z; }
+    };
+
+    struct Torus {
+        Vec c; double R, r;
+        double operator()(double x, double y, double z) const {
+            const double qx = x - c.x, qy = y - c.y, qz = z - c.z;
+            return length(length(qx, qz) - R, qy) - r;
+        }
+    };
+
+    struct Cylinder {
+        Vec c; double r, halfHeight;
+        double operator()(double x, double y, double z) const {
+            const double qx = x - c.x, qy = y - c.y, qz = z - c.z;
+            const double dx = length(qx, qz) - r, dy = std::abs(qy) - halfHeight;
+            return std::min(std::max(dx, dy), 0.0) + length(std::max(dx, 0.0), std::max(dy, 0.0));
+        }
+    };
+
+    struct Capsule {
+        Vec a, b; double r;
+        double operator()(double x, double y, double z) const {
+            const double pax = x - a.x, pay = y - a.y, paz = z - a.z;
+            const double bax = b.x - a.x, bay = b.y - a.y, baz = b.z - a.z;
+            const double h = std::clamp((pax*bax + pay*bay + paz*baz) / (bax*bax + bay*bay + baz*baz), 0.0, 1.0);
+            return length(pax - bax*h, pay - bay*h, paz - baz*h) - r;
+        }
+    };
+
+    // ---- Operators ----
+
+    template<class A, class B>
+    struct Union {
+        A a; B b;
+        double operator()(double x, double y, double z) const { return std::min(a(x, y, z), b(x, y, z)); }
+    };
+
+    template<class A, class B>
+    struct Intersection {
+        A a; B b;
+        double operator()(double x, double y, double z) const { return std::max(a(x, y, z), b(x, y, z)); }
+    };
+
+    template<class A, class B>
+    struct Difference {
+        A a; B b;
+        double operator()(double x, double y, double z) const { return std::max(a(x, y, z), -b(x, y, z)); }
+    };
+
+    template<class A>
+    struct Translate {
+        A a; Vec offset;
+        double operator()(double x, double y, double z) const { return a(x - offset.x, y - offset.y, z - offset.z); }
+    };
+
+    template<class A>
+    struct Scale {
+        A a; double s;
+        double operator()(double x, double y, double z) const { return a(x / s, y / s, z / s) * s; }
+    };
+
+    // Same folding as Repetition; a zero spacing leaves that axis alone
+    template<class A>
+    struct Repeat {
+        A a; Vec spacing, limit;
+        static double fold(double v, double s, double l) {
+            return s == 0.0 ? v : v - s * std::clamp(std::floor(v / s + 0.5), -l, l);
+        }
+        double operator()(double x, double y, double z) const {
+            return a(fold(x, spacing.x, limit.x), fold(y, spacing.y, limit.y), fold(z, spacing.z, limit.z));
+        }
+    };
+
+    // ---- Builders ----
+
+    constexpr Sphere sphere(Vec c, double r) { return {c, r}; }
+    constexpr Box box(Vec c, Vec halfSize) { return {c, halfSize}; }
+    constexpr Plane plane(Vec point, Vec normal) { return {point, normal}; }
+    constexpr Torus torus(Vec c, double R, double r) { return {c, R, r}; }
+    constexpr Cylinder cylinder(Vec c, double r, double halfHeight) { return {c, r, halfHeight}; }
+    constexpr Capsule capsule(Vec a, Vec b, double r) { return {a, b, r}; }
+
+    template<class A, class B> constexpr Union<A, B> union_(A a, B b) { return {a, b}; }
+    template<class A, class B> constexpr Intersection<A, B> intersection(A a, B b) { return {a, b}; }
+    template<class A, class B> constexpr Difference<A, B> difference(A a, B b) { return {a, b}; }
+    template<class A> constexpr Translate<A> translate(A a, Vec offset) { return {a, offset}; }
+    template<class A> constexpr Scale<A> scale(A a, double s) { return {a, s}; }
+    template<class A> constexpr Repeat<A> repeat(A a, Vec spacing, Vec limit = {1e300, 1e300, 1e300}) { return {a, spacing, limit}; }
+
+    // Unions of more than two operands, folded left
+    template<class A, class B, class C, class... Rest>
+    constexpr auto union_(A a, B b, C c, Rest... rest) { return union_(union_(a, b), c, rest...); }
+
+    // ---- Queries ----
+
+    template<class E>
+    double distance(const E& e, const Vector3& p) { return e(p.getX(), p.getY(), p.getZ()); }
+
+    // Central-difference gradient, normalised
+    template<class E>
+    Vector3 normal(const E& e, const Vector3& p, double h = 1e-5) {
+        const double x = p.getX(), y = p.getY(), z = p.getZ();
+        return Vector3(e(x + h, y, z) - e(x - h, y, z), e(x, y + h, z) - e(x, y - h, z), e(x, y, z + h) - e(x, y, z - h)).normalized();
+    }
+
+    // Sphere tracing with the CPU renderer's defaults; returns the hit distance or -1
+    template<class E>
+    double march(const E& e, const Vector3& origin, const Vector3& dir,
+                 unsigned maxSteps = 512, double epsilon = 1e-3, double maxDistance = 100.0) {
+        double t = 0.0;
+        for (unsigned step = 0; step < maxSteps && t < maxDistance; ++step) {
+            const double d = e(origin.getX() + dir.getX() * t, origin.getY() + dir.getY() * t, origin.getZ() + dir.getZ() * t);
+            if (d < epsilon) return t;
+            t += d;
+        }
+        return -1.0;
+    }
+
+    // Batch query over coordinate arrays
+    template<class E>
+    void distances(const E& e, const double* xs, const double* ys, const double* zs, double* out, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) out[i] = e(xs[i], ys[i], zs[i]);
+    }
+
+    // An expression as a single scene object: one virtual call for the whole tree
+    template<class E>
+    struct ExprObject : public ::Object {
+        E expr;
+        sf::Color color;
+        BoundingSphere bounds;  // supplied by the caller; expressions do not compute bounds
+
+        ExprObject(E expr, sf::Color color, BoundingSphere bounds = {}) : expr(std::move(expr)), color(color), bounds(bounds) {}
+
+        double distanceToSurface(const Vector3& p) override { return distance(expr, p); }
+        Vector3 getNormalAt(const Vector3& p) override { return normal(expr, p); }
+        sf::Color getColorAt(const Vector3&) override { return color; }
+        sf::Color getColorAtOrigin() const override { return color; }
+        BoundingSphere getBounds() const override { return bounds; }
+    };
+}
+
+
+#endif //RENDERING_PROJECT_SDFEXPR_H
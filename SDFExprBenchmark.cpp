@@ -0,0 +1,134 @@
+// Times one SDF tree two ways: as heap Object nodes with virtual calls, and as the
+// equivalent SDFExpr expression. Three workloads share the tree:
+//   distance - batch evaluation at random points (sdf::distances)
+//   march    - sphere tracing a frame of rays (sdf::march)
+//   render   - a full CpuRenderer frame, with the expression placed in the scene as one
+//              sdf::ExprObject, so the renderer's marcher goes through it
+// and every workload checks that both forms agree.
+//
+// usage: sdf_expr_benchmark [--size WxH] [--points N]
+
+#include "Constants.h"
+#include "CpuRenderer.h"
+#include "SDFExpr.h"
+#include "Scene.h"
+#include "CSGoperations/Difference.h"
+#include "CSGoperations/Repetition.h"
+#include "CSGoperations/Union.h"
+#include "Objects/Capsule.h"
+#include "Objects/Torus.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace {
+    const sf::Color STONE(200, 190, 170);
+
+    // A small temple: a 5x5 grid of columns under a roof with a ring cut out of it, a dome
+    // on top. Every kind of node the expressions support, nested a few levels deep.
+    constexpr auto templeExpr = sdf::union_(
+        sdf::repeat(sdf::capsule({0, 0, 0}, {0, 0, 3}, 0.3), {3, 3, 0}, {2, 2, 0}),
+        sdf::difference(sdf::box({0, 0, 3.5}, {7.5, 7.5, 0.4}), sdf::torus({0, 0, 3.5}, 4.0, 0.8)),
+        sdf::sphere({0, 0, 4}, 2.5));
+
+    Object* buildTemple(Scene& scene) {
+        auto* columns = scene.make<Repetition>(scene.make<Capsule>(Vector3(0, 0, 0), Vector3(0, 0, 3), 0.3, STONE),
+                                               Vector3(3, 3, 0), Vector3(2, 2, 0));
+        auto* roof = scene.make<Difference>(scene.make<Box>(Vector3(0, 0, 3.5), Vector3(7.5, 7.5, 0.4), STONE, 0.0f),
+                                            scene.make<Torus>(Vector3(0, 0, 3.5), 4.0, 0.8, STONE));
+        return scene.add<Union>(scene.make<Union>(columns, roof), scene.make<Sphere>(Vector3(0, 0, 4), 2.5, STONE));
+    }
+
+    double secondsSince(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const std::string& workload, const double objectSeconds, const double exprSeconds, const std::size_t count,
+                const std::string& unit, const std::string& agreement) {
+        std::cout << workload << ": Object tree " << objectSeconds * 1e9 / count << " ns/" << unit
+                  << ", expression " << exprSeconds * 1e9 / count << " ns/" << unit
+                  << " (" << objectSeconds / exprSeconds << "x), " << agreement << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::string> args(argv + 1, argv + argc);
+    auto option = [&](const std::string& name, const std::string& fallback) {
+        const auto it = std::find(args.begin(), args.end(), name);
+        return it != args.end() && it + 1 != args.end() ? *(it + 1) : fallback;
+    };
+    const std::string size = option("--size", "640x360");
+    const unsigned width = std::stoul(size), height = std::stoul(size.substr(size.find('x') + 1));
+    const std::size_t points = std::stoul(option("--points", "1000000"));
+
+    Scene objectScene;
+    Object* temple = buildTemple(objectScene);
+    const BoundingSphere bounds = temple->getBounds();
+
+    // Distance: the same random points through both forms
+    std::vector<double> xs(points), ys(points), zs(points), fromObjects(points), fromExpr(points);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    for (std::size_t i = 0; i < points; ++i) {
+        xs[i] = bounds.center.getX() + unit(rng) * bounds.radius;
+        ys[i] = bounds.center.getY() + unit(rng) * bounds.radius;
+        zs[i] = bounds.center.getZ() + unit(rng) * bounds.radius;
+    }
+    const auto viaObjects = [temple](const double x, const double y, const double z) { return temple->distanceToSurface(Vector3(x, y, z)); };
+    auto start = std::chrono::steady_clock::now();
+    sdf::distances(viaObjects, xs.data(), ys.data(), zs.data(), fromObjects.data(), points);
+    const double objectDistance = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    sdf::distances(templeExpr, xs.data(), ys.data(), zs.data(), fromExpr.data(), points);
+    const double exprDistance = secondsSince(start);
+    double worst = 0.0;
+    for (std::size_t i = 0; i < points; ++i) worst = std::max(worst, std::abs(fromObjects[i] - fromExpr[i]));
+    report("distance", objectDistance, exprDistance, points, "point", "max difference " + std::to_string(worst));
+
+    // March: one ray per pixel of a view from above the corner
+    const CameraBasis camera(Vector3(14, -16, 9), (Vector3(0, 0, 2) - Vector3(14, -16, 9)).normalized(), Z);
+    const double fov = PI / 3;
+    std::size_t mismatched = 0;
+    std::vector<double> objectHits(std::size_t(width) * height);
+    start = std::chrono::steady_clock::now();
+    for (unsigned y = 0; y < height; ++y)
+        for (unsigned x = 0; x < width; ++x)
+            objectHits[std::size_t(y) * width + x] = sdf::march(viaObjects, camera.o, camera.pixelDir(x, y, width, height, fov));
+    const double objectMarch = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (unsigned y = 0; y < height; ++y) {
+        for (unsigned x = 0; x < width; ++x) {
+            const double t = sdf::march(templeExpr, camera.o, camera.pixelDir(x, y, width, height, fov));
+            mismatched += std::abs(t - objectHits[std::size_t(y) * width + x]) > 1e-6;
+        }
+    }
+    const double exprMarch = secondsSince(start);
+    report("march", objectMarch, exprMarch, objectHits.size(), "ray", std::to_string(mismatched) + " rays disagree");
+
+    // Render: the CPU renderer over a ground plane plus either form of the temple
+    Scene exprScene;
+    exprScene.add<sdf::ExprObject<decltype(templeExpr)>>(templeExpr, STONE, bounds);
+    std::vector<std::uint8_t> objectImage, exprImage;
+    double renderSeconds[2];
+    for (int form = 0; form < 2; ++form) {
+        Scene& scene = form == 0 ? objectScene : exprScene;
+        scene.add<Plane>(Vector3(0, 0, 0), Z, sf::Color(90, 120, 80), 0.0f);
+        CpuRenderer renderer(scene, Vector3(0.4, -0.5, 0.8).normalized(), fov);
+        renderer.render(camera, width, height, form == 0 ? objectImage : exprImage);  // warm-up: caches, grid
+        start = std::chrono::steady_clock::now();
+        renderer.render(camera, width, height, form == 0 ? objectImage : exprImage);
+        renderSeconds[form] = secondsSince(start);
+    }
+    std::size_t differing = 0;
+    for (std::size_t i = 0; i < objectImage.size(); i += 4)
+        differing += std::max({std::abs(objectImage[i] - exprImage[i]), std::abs(objectImage[i + 1] - exprImage[i + 1]),
+                               std::abs(objectImage[i + 2] - exprImage[i + 2])}) > 2;
+    report("render", renderSeconds[0], renderSeconds[1], std::size_t(width) * height, "pixel",
+           std::to_string(differing) + " pixels differ by more than 2/255");
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include "Scene.h"
+
+#include <cmath>
+#include <limits>
+
+
+namespace {
+    // Distance to row i of a SoA table
+    double sphereDistance(const SphereSoA& t, std::size_t i, double px, double py, double pz) {
+        const double dx = px - t.cx[i], dy = py - t.cy[i], dz = pz - t.cz[i];
+        return std::sqrt(dx*dx + dy*dy + dz*dz) - t.radius[i];
+    }
+
+    double boxDistance(const BoxSoA& t, std::size_t i, double px, double py, double pz) {
+        const double qx = std::abs(px - t.cx[i]) - t.hx[i];
+        const double qy = std::abs(py - t.cy[i]) - t.hy[i];
+        const double qz = std::abs(pz - t.cz[i]) - t.hz[i];
+        const double ox = std::max(qx, 0.0), oy = std::max(qy, 0.0), oz = std::max(qz, 0.0);
+        return std::sqrt(ox*ox + oy*oy + oz*oz) + std::min(std::max(qx, std::max(qy, qz)), 0.0);
+    }
+
+    double planeDistance(const PlaneSoA& t, std::size_t i, double px, double py, double pz) {
+        return (px - t.px[i]) * t.nx[i] + (py - t.py[i]) * t.ny[i] + (pz - t.pz[i]) * t.nz[i];
+    }
+
+    double torusDistance(const TorusSoA& t, std::size_t i, double px, double py, double pz) {
+        const double qx = px - t.cx[i], qy = py - t.cy[i], qz = pz - t.cz[i];
+        const double xz = std::sqrt(qx*qx + qz*qz) - t.majorR[i];
+        return std::sqrt(xz*xz + qy*qy) - t.minorR[i];
+    }
+}
+
+
+void Scene::setName(Object* object, std::string name) {
+    const ObjectId id = idOf(object);
+    if (!names[id].empty()) byName.erase(names[id]);
+    byName[name] = id;
+    names[id] = std::move(name);
+}
+
+Object* Scene::find(const std::string& name) const {
+    auto it = byName.find(name);
+    return it == byName.end() ? nullptr : all[it->second];
+}
+
+void Scene::sync() {
+    for (std::size_t i = 0; i < spheres.size(); ++i) spheres.set(i, *static_cast<Sphere*>(spheres.object[i]));
+    for (std::size_t i = 0; i < boxes.size(); ++i) boxes.set(i, *static_cast<Box*>(boxes.object[i]));
+    for (std::size_t i = 0; i < planes.size(); ++i) planes.set(i, *static_cast<Plane*>(planes.object[i]));
+    for (std::size_t i = 0; i < tori.size(); ++i) tori.set(i, *static_cast<Torus*>(tori.object[i]));
+    for (std::size_t id = 0; id < all.size(); ++id) bounds[id] = all[id]->getBounds();
+    ++version;
+}
+
+void Scene::markDirty(Object* object) {
+    for (; object; object = object->parent) {
+        const ObjectId id = idOf(object);
+        if (dirtyFlags[id]) continue;
+        dirtyFlags[id] = 1;
+        dirtyList.push_back(id);
+    }
+}
+
+std::size_t Scene::commitChanges() {
+    bool staticChanged = false;
+    for (const ObjectId id : dirtyList) {
+        Object* object = all[id];
+        bounds[id] = object->getBounds();
+
+        if (const std::uint32_t row = soaRow[id]; row != NO_ROW) {
+            if (auto* sphere = dynamic_cast<Sphere*>(object)) spheres.set(row, *sphere);
+            else if (auto* box = dynamic_cast<Box*>(object)) boxes.set(row, *box);
+            else if (auto* plane = dynamic_cast<Plane*>(object)) planes.set(row, *plane);
+            else if (auto* torus = dynamic_cast<Torus*>(object)) tori.set(row, *torus);
+        }
+
+        if (object->material >= 0) {
+            // Appearance parameters live in the material, which the CPU renderer shades from
+            if (object->getReflectivity() != materials[static_cast<MaterialId>(object->material)].reflectivity)
+                object->material = materials.withReflectivity(static_cast<MaterialId>(object->material), object->getReflectivity());
+
+            // A baked colour field moves with its sphere and is only baked again at a new radius
+            Material& material = materials[static_cast<MaterialId>(object->material)];
+            auto* sphere = dynamic_cast<Sphere*>(object);
+            if (sphere && material.bake == Material::Bake::Spherical) {
+                if (sphere->radius != material.bakeRadius) bakeSphereColor(material, *sphere);
+                else material.bakeOrigin = sphere->center;
+            }
+        }
+
+        staticChanged = staticChanged || !object->dynamic;
+        for (auto& [token, listener] : listeners) listener(*object);
+        dirtyFlags[id] = 0;
+    }
+
+    const std::size_t changed = dirtyList.size();
+    dirtyList.clear();
+    if (staticChanged) ++version;
+    return changed;
+}
+
+int Scene::subscribe(ChangeListener listener) {
+    listeners.emplace_back(nextListener, std::move(listener));
+    return nextListener++;
+}
+
+void Scene::unsubscribe(const int token) {
+    std::erase_if(listeners, [token](const auto& entry) { return entry.first == token; });
+}
+
+std::pair<double, Object*> Scene::closestPrimitive(const Vector3& p) const {
+    const double px = p.getX(), py = p.getY(), pz = p.getZ();
+    double best = std::numeric_limits<double>::infinity();
+    Object* closest = nullptr;
+
+    // Each loop only reads its own arrays; the argmin is tracked as an index and
+    // resolved to an object once per table.
+    std::size_t bestIndex = spheres.size();
+    for (std::size_t i = 0; i < spheres.size(); ++i) {
+        const double d = sphereDistance(spheres, i, px, py, pz);
+        if (d < best) { best = d; bestIndex = i; }
+    }
+    if (bestIndex < spheres.size()) closest = spheres.object[bestIndex];
+
+    bestIndex = boxes.size();
+    for (std::size_t i = 0; i < boxes.size(); ++i) {
+        const double d = boxDistance(boxes, i, px, py, pz);
+        if (d < best) { best = d; bestIndex = i; }
+    }
+    if (bestIndex < boxes.size()) closest = boxes.object[bestIndex];
+
+    bestIndex = planes.size();
+    for (std::size_t i = 0; i < planes.size(); ++i) {
+        const double d = planeDistance(planes, i, px, py, pz);
+        if (d < best) { best = d; bestIndex = i; }
+    }
+    if (bestIndex < planes.size()) closest = planes.object[bestIndex];
+
+    bestIndex = tori.size();
+    for (std::size_t i = 0; i < tori.size(); ++i) {
+        const double d = torusDistance(tori, i, px, py, pz);
+        if (d < best) { best = d; bestIndex = i; }
+    }
+    if (bestIndex < tori.size()) closest = tori.object[bestIndex];
+
+    return {best, closest};
+}
+
+std::pair<double, Object*> Scene::distanceToClosest(const Vector3& p) const {
+    auto [best, closest] = closestPrimitive(p);
+    for (Object* object : others) {
+        const double d = object->distanceToSurface(p);
+        if (d < best) { best = d; closest = object; }
+    }
+    return {best, closest};
+}
+
+SdfSample Scene::query(const Vector3& p, const bool wantGradient) const {
+    auto [best, closest] = closestPrimitive(p);
+    // SoA primitives are their own leaves
+    SdfSample result{best, closest, closest, closest ? closest->material : -1};
+    result.local = p;
+    for (Object* object : others) {
+        SdfSample s = object->sample(p);
+        if (s.distance < result.distance) {
+            result = s;
+            result.object = object;
+        }
+    }
+    if (!result.leaf) return result;
+    if (result.material < 0) result.material = result.object->material;  // leaf built outside the scene
+    if (wantGradient) result.gradient = Object::surfaceNormal(result);
+    return result;
+}
+
+SdfSample Scene::query(const Vector3& p, const std::span<const std::uint32_t> candidates, const bool wantGradient) const {
+    const double px = p.getX(), py = p.getY(), pz = p.getZ();
+    SdfSample result;
+    result.local = p;
+    for (const std::uint32_t index : candidates) {
+        Object* object = objects[index];
+        const ObjectId id = idOf(object);
+        const std::uint32_t row = soaRow[id];
+        double d = std::numeric_limits<double>::infinity();
+        switch (soaTable[id]) {
+            case Table::Spheres: d = sphereDistance(spheres, row, px, py, pz); break;
+            case Table::Boxes: d = boxDistance(boxes, row, px, py, pz); break;
+            case Table::Planes: d = planeDistance(planes, row, px, py, pz); break;
+            case Table::Tori: d = torusDistance(tori, row, px, py, pz); break;
+            case Table::None: {
+                SdfSample s = object->sample(p);
+                if (s.distance < result.distance) {
+                    result = s;
+                    result.object = object;
+                }
+                continue;
+            }
+        }
+        if (d < result.distance) {
+            result = SdfSample{d, object, object, object->material};
+            result.local = p;
+        }
+    }
+    if (!result.leaf) return result;
+    if (result.material < 0) result.material = result.object->material;
+    if (wantGradient) result.gradient = Object::surfaceNormal(result);
+    return result;
+}
@@ -0,0 +1,183 @@
+#ifndef RENDERING_PROJECT_SCENE_H
+#define RENDERING_PROJECT_SCENE_H
+
+#include "Arena.h"
+#include "Material.h"
+#include "Objects/Object.h"
+#include "Objects/Sphere.h"
+#include "Objects/Box.h"
+#include "Objects/Plane.h"
+#include "Objects/Torus.h"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+using ObjectId = std::uint32_t;
+
+// Hot geometry of each primitive type, stored as parallel arrays so the
+// distance loops walk contiguous memory and never touch the object itself.
+struct SphereSoA {
+    std::vector<double> cx, cy, cz, radius;
+    std::vector<Object*> object;
+
+    void push(Sphere* s) { object.push_back(s); for (auto* v : {&cx, &cy, &cz, &radius}) v->emplace_back(); set(object.size() - 1, *s); }
+    void set(std::size_t i, const Sphere& s) { cx[i] = s.center.getX(); cy[i] = s.center.getY(); cz[i] = s.center.getZ(); radius[i] = s.radius; }
+    [[nodiscard]] std::size_t size() const { return object.size(); }
+};
+
+struct BoxSoA {
+    std::vector<double> cx, cy, cz, hx, hy, hz;
+    std::vector<Object*> object;
+
+    void push(Box* b) { object.push_back(b); for (auto* v : {&cx, &cy, &cz, &hx, &hy, &hz}) v->emplace_back(); set(object.size() - 1, *b); }
+    void set(std::size_t i, const Box& b) {
+        cx[i] = b.center.getX(); cy[i] = b.center.getY(); cz[i] = b.center.getZ();
+        hx[i] = b.halfSize.getX(); hy[i] = b.halfSize.getY(); hz[i] = b.halfSize.getZ();
+    }
+    [[nodiscard]] std::size_t size() const { return object.size(); }
+};
+
+struct PlaneSoA {
+    std::vector<double> px, py, pz, nx, ny, nz;
+    std::vector<Object*> object;
+
+    void push(Plane* p) { object.push_back(p); for (auto* v : {&px, &py, &pz, &nx, &ny, &nz}) v->emplace_back(); set(object.size() - 1, *p); }
+    void set(std::size_t i, const Plane& p) {
+        px[i] = p.point.getX(); py[i] = p.point.getY(); pz[i] = p.point.getZ();
+        nx[i] = p.normal.getX(); ny[i] = p.normal.getY(); nz[i] = p.normal.getZ();
+    }
+    [[nodiscard]] std::size_t size() const { return object.size(); }
+};
+
+struct TorusSoA {
+    std::vector<double> cx, cy, cz, majorR, minorR;
+    std::vector<Object*> object;
+
+    void push(Torus* t) { object.push_back(t); for (auto* v : {&cx, &cy, &cz, &majorR, &minorR}) v->emplace_back(); set(object.size() - 1, *t); }
+    void set(std::size_t i, const Torus& t) {
+        cx[i] = t.center.getX(); cy[i] = t.center.getY(); cz[i] = t.center.getZ();
+        majorR[i] = t.majorR; minorR[i] = t.minorR;
+    }
+    [[nodiscard]] std::size_t size() const { return object.size(); }
+};
+
+
+// Owns every object of a scene. Objects live in one arena (freed in one go when the
+// scene is destroyed); top-level primitives are mirrored into per-type SoA tables and
+// cold per-object data (names, texture paths) lives in side tables indexed by ObjectId.
+// Every object is given a material from the scene's MaterialTable when it is created.
+// Objects changed in place are reported with markDirty(); commitChanges() then refreshes
+// only their derived data and notifies subscribers (renderers, caches) per object.
+class Scene {
+    Arena arena;
+
+public:
+    std::vector<Object*> objects;  // top-level objects, in insertion order
+    SphereSoA spheres;
+    BoxSoA boxes;
+    PlaneSoA planes;
+    TorusSoA tori;
+    std::vector<Object*> others;   // top-level objects without a SoA table (fractals, CSG, ...)
+    MaterialTable materials;
+
+    // Side tables, indexed by ObjectId
+    std::vector<Object*> all;
+    std::vector<std::string> names;
+    std::vector<std::string> textures;
+    std::vector<BoundingSphere> bounds;  // refreshed for changed objects by commitChanges()
+
+    Scene() = default;
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Creates a top-level object that takes part in scene queries
+    template<class T, class... Args>
+    T* add(Args&&... args) {
+        T* object = make<T>(std::forward<Args>(args)...);
+        objects.push_back(object);
+        std::uint32_t& row = soaRow[object->id];
+        Table& table = soaTable[object->id];
+        if constexpr (std::is_same_v<T, Sphere>) { row = static_cast<std::uint32_t>(spheres.size()); table = Table::Spheres; spheres.push(object); }
+        else if constexpr (std::is_same_v<T, Box>) { row = static_cast<std::uint32_t>(boxes.size()); table = Table::Boxes; boxes.push(object); }
+        else if constexpr (std::is_same_v<T, Plane>) { row = static_cast<std::uint32_t>(planes.size()); table = Table::Planes; planes.push(object); }
+        else if constexpr (std::is_same_v<T, Torus>) { row = static_cast<std::uint32_t>(tori.size()); table = Table::Tori; tori.push(object); }
+        else others.push_back(object);
+        ++version;
+        return object;
+    }
+
+    // Creates an object owned by the scene but only reachable through a parent (CSG operands)
+    template<class T, class... Args>
+    T* make(Args&&... args) {
+        T* object = arena.create<T>(std::forward<Args>(args)...);
+        object->id = static_cast<int>(all.size());
+        all.push_back(object);
+        names.emplace_back();
+        if constexpr (requires { object->texture; }) textures.push_back(object->texture);
+        else textures.emplace_back();
+        object->material = materials.fromObject(object, textures.back());
+        bounds.push_back(object->getBounds());
+        dirtyFlags.push_back(0);
+        soaRow.push_back(NO_ROW);
+        soaTable.push_back(Table::None);
+        return object;
+    }
+
+    [[nodiscard]] ObjectId idOf(const Object* object) const { return static_cast<ObjectId>(object->id); }
+    void setName(Object* object, std::string name);
+    [[nodiscard]] Object* find(const std::string& name) const;
+    [[nodiscard]] const std::string& texturePath(const Object* object) const { return textures[idOf(object)]; }
+
+    // Re-reads SoA geometry from the objects after they were modified in place
+    void sync();
+
+    // Dynamic objects are expected to change every frame and are excluded from caches
+    void setDynamic(Object* object, bool dynamic = true) { object->dynamic = dynamic; ++version; }
+    // Bumped whenever static geometry may have changed; caches compare it to decide on a rebuild
+    [[nodiscard]] std::uint64_t staticVersion() const { return version; }
+
+    using ChangeListener = std::function<void(const Object&)>;
+
+    // Records that an object was modified in place; the change propagates to enclosing CSG nodes
+    void markDirty(Object* object);
+    [[nodiscard]] bool isDirty(const Object* object) const { return dirtyFlags[idOf(object)] != 0; }
+    // Refreshes SoA rows, bounds and materials (reflectivity, baked colour fields) of the
+    // changed objects only, bumps staticVersion() if a static object changed and notifies
+    // subscribers once per object. Returns the number of changed objects.
+    std::size_t commitChanges();
+
+    int subscribe(ChangeListener listener);
+    void unsubscribe(int token);
+
+    // Closest top-level object to p, evaluated type by type over the SoA tables
+    [[nodiscard]] std::pair<double, Object*> distanceToClosest(const Vector3& p) const;
+    // Same traversal, but also resolves the leaf inside CSG trees, its material and
+    // (if asked for) the gradient, so shading never re-evaluates the tree
+    [[nodiscard]] SdfSample query(const Vector3& p, bool wantGradient = false) const;
+    // Same, but only over the listed top-level objects (indices into `objects`), e.g. the
+    // objects a screen tile can see (see ScreenBins)
+    [[nodiscard]] SdfSample query(const Vector3& p, std::span<const std::uint32_t> candidates, bool wantGradient = false) const;
+
+private:
+    std::unordered_map<std::string, ObjectId> byName;
+    [[nodiscard]] std::pair<double, Object*> closestPrimitive(const Vector3& p) const;
+    std::uint64_t version = 0;
+
+    static constexpr std::uint32_t NO_ROW = ~0u;
+    enum class Table : std::uint8_t { None, Spheres, Boxes, Planes, Tori };
+    std::vector<std::uint32_t> soaRow;  // row in the object's SoA table, indexed by ObjectId
+    std::vector<Table> soaTable;        // which table that row is in, indexed by ObjectId
+    std::vector<std::uint8_t> dirtyFlags;
+    std::vector<ObjectId> dirtyList;
+    std::vector<std::pair<int, ChangeListener>> listeners;
+    int nextListener = 0;
+};
+
+
+#endif //RENDERING_PROJECT_SCENE_H
@@ -0,0 +1,319 @@
+#include "SceneFile.h"
+
+#include "Objects/Capsule.h"
+#include "Objects/Cylinder.h"
+#include "Objects/Mandelbulb.h"
+#include "Objects/QuaternionJulia.h"
+#include "Objects/Terrain.h"
+#include "CSGoperations/Union.h"
+#include "CSGoperations/Intersection.h"
+#include "CSGoperations/Difference.h"
+#include "CSGoperations/Repetition.h"
+#include "CSGoperations/Instances.h"
+#include "CSGoperations/Transform.h"
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace {
+    constexpr int FORMAT_VERSION = 2;
+
+    struct Writer {
+        std::ostream& out;
+
+        Writer& num(double v) { out << ' ' << v; return *this; }
+        Writer& vec(const Vector3& v) { return num(v.getX()).num(v.getY()).num(v.getZ()); }
+        Writer& color(sf::Color c) { out << ' ' << int(c.r) << ' ' << int(c.g) << ' ' << int(c.b); return *this; }
+        Writer& text(const std::string& s) { out << ' ' << std::quoted(s); return *this; }
+        Writer& quat(const Quaternion& q) { return num(q.getW()).vec(q.getVector()); }
+        Writer& matrix(const Matrix3& m) {
+            for (const auto& row : m.m) num(row[0]).num(row[1]).num(row[2]);
+            return *this;
+        }
+    };
+
+    class Reader {
+        std::istringstream in;
+        std::size_t line;
+        const std::vector<Object*>& objects;
+
+    public:
+        Reader(const std::string& text, std::size_t line, const std::vector<Object*>& objects) :
+            in(text), line(line), objects(objects) {}
+
+        [[noreturn]] void fail(const std::string& what) const {
+            throw std::invalid_argument("SceneFile: line " + std::to_string(line) + ": " + what);
+        }
+
+        std::string word() {
+            std::string s;
+            if (!(in >> s)) fail("unexpected end of line");
+            return s;
+        }
+
+        // Numbers go through stod so that "inf" (unbounded repetition) reads back
+        double num() {
+            const std::string s = word();
+            try {
+                std::size_t used = 0;
+                const double v = std::stod(s, &used);
+                if (used == s.size()) return v;
+            } catch (const std::exception&) {}
+            fail("'" + s + "' is not a number");
+        }
+
+        int integer() { return static_cast<int>(num()); }
+        bool flag() { return num() != 0.0; }
+        Vector3 vec() { const double x = num(), y = num(); return Vector3(x, y, num()); }
+        sf::Color color() {
+            const int r = integer(), g = integer(), b = integer();
+            return sf::Color(static_cast<std::uint8_t>(r), static_cast<std::uint8_t>(g), static_cast<std::uint8_t>(b));
+        }
+        float real() { return static_cast<float>(num()); }
+
+        std::string text() {
+            std::string s;
+            if (!(in >> std::quoted(s))) fail("expected a quoted string");
+            return s;
+        }
+
+        Quaternion quat() { const double w = num(); return Quaternion(w, vec()); }
+
+        Matrix3 matrix() {
+            Matrix3 m;
+            for (auto& row : m.m)
+                for (double& v : row) v = num();
+            return m;
+        }
+
+        Object* ref() {
+            const int index = integer();
+            if (index < 0 || static_cast<std::size_t>(index) >= objects.size()) fail("object " + std::to_string(index) + " is not defined yet");
+            return objects[index];
+        }
+
+        void end() {
+            std::string rest;
+            if (in >> rest) fail("unexpected '" + rest + "'");
+        }
+    };
+
+    template<class T, class... Args>
+    T* create(Scene& scene, bool topLevel, Args&&... args) {
+        if (topLevel) return scene.add<T>(std::forward<Args>(args)...);
+        return scene.make<T>(std::forward<Args>(args)...);
+    }
+
+    // Writes the object's parameters and returns its type keyword
+    std::string writeObject(const Scene& scene, Object* object, const std::unordered_map<const Object*, std::size_t>& index, Writer& w) {
+        auto ref = [&](const Object* child) { w.num(static_cast<double>(index.at(child))); };
+        const std::string& texture = scene.texturePath(object);
+
+        if (auto* s = dynamic_cast<Sphere*>(object)) {
+            w.vec(s->center).num(s->radius).color(s->getColorAtOrigin()).num(s->reflectivity).text(texture);
+            return "sphere";
+        }
+        if (auto* p = dynamic_cast<Plane*>(object)) {
+            w.vec(p->point).vec(p->normal).color(p->getColorAtOrigin()).num(p->reflectivity);
+            return "plane";
+        }
+        if (auto* b = dynamic_cast<Box*>(object)) {
+            w.vec(b->center).vec(b->halfSize).color(b->color).num(b->reflectivity).text(texture);
+            return "box";
+        }
+        if (auto* c = dynamic_cast<Cylinder*>(object)) {
+            w.vec(c->center).num(c->radius).num(c->halfHeight).color(c->color);
+            return "cylinder";
+        }
+        if (auto* c = dynamic_cast<Capsule*>(object)) {
+            w.vec(c->a).vec(c->b).num(c->radius).color(c->color);
+            return "capsule";
+        }
+        if (auto* t = dynamic_cast<Torus*>(object)) {
+            w.vec(t->center).num(t->majorR).num(t->minorR).color(t->color);
+            return "torus";
+        }
+        if (auto* m = dynamic_cast<Mandelbulb*>(object)) {
+            w.vec(m->center).num(m->iterations).num(m->power).num(m->scale).color(m->color).num(m->reflectivity).text(texture);
+            return "mandelbulb";
+        }
+        if (auto* j = dynamic_cast<QuaternionJulia*>(object)) {
+            w.vec(j->center).vec(j->c).num(j->iterations).num(j->scale).color(j->color).text(texture);
+            return "julia";
+        }
+        if (auto* t = dynamic_cast<Terrain*>(object)) {
+            w.vec(t->originXZ).num(t->amplitude).num(t->frequency).num(t->seed).num(t->octaves).num(t->lacunarity).num(t->gain)
+             .color(t->color).num(t->warpStrength).num(t->warp).num(t->ridged);
+            return "terrain";
+        }
+        if (auto* u = dynamic_cast<Union*>(object)) {
+            ref(u->getA()); ref(u->getB());
+            return "union";
+        }
+        if (auto* i = dynamic_cast<Intersection*>(object)) {
+            ref(i->getA()); ref(i->getB());
+            return "intersection";
+        }
+        if (auto* d = dynamic_cast<Difference*>(object)) {
+            ref(d->getA()); ref(d->getB());
+            return "difference";
+        }
+        if (auto* r = dynamic_cast<Repetition*>(object)) {
+            ref(r->getChild());
+            w.vec(r->spacing).vec(r->limit);
+            return "repetition";
+        }
+        if (auto* t = dynamic_cast<Transform*>(object)) {
+            ref(t->getChild());
+            w.vec(t->translation).matrix(t->getRotation()).num(t->scale);
+            return "transform";
+        }
+        if (auto* list = dynamic_cast<Instances*>(object)) {
+            ref(list->getChild());
+            w.num(static_cast<double>(list->instances.size()));
+            for (const Instance& inst : list->instances) {
+                w.vec(inst.position).quat(inst.rotation).num(inst.scale).num(inst.material >= 0);
+                // Material ids are local to a scene, so the override is written by content
+                if (inst.material >= 0) {
+                    const Material& m = scene.materials[static_cast<MaterialId>(inst.material)];
+                    w.color(m.baseColor).num(m.reflectivity).text(m.texture);
+                }
+            }
+            return "instances";
+        }
+        throw std::invalid_argument("SceneFile: object " + std::to_string(object->id) + " has a type that cannot be written");
+    }
+
+    Object* readObject(Scene& scene, const std::string& type, bool top, Reader& r) {
+        if (type == "sphere") {
+            const Vector3 c = r.vec(); const double radius = r.num(); const sf::Color col = r.color();
+            const float refl = r.real(); const std::string tex = r.text();
+            if (!tex.empty()) return create<Sphere>(scene, top, c, radius, col, tex, refl);
+            return create<Sphere>(scene, top, c, radius, col, refl);
+        }
+        if (type == "plane") {
+            const Vector3 p = r.vec(), n = r.vec(); const sf::Color col = r.color();
+            return create<Plane>(scene, top, p, n, col, r.real());
+        }
+        if (type == "box") {
+            const Vector3 c = r.vec(), h = r.vec(); const sf::Color col = r.color();
+            const float refl = r.real(); const std::string tex = r.text();
+            if (!tex.empty()) return create<Box>(scene, top, c, h, col, tex, refl);
+            return create<Box>(scene, top, c, h, col, refl);
+        }
+        if (type == "cylinder") {
+            const Vector3 c = r.vec(); const double radius = r.num(), half = r.num();
+            return create<Cylinder>(scene, top, c, radius, half, r.color());
+        }
+        if (type == "capsule") {
+            const Vector3 a = r.vec(), b = r.vec(); const double radius = r.num();
+            return create<Capsule>(scene, top, a, b, radius, r.color());
+        }
+        if (type == "torus") {
+            const Vector3 c = r.vec(); const double major = r.num(), minor = r.num();
+            return create<Torus>(scene, top, c, major, minor, r.color());
+        }
+        if (type == "mandelbulb") {
+            const Vector3 c = r.vec(); const int iterations = r.integer(); const double power = r.num(), s = r.num();
+            const sf::Color col = r.color(); const float refl = r.real(); const std::string tex = r.text();
+            if (!tex.empty()) return create<Mandelbulb>(scene, top, c, iterations, power, col, s, tex, refl);
+            return create<Mandelbulb>(scene, top, c, iterations, power, col, s, refl);
+        }
+        if (type == "julia") {
+            const Vector3 c = r.vec(), k = r.vec(); const int iterations = r.integer(); const double s = r.num();
+            const sf::Color col = r.color();
+            return create<QuaternionJulia>(scene, top, c, k, iterations, s, col, r.text());
+        }
+        if (type == "terrain") {
+            const Vector3 o = r.vec(); const float amplitude = r.real(), frequency = r.real(), seed = r.real();
+            const int octaves = r.integer(); const float lacunarity = r.real(), gain = r.real();
+            const sf::Color col = r.color(); const float warpStrength = r.real(); const bool warp = r.flag();
+            auto* t = create<Terrain>(scene, top, o, amplitude, frequency, seed, octaves, lacunarity, gain, col);
+            t->setWarp(warpStrength, warp).setRidged(r.flag());
+            return t;
+        }
+        if (type == "union") { Object* a = r.ref(); return create<Union>(scene, top, a, r.ref()); }
+        if (type == "intersection") { Object* a = r.ref(); return create<Intersection>(scene, top, a, r.ref()); }
+        if (type == "difference") { Object* a = r.ref(); return create<Difference>(scene, top, a, r.ref()); }
+        if (type == "repetition") {
+            Object* child = r.ref(); const Vector3 spacing = r.vec();
+            return create<Repetition>(scene, top, child, spacing, r.vec());
+        }
+        if (type == "transform") {
+            Object* child = r.ref(); const Vector3 t = r.vec(); const Matrix3 m = r.matrix();
+            auto* transform = create<Transform>(scene, top, child, t, Quaternion(1, 0, 0, 0), r.num());
+            transform->setRotation(m);
+            return transform;
+        }
+        if (type == "instances") {
+            Object* child = r.ref();
+            std::vector<Instance> list(static_cast<std::size_t>(r.integer()));
+            for (Instance& inst : list) {
+                inst.position = r.vec();
+                inst.rotation = r.quat();
+                inst.scale = r.num();
+                if (r.flag()) {
+                    const sf::Color col = r.color(); const float refl = r.real();
+                    inst.material = scene.materials.plain(col, refl, r.text());
+                }
+            }
+            return create<Instances>(scene, top, child, std::move(list));
+        }
+        r.fail("unknown object type '" + type + "'");
+    }
+}
+
+void writeScene(const Scene& scene, std::ostream& out) {
+    std::vector<bool> topLevel(scene.all.size(), false);
+    for (const Object* object : scene.objects) topLevel[scene.idOf(object)] = true;
+
+    std::unordered_map<const Object*, std::size_t> index;
+    out << "scene " << FORMAT_VERSION << '\n';
+    for (Object* object : scene.all) {
+        std::ostringstream parameters;
+        parameters.precision(std::numeric_limits<double>::max_digits10);
+        Writer w{parameters};
+        const std::string type = writeObject(scene, object, index, w);
+
+        const ObjectId id = scene.idOf(object);
+        out << "object " << type << ' ' << int(topLevel[id]) << ' ' << int(object->dynamic) << ' '
+            << std::quoted(scene.names[id]) << parameters.str() << '\n';
+        index[object] = index.size();
+    }
+}
+
+void readScene(std::istream& in, Scene& scene) {
+    std::vector<Object*> objects;  // by line index, for CSG operand references
+    std::string text;
+    std::size_t line = 0;
+    bool header = false;
+    while (std::getline(in, text)) {
+        ++line;
+        if (text.empty() || text[0] == '#') continue;
+        Reader r(text, line, objects);
+        const std::string keyword = r.word();
+        if (!header) {
+            if (keyword != "scene" || r.integer() != FORMAT_VERSION) r.fail("expected 'scene " + std::to_string(FORMAT_VERSION) + "'");
+            header = true;
+            continue;
+        }
+        if (keyword != "object") r.fail("expected 'object'");
+
+        const std::string type = r.word();
+        const bool top = r.flag();
+        const bool dynamic = r.flag();
+        const std::string name = r.text();
+        Object* object = readObject(scene, type, top, r);
+        r.end();
+        if (dynamic) scene.setDynamic(object);
+        if (!name.empty()) scene.setName(object, name);
+        objects.push_back(object);
+    }
+    if (!header) throw std::invalid_argument("SceneFile: no 'scene' header");
+}
@@ -0,0 +1,29 @@
+#ifndef RENDERING_PROJECT_SCENEFILE_H
+#define RENDERING_PROJECT_SCENEFILE_H
+
+#include "Scene.h"
+#include <istream>
+#include <ostream>
+
+
+// Plain-text scene description, used to ship a scene to other processes (tile workers).
+// One line per object in ObjectId order, so CSG operands always precede the nodes that
+// reference them (by their line index):
+//
+//     scene 2
+//     object <type> <top-level 0|1> <dynamic 0|1> "<name>" <parameters...>
+//
+// Colors are written as the object's base color: procedural color functions (lambdas)
+// cannot be serialized and arrive as the color they have at the object's origin.
+// Texture paths are written as they are, so every reader needs the same files.
+// Per-instance material overrides are written by content (color, reflectivity, texture)
+// rather than by MaterialId, and resolve to shared materials of the reading scene.
+// Objects of other types (e.g. sdf::ExprObject) make writeScene throw std::invalid_argument.
+void writeScene(const Scene& scene, std::ostream& out);
+
+// Adds the objects described by `in` to `scene`; throws std::invalid_argument on a
+// malformed line
+void readScene(std::istream& in, Scene& scene);
+
+
+#endif //RENDERING_PROJECT_SCENEFILE_H
@@ -0,0 +1,83 @@
+#include "ScreenBins.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+
+namespace {
+    // Slopes (x / z) of the two tangents through the origin to a circle of radius r at
+    // (x, z), which lies entirely in front of it (z > r)
+    std::pair<double, double> tangentSlopes(const double x, const double z, const double r) {
+        const double root = r * std::sqrt(x * x + z * z - r * r);
+        const double denom = z * z - r * r;
+        return {(x * z - root) / denom, (x * z + root) / denom};
+    }
+
+    // Tiles of a region axis holding the pixels whose centres are in [lo, hi] (frame pixel
+    // coordinates, centres at integers), give or take a pixel; false if there are none
+    bool tileSpan(const double lo, const double hi, const unsigned origin, const unsigned size, unsigned& first, unsigned& last) {
+        const double from = std::ceil(lo - 1.0) - origin;
+        const double to = std::floor(hi + 1.0) - origin;
+        if (to < 0.0 || from >= size) return false;
+        first = static_cast<unsigned>(std::max(from, 0.0)) / ScreenBins::TILE;
+        last = static_cast<unsigned>(std::min(to, size - 1.0)) / ScreenBins::TILE;
+        return true;
+    }
+}
+
+void ScreenBins::build(const std::vector<BoundingSphere>& bounds, const CameraBasis& camera, const unsigned frameWidth,
+                       const unsigned frameHeight, const double fov, const unsigned x0, const unsigned y0,
+                       const unsigned width, const unsigned height, const double margin, const double spread) {
+    tileColumns = (width + TILE - 1) / TILE;
+    tileRows = (height + TILE - 1) / TILE;
+    offsets.assign(tileCount() + 1, 0);
+    entries.clear();
+    covered.assign(bounds.size(), Rect{1, 0, 0, 0});
+    if (tileCount() == 0) return;
+
+    // Same projection as CameraBasis::pixelDir: frame pixel p has its centre at
+    // ndc = (p + 0.5) / size * 2 - 1, and screen y grows downwards
+    const double tanY = std::tan(fov / 2);
+    const double tanX = tanY * frameWidth / frameHeight;
+    const auto toPixel = [](const double ndc, const unsigned size) { return (ndc + 1.0) * 0.5 * size - 0.5; };
+    constexpr double inf = std::numeric_limits<double>::infinity();
+
+    for (std::size_t i = 0; i < bounds.size(); ++i) {
+        double left = -inf, right = inf, top = -inf, bottom = inf;
+        if (bounds[i].isBounded()) {
+            const Vector3 d = bounds[i].center - camera.o;
+            const double r = bounds[i].radius + margin + spread * (d.magnitude() + bounds[i].radius + margin);
+            const double z = d.dot(camera.f);
+            if (z < -r) continue;  // entirely behind the camera
+            // Bounds reaching the camera plane may cover any part of the screen
+            if (z > r) {
+                const auto [xLo, xHi] = tangentSlopes(d.dot(camera.r), z, r);
+                const auto [yLo, yHi] = tangentSlopes(d.dot(camera.u), z, r);
+                left = toPixel(xLo / tanX, frameWidth);
+                right = toPixel(xHi / tanX, frameWidth);
+                top = toPixel(-yHi / tanY, frameHeight);
+                bottom = toPixel(-yLo / tanY, frameHeight);
+            }
+        }
+        Rect& rect = covered[i];
+        if (!tileSpan(left, right, x0, width, rect.x0, rect.x1) || !tileSpan(top, bottom, y0, height, rect.y0, rect.y1)) {
+            rect = Rect{1, 0, 0, 0};
+            continue;
+        }
+        for (unsigned ty = rect.y0; ty <= rect.y1; ++ty)
+            for (unsigned tx = rect.x0; tx <= rect.x1; ++tx) ++offsets[std::size_t(ty) * tileColumns + tx + 1];
+    }
+
+    // Counts to offsets, then fill each tile's range in object order
+    for (std::size_t t = 0; t < tileCount(); ++t) offsets[t + 1] += offsets[t];
+    entries.resize(offsets.back());
+    std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < covered.size(); ++i) {
+        const Rect& rect = covered[i];
+        if (rect.x0 > rect.x1) continue;
+        for (unsigned ty = rect.y0; ty <= rect.y1; ++ty)
+            for (unsigned tx = rect.x0; tx <= rect.x1; ++tx) entries[cursor[std::size_t(ty) * tileColumns + tx]++] = static_cast<std::uint32_t>(i);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef RENDERING_PROJECT_SCREENBINS_H
+#define RENDERING_PROJECT_SCREENBINS_H
+
+#include "CameraBasis.h"
+#include "Objects/Object.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+// Per-frame lists of the objects each TILE x TILE block of pixels can see. Every object's
+// bounding sphere, grown by the hit tolerance, is projected to a conservative pixel
+// rectangle and the object is appended to the tiles it covers. A primary ray can only
+// hit what overlaps its tile's frustum, so it only evaluates its tile's list; shadow and
+// reflection rays still need every object.
+// Unbounded objects and bounds around the camera land in every tile, bounds entirely
+// behind it in none.
+class ScreenBins {
+public:
+    static constexpr unsigned TILE = 16;
+
+    // Bins objects 0..bounds.size()-1 into the tiles of the width x height pixels at
+    // (x0, y0) of a frameWidth x frameHeight frame seen through `camera` (rays as
+    // CameraBasis::pixelDir, top row first). Bounds grow by margin + spread x their
+    // distance, the hit tolerance of a ray that reaches them.
+    void build(const std::vector<BoundingSphere>& bounds, const CameraBasis& camera, unsigned frameWidth, unsigned frameHeight,
+               double fov, unsigned x0, unsigned y0, unsigned width, unsigned height, double margin, double spread = 0.0);
+
+    [[nodiscard]] unsigned columns() const { return tileColumns; }
+    [[nodiscard]] unsigned rows() const { return tileRows; }
+    [[nodiscard]] std::size_t tileCount() const { return std::size_t(tileColumns) * tileRows; }
+    // Tile of the region's pixel (x, y)
+    [[nodiscard]] std::size_t tileAt(unsigned x, unsigned y) const { return std::size_t(y / TILE) * tileColumns + x / TILE; }
+    // Indices of the objects tile t can see, ascending
+    [[nodiscard]] std::span<const std::uint32_t> objects(std::size_t tile) const {
+        return {entries.data() + offsets[tile], entries.data() + offsets[tile + 1]};
+    }
+    // Mean list length, for comparing against the object count
+    [[nodiscard]] double averageListSize() const { return tileCount() ? double(entries.size()) / tileCount() : 0.0; }
+
+private:
+    unsigned tileColumns = 0, tileRows = 0;
+    std::vector<std::uint32_t> offsets;  // tile t's entries are [offsets[t], offsets[t + 1])
+    std::vector<std::uint32_t> entries;
+    struct Rect { unsigned x0, y0, x1, y1; };  // tiles, inclusive; x0 > x1 when empty
+    std::vector<Rect> covered;           // per object, scratch
+};
+
+
+#endif //RENDERING_PROJECT_SCREENBINS_H
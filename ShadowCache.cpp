@@ -0,0 +1,127 @@
+#include "ShadowCache.h"
+
+#include "Constants.h"
+#include "Objects/Plane.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+    constexpr unsigned MAX_MAP_STEPS = 256;
+    constexpr double MAP_MARGIN = 1.0;
+    constexpr double PACK_SCALE = 16777215.0;  // 2^24 - 1
+}
+
+bool ShadowCache::update(const std::vector<Object*>& objects, const Vector3& light, const std::uint64_t staticVersion) {
+    const Vector3 dir = light.normalized();
+    if (valid && builtVersion == staticVersion && builtCount == objects.size() && (dir - builtLight).magnitude() < 1e-9) {
+        return false;
+    }
+
+    casters.clear();
+    rest.clear();
+    for (Object* object : objects) {
+        // Planes are unbounded but exact, so they are safe to cache; other unbounded
+        // fields (terrain) can reach in from outside the mapped region
+        const bool cacheable = !object->dynamic && (object->getBounds().isBounded() || dynamic_cast<Plane*>(object));
+        (cacheable ? casters : rest).push_back(object);
+    }
+
+    valid = true;
+    builtLight = dir;
+    builtVersion = staticVersion;
+    builtCount = objects.size();
+    lightDir = dir;
+    build();
+    return true;
+}
+
+void ShadowCache::build() {
+    // The map covers the bounds of the bounded casters; without any there is nothing to cache
+    BoundingSphere region{Vector3(), 0.0};
+    bool any = false;
+    for (Object* object : casters) {
+        const BoundingSphere b = object->getBounds();
+        if (!b.isBounded()) continue;
+        region = any ? region.merged(b) : b;
+        any = true;
+    }
+    enabled = any;
+    if (!enabled) {
+        rest.insert(rest.end(), casters.begin(), casters.end());
+        casters.clear();
+        depth.clear();
+        return;
+    }
+
+    axisU = lightDir.cross(std::abs(lightDir.getZ()) < 0.9 ? Z : X).normalized();
+    axisV = lightDir.cross(axisU).normalized();
+    extent = region.radius + MAP_MARGIN;
+    range = 2.0 * extent;
+    origin = region.center + lightDir * extent;
+
+    const double texel = texelSize();
+    const double eps = std::max(texel * 0.25, 1e-3);
+    const Vector3 down = lightDir * -1;
+    depth.assign(static_cast<std::size_t>(resolution) * resolution, std::numeric_limits<float>::infinity());
+
+    parallelFor(resolution, [&](std::size_t y0, std::size_t y1) {
+        for (std::size_t y = y0; y < y1; ++y) {
+            const Vector3 rowStart = origin + axisV * (((y + 0.5) * texel) - extent) - axisU * extent;
+            for (unsigned x = 0; x < resolution; ++x) {
+                const Vector3 start = rowStart + axisU * ((x + 0.5) * texel);
+                double travelled = 0.0;
+                for (unsigned step = 0; step < MAX_MAP_STEPS && travelled < range; ++step) {
+                    const Vector3 p = start + down * travelled;
+                    double d = std::numeric_limits<double>::infinity();
+                    for (Object* object : casters) d = std::min(d, object->distanceToSurface(p));
+                    if (d < eps) {
+                        depth[y * resolution + x] = static_cast<float>(std::max(travelled, 0.0));
+                        break;
+                    }
+                    travelled += d;
+                }
+            }
+        }
+    });
+}
+
+bool ShadowCache::covers(const Object* object) const {
+    return enabled && std::find(casters.begin(), casters.end(), object) != casters.end();
+}
+
+float ShadowCache::visibility(const Vector3& p, const Vector3& normal) const {
+    if (!enabled) return -1.0f;
+
+    // Normal offset and depth bias of about a texel keep surfaces from shadowing themselves
+    const double texel = texelSize();
+    const Vector3 q = p + normal * (texel * 1.5) - origin;
+    const double z = -q.dot(lightDir);
+    const double tx = (q.dot(axisU) + extent) / texel - 0.5;
+    const double ty = (q.dot(axisV) + extent) / texel - 0.5;
+    if (z < 0.0 || z > range || tx < 0.0 || ty < 0.0 || tx >= resolution - 1 || ty >= resolution - 1) return -1.0f;
+
+    // 2x2 percentage-closer filter
+    const auto x0 = static_cast<std::size_t>(tx);
+    const auto y0 = static_cast<std::size_t>(ty);
+    const double fx = tx - x0, fy = ty - y0;
+    const double bias = texel * 1.5;
+    auto lit = [&](std::size_t x, std::size_t y) { return z <= depth[y * resolution + x] + bias ? 1.0 : 0.0; };
+    const double top = lit(x0, y0) * (1.0 - fx) + lit(x0 + 1, y0) * fx;
+    const double bottom = lit(x0, y0 + 1) * (1.0 - fx) + lit(x0 + 1, y0 + 1) * fx;
+    return static_cast<float>(top * (1.0 - fy) + bottom * fy);
+}
+
+void ShadowCache::packRGBA(std::vector<std::uint8_t>& rgba) const {
+    rgba.resize(depth.size() * 4);
+    for (std::size_t i = 0; i < depth.size(); ++i) {
+        const double normalized = std::isfinite(depth[i]) ? std::clamp(depth[i] / range, 0.0, 1.0) : 1.0;
+        const auto bits = static_cast<std::uint32_t>(std::lround(normalized * PACK_SCALE));
+        rgba[i * 4 + 0] = static_cast<std::uint8_t>(bits >> 16);
+        rgba[i * 4 + 1] = static_cast<std::uint8_t>(bits >> 8);
+        rgba[i * 4 + 2] = static_cast<std::uint8_t>(bits);
+        rgba[i * 4 + 3] = 255;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef RENDERING_PROJECT_SHADOWCACHE_H
+#define RENDERING_PROJECT_SHADOWCACHE_H
+
+#include "Objects/Object.h"
+#include "Vector3.h"
+#include <cstdint>
+#include <vector>
+
+
+// Light-space depth map of the static part of a scene for the directional light.
+// Every texel holds the distance from a plane facing the light to the first static
+// surface below it, so a shadow query against static geometry is four texel reads
+// instead of a march. The map is only rebuilt when the light or the static geometry
+// changes; objects it does not cover (dynamic ones, unbounded fields other than
+// planes) still have to be marched per pixel.
+class ShadowCache {
+public:
+    unsigned resolution = 1024;
+
+    // Map frame: texel (x, y) looks along -lightDir from
+    // origin + axisU * extent * (2x/res - 1) + axisV * extent * (2y/res - 1)
+    Vector3 lightDir;
+    Vector3 origin, axisU, axisV;
+    double extent = 0.0;  // half-size of the mapped square
+    double range = 0.0;   // depth covered along -lightDir
+    std::vector<float> depth;
+
+    // Forces a rebuild on the next update()
+    void invalidate() { valid = false; }
+
+    // Rebuilds the map if the light, the object list or the static geometry changed.
+    // Returns true if the map was rebuilt.
+    bool update(const std::vector<Object*>& objects, const Vector3& light, std::uint64_t staticVersion);
+
+    [[nodiscard]] bool isEnabled() const { return enabled; }
+    [[nodiscard]] double texelSize() const { return 2.0 * extent / resolution; }
+    [[nodiscard]] bool covers(const Object* object) const;
+    // Casters the map does not account for; these still need a per-pixel march
+    [[nodiscard]] const std::vector<Object*>& uncached() const { return rest; }
+
+    // Visibility of the light from surface point p against cached geometry: 1 lit,
+    // 0 shadowed, fractional on filtered edges. -1 if p lies outside the map.
+    [[nodiscard]] float visibility(const Vector3& p, const Vector3& normal) const;
+
+    // depth / range as 24-bit fixed point in RGB, one pixel per texel, for the shader
+    void packRGBA(std::vector<std::uint8_t>& rgba) const;
+
+private:
+    bool valid = false;
+    bool enabled = false;
+    Vector3 builtLight;
+    std::uint64_t builtVersion = 0;
+    std::size_t builtCount = 0;
+    std::vector<Object*> casters, rest;
+
+    void build();
+};
+
+
+#endif //RENDERING_PROJECT_SHADOWCACHE_H
@@ -0,0 +1,286 @@
+#include "StreamingImage.h"
+
+#include "CpuRenderer.h"
+#include <array>
+#include <cctype>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+
+namespace {
+    constexpr std::uint32_t ADLER_MOD = 65521;
+    constexpr std::size_t ADLER_NMAX = 5552;      // bytes before the sums can overflow 32 bits
+    constexpr std::size_t STORED_BLOCK = 65535;   // largest stored deflate block
+    constexpr std::uint32_t TIFF_ENTRIES = 10;
+    constexpr std::uint32_t TIFF_IFD = 8;
+    constexpr std::uint32_t TIFF_BITS = TIFF_IFD + 2 + TIFF_ENTRIES * 12 + 4;
+    constexpr std::uint32_t TIFF_ARRAYS = TIFF_BITS + 6;
+
+    void put16le(std::vector<std::uint8_t>& out, const std::uint32_t v) {
+        out.push_back(v & 0xFF);
+        out.push_back((v >> 8) & 0xFF);
+    }
+
+    void put32le(std::vector<std::uint8_t>& out, const std::uint32_t v) {
+        put16le(out, v & 0xFFFF);
+        put16le(out, v >> 16);
+    }
+
+    void put32be(std::vector<std::uint8_t>& out, const std::uint32_t v) {
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back((v >> shift) & 0xFF);
+    }
+
+    std::uint32_t crc32(const std::uint8_t* data, const std::size_t size) {
+        static const std::array<std::uint32_t, 256> table = [] {
+            std::array<std::uint32_t, 256> t{};
+            for (std::uint32_t n = 0; n < 256; ++n) {
+                std::uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        std::uint32_t c = 0xFFFFFFFFu;
+        for (std::size_t i = 0; i < size; ++i) c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+        return c ^ 0xFFFFFFFFu;
+    }
+
+    // Appends a PNG chunk: length, type, data, CRC of type and data
+    void pngChunk(std::vector<std::uint8_t>& out, const char* type, const std::vector<std::uint8_t>& data) {
+        put32be(out, static_cast<std::uint32_t>(data.size()));
+        const std::size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        put32be(out, crc32(out.data() + start, out.size() - start));
+    }
+
+    std::string lowercase(std::string s) {
+        for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+}
+
+StreamingImageWriter::Format StreamingImageWriter::formatOf(const std::string& path) {
+    const std::string extension = lowercase(std::filesystem::path(path).extension().string());
+    if (extension == ".ppm") return Format::PPM;
+    if (extension == ".png") return Format::PNG;
+    if (extension == ".tif" || extension == ".tiff") return Format::TIFF;
+    throw std::invalid_argument("StreamingImageWriter: unsupported file type '" + extension + "'");
+}
+
+StreamingImageWriter::StreamingImageWriter(std::string path, const unsigned width, const unsigned height,
+                                           const unsigned bandHeight, const bool resume) :
+    path(std::move(path)), format(formatOf(this->path)), imageWidth(width), imageHeight(height), rowsPerBand(bandHeight),
+    bandCount(bandHeight > 0 ? (height + bandHeight - 1) / bandHeight : 0) {
+    if (width == 0 || height == 0 || bandHeight == 0) throw std::invalid_argument("StreamingImageWriter: empty image or band");
+    if (format == Format::TIFF && TIFF_ARRAYS + 8ull * bandCount + 3ull * width * height > 0xFFFFFFFFull)
+        throw std::invalid_argument("StreamingImageWriter: image too large for a classic TIFF");
+
+    if (resume && loadCheckpoint()) {
+        file.open(this->path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(bytesWritten));
+    } else {
+        file.open(this->path, std::ios::out | std::ios::trunc | std::ios::binary);
+        write(header());
+        saveCheckpoint();
+    }
+    if (!file) throw std::runtime_error("StreamingImageWriter: cannot write '" + this->path + "'");
+}
+
+unsigned StreamingImageWriter::rowsIn(const unsigned band) const {
+    return std::min(rowsPerBand, imageHeight - band * rowsPerBand);
+}
+
+void StreamingImageWriter::addTile(const unsigned x, const unsigned y, const unsigned w, const unsigned h, const std::uint8_t* rgba) {
+    if (x + w > imageWidth || y + h > imageHeight) throw std::invalid_argument("StreamingImageWriter: tile outside the image");
+
+    for (unsigned row = 0; row < h; ++row) {
+        const unsigned band = (y + row) / rowsPerBand;
+        if (band < bandsWritten) continue;
+        Band& b = bands[band];
+        if (b.rgb.empty()) b.rgb.resize(std::size_t(rowsIn(band)) * imageWidth * 3);
+
+        const std::uint8_t* src = rgba + std::size_t(row) * w * 4;
+        std::uint8_t* dst = b.rgb.data() + (std::size_t(y + row - band * rowsPerBand) * imageWidth + x) * 3;
+        for (unsigned i = 0; i < w; ++i) {
+            dst[i * 3 + 0] = src[i * 4 + 0];
+            dst[i * 3 + 1] = src[i * 4 + 1];
+            dst[i * 3 + 2] = src[i * 4 + 2];
+        }
+        b.covered += w;
+    }
+    flushBands();
+}
+
+void StreamingImageWriter::flushBands() {
+    bool wrote = false;
+    for (auto it = bands.begin(); it != bands.end() && it->first == bandsWritten;) {
+        if (it->second.covered < std::size_t(rowsIn(it->first)) * imageWidth) break;
+        write(encode(it->first, it->second.rgb));
+        it = bands.erase(it);
+        ++bandsWritten;
+        wrote = true;
+    }
+    if (!wrote) return;
+
+    // The checkpoint may only list bytes that have left the stream
+    file.flush();
+    if (!file) throw std::runtime_error("StreamingImageWriter: cannot write '" + path + "'");
+    if (finished()) {
+        file.close();
+        std::filesystem::remove(path + ".checkpoint");
+    } else {
+        saveCheckpoint();
+    }
+}
+
+void StreamingImageWriter::write(const std::vector<std::uint8_t>& bytes) {
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    bytesWritten += bytes.size();
+}
+
+std::vector<std::uint8_t> StreamingImageWriter::header() const {
+    std::vector<std::uint8_t> out;
+    switch (format) {
+        case Format::PPM: {
+            const std::string text = "P6\n" + std::to_string(imageWidth) + " " + std::to_string(imageHeight) + "\n255\n";
+            out.assign(text.begin(), text.end());
+            break;
+        }
+        case Format::PNG: {
+            const std::uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+            out.assign(std::begin(signature), std::end(signature));
+            std::vector<std::uint8_t> ihdr;
+            put32be(ihdr, imageWidth);
+            put32be(ihdr, imageHeight);
+            ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0});  // 8 bit RGB, deflate, adaptive filters, no interlace
+            pngChunk(out, "IHDR", ihdr);
+            break;
+        }
+        case Format::TIFF: {
+            // Header, one IFD, BitsPerSample, strip offsets and byte counts, then the strips
+            const std::uint32_t offsets = TIFF_ARRAYS;
+            const std::uint32_t counts = offsets + 4 * bandCount;
+            const std::uint32_t data = counts + 4 * bandCount;
+            out.insert(out.end(), {'I', 'I', 42, 0});
+            put32le(out, TIFF_IFD);
+            put16le(out, TIFF_ENTRIES);
+            auto entry = [&](std::uint32_t tag, std::uint32_t type, std::uint32_t count, std::uint32_t value) {
+                put16le(out, tag);
+                put16le(out, type);
+                put32le(out, count);
+                if (type == 3 && count == 1) { put16le(out, value); put16le(out, 0); }
+                else put32le(out, value);
+            };
+            const std::uint32_t SHORT = 3, LONG = 4;
+            entry(256, LONG, 1, imageWidth);
+            entry(257, LONG, 1, imageHeight);
+            entry(258, SHORT, 3, TIFF_BITS);
+            entry(259, SHORT, 1, 1);                 // no compression
+            entry(262, SHORT, 1, 2);                 // RGB
+            entry(273, LONG, bandCount, bandCount == 1 ? data : offsets);
+            entry(277, SHORT, 1, 3);
+            entry(278, LONG, 1, rowsPerBand);
+            entry(279, LONG, bandCount, bandCount == 1 ? 3u * imageWidth * imageHeight : counts);
+            entry(284, SHORT, 1, 1);                 // interleaved
+            put32le(out, 0);                         // no further IFD
+            put16le(out, 8); put16le(out, 8); put16le(out, 8);
+
+            std::uint32_t strip = data;
+            for (unsigned band = 0; band < bandCount; ++band) {
+                put32le(out, strip);
+                strip += 3u * imageWidth * rowsIn(band);
+            }
+            for (unsigned band = 0; band < bandCount; ++band) put32le(out, 3u * imageWidth * rowsIn(band));
+            break;
+        }
+    }
+    return out;
+}
+
+std::vector<std::uint8_t> StreamingImageWriter::encode(const unsigned band, const std::vector<std::uint8_t>& rgb) {
+    if (format != Format::PNG) return rgb;
+
+    // Scanlines with filter type 0, as stored deflate blocks of one zlib stream that
+    // runs across all IDAT chunks
+    const std::size_t stride = std::size_t(imageWidth) * 3;
+    const unsigned rows = rowsIn(band);
+    std::vector<std::uint8_t> raw;
+    raw.reserve(rows * (stride + 1));
+    for (unsigned row = 0; row < rows; ++row) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + row * stride, rgb.begin() + (row + 1) * stride);
+    }
+    for (std::size_t i = 0; i < raw.size(); i += ADLER_NMAX) {
+        const std::size_t end = std::min(raw.size(), i + ADLER_NMAX);
+        for (std::size_t j = i; j < end; ++j) {
+            adlerA += raw[j];
+            adlerB += adlerA;
+        }
+        adlerA %= ADLER_MOD;
+        adlerB %= ADLER_MOD;
+    }
+
+    const bool last = band + 1 == bandCount;
+    std::vector<std::uint8_t> idat;
+    if (band == 0) idat.insert(idat.end(), {0x78, 0x01});
+    for (std::size_t i = 0; i < raw.size(); i += STORED_BLOCK) {
+        const std::size_t size = std::min(STORED_BLOCK, raw.size() - i);
+        idat.push_back(last && i + size == raw.size() ? 1 : 0);
+        put16le(idat, static_cast<std::uint32_t>(size));
+        put16le(idat, static_cast<std::uint32_t>(~size & 0xFFFF));
+        idat.insert(idat.end(), raw.begin() + i, raw.begin() + i + size);
+    }
+    if (last) put32be(idat, (adlerB << 16) | adlerA);
+
+    std::vector<std::uint8_t> out;
+    pngChunk(out, "IDAT", idat);
+    if (last) pngChunk(out, "IEND", {});
+    return out;
+}
+
+void StreamingImageWriter::saveCheckpoint() const {
+    // Replaced in one rename, so a crash leaves either the old or the new checkpoint
+    const std::string checkpoint = path + ".checkpoint";
+    {
+        std::ofstream out(checkpoint + ".tmp");
+        out << "streamimage 1 " << static_cast<int>(format) << ' ' << imageWidth << ' ' << imageHeight << ' ' << rowsPerBand
+            << ' ' << bandsWritten << ' ' << bytesWritten << ' ' << adlerA << ' ' << adlerB << '\n';
+        if (!out) throw std::runtime_error("StreamingImageWriter: cannot write '" + checkpoint + "'");
+    }
+    std::filesystem::rename(checkpoint + ".tmp", checkpoint);
+}
+
+bool StreamingImageWriter::loadCheckpoint() {
+    std::ifstream in(path + ".checkpoint");
+    std::string magic;
+    int version = 0, savedFormat = -1;
+    unsigned width = 0, height = 0, band = 0, written = 0;
+    std::uint64_t bytes = 0;
+    std::uint32_t a = 0, b = 0;
+    if (!(in >> magic >> version >> savedFormat >> width >> height >> band >> written >> bytes >> a >> b)) return false;
+    if (magic != "streamimage" || version != 1 || savedFormat != static_cast<int>(format) || width != imageWidth ||
+        height != imageHeight || band != rowsPerBand || written >= bandCount) return false;
+
+    // Bands written after the checkpoint was saved are cut off and rendered again
+    std::error_code error;
+    const std::uintmax_t size = std::filesystem::file_size(path, error);
+    if (error || size < bytes) return false;
+    std::filesystem::resize_file(path, bytes);
+    bandsWritten = written;
+    bytesWritten = bytes;
+    adlerA = a;
+    adlerB = b;
+    return true;
+}
+
+void renderStreaming(CpuRenderer& renderer, const CameraBasis& camera, StreamingImageWriter& writer) {
+    std::vector<std::uint8_t> rgba;
+    for (unsigned y = writer.firstPendingRow(); y < writer.height(); y += writer.bandHeight()) {
+        const unsigned rows = std::min(writer.bandHeight(), writer.height() - y);
+        renderer.renderRegion(camera, writer.width(), writer.height(), 0, y, writer.width(), rows, rgba);
+        writer.addTile(0, y, writer.width(), rows, rgba.data());
+    }
+}
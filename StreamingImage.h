@@ -0,0 +1,77 @@
+#ifndef RENDERING_PROJECT_STREAMINGIMAGE_H
+#define RENDERING_PROJECT_STREAMINGIMAGE_H
+
+#include "CameraBasis.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+struct CpuRenderer;
+
+
+// Writes an RGB image to disk in horizontal bands of bandHeight rows, so a poster-sized
+// still never has to exist in memory as a whole. Tiles can arrive in any order; a band
+// is buffered until it is covered and written as soon as every band above it is on disk.
+// Formats, chosen by extension:
+//   .ppm          binary P6
+//   .tif / .tiff  baseline uncompressed, one strip per band (classic TIFF, below 4 GB)
+//   .png          stored (uncompressed) deflate, one IDAT chunk per band
+// After each band the writer records its progress in "<path>.checkpoint". A writer that
+// finds a checkpoint for the same file, size and band height continues after the last
+// band it lists (firstPendingRow()) instead of starting over.
+class StreamingImageWriter {
+public:
+    enum class Format { PPM, PNG, TIFF };
+
+    // Throws std::invalid_argument for an unknown extension or size, std::runtime_error
+    // if the file cannot be written
+    StreamingImageWriter(std::string path, unsigned width, unsigned height, unsigned bandHeight = 64, bool resume = true);
+
+    // Adds w x h RGBA pixels (top row first) at (x, y); tiles must not overlap. Pixels of
+    // bands that are already on disk are ignored.
+    void addTile(unsigned x, unsigned y, unsigned w, unsigned h, const std::uint8_t* rgba);
+
+    [[nodiscard]] unsigned width() const { return imageWidth; }
+    [[nodiscard]] unsigned height() const { return imageHeight; }
+    [[nodiscard]] unsigned bandHeight() const { return rowsPerBand; }
+    // Rows above this one are on disk
+    [[nodiscard]] unsigned firstPendingRow() const { return std::min(bandsWritten * rowsPerBand, imageHeight); }
+    [[nodiscard]] bool finished() const { return bandsWritten == bandCount; }
+    [[nodiscard]] std::size_t bufferedBands() const { return bands.size(); }
+
+    static Format formatOf(const std::string& path);
+
+private:
+    struct Band {
+        std::vector<std::uint8_t> rgb;
+        std::size_t covered = 0;  // pixels received
+    };
+
+    std::string path;
+    Format format;
+    unsigned imageWidth, imageHeight, rowsPerBand, bandCount;
+    unsigned bandsWritten = 0;
+    std::uint64_t bytesWritten = 0;
+    std::uint32_t adlerA = 1, adlerB = 0;  // PNG: running zlib checksum of the image data
+    std::fstream file;
+    std::map<unsigned, Band> bands;        // complete or partial bands not yet on disk
+
+    [[nodiscard]] unsigned rowsIn(unsigned band) const;
+    [[nodiscard]] std::vector<std::uint8_t> header() const;
+    [[nodiscard]] std::vector<std::uint8_t> encode(unsigned band, const std::vector<std::uint8_t>& rgb);
+    void write(const std::vector<std::uint8_t>& bytes);
+    void flushBands();
+    void saveCheckpoint() const;
+    bool loadCheckpoint();
+};
+
+// Renders the camera's view band by band into `writer`, starting at its first pending
+// row, so the renderer's buffers only ever hold one band
+void renderStreaming(CpuRenderer& renderer, const CameraBasis& camera, StreamingImageWriter& writer);
+
+
+#endif //RENDERING_PROJECT_STREAMINGIMAGE_H
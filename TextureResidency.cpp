@@ -0,0 +1,166 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+    // Box-filters an image down by 2^level in both directions
+    sf::Image downscale(const sf::Image& source, const unsigned level) {
+        if (level == 0) return source;
+
+        const sf::Vector2u in = source.getSize();
+        const sf::Vector2u out(std::max(1u, in.x >> level), std::max(1u, in.y >> level));
+        const unsigned factor = 1u << level;
+        const std::uint8_t* src = source.getPixelsPtr();
+        std::vector<std::uint8_t> pixels(static_cast<std::size_t>(out.x) * out.y * 4);
+
+        for (unsigned y = 0; y < out.y; ++y) {
+            const unsigned y0 = y * factor, y1 = std::min(in.y, y0 + factor);
+            for (unsigned x = 0; x < out.x; ++x) {
+                const unsigned x0 = x * factor, x1 = std::min(in.x, x0 + factor);
+                unsigned sum[4] = {0, 0, 0, 0};
+                for (unsigned sy = y0; sy < y1; ++sy) {
+                    const std::uint8_t* row = src + (static_cast<std::size_t>(sy) * in.x + x0) * 4;
+                    for (unsigned sx = x0; sx < x1; ++sx, row += 4) {
+                        sum[0] += row[0]; sum[1] += row[1]; sum[2] += row[2]; sum[3] += row[3];
+                    }
+                }
+                const unsigned count = (y1 - y0) * (x1 - x0);
+                std::uint8_t* dst = &pixels[(static_cast<std::size_t>(y) * out.x + x) * 4];
+                for (int c = 0; c < 4; ++c) dst[c] = static_cast<std::uint8_t>(sum[c] / count);
+            }
+        }
+        return sf::Image(out, pixels.data());
+    }
+
+    unsigned maxLevelFor(const sf::Vector2u size) {
+        const unsigned side = std::max(size.x, size.y);
+        return side > 1 ? static_cast<unsigned>(std::floor(std::log2(static_cast<double>(side)))) : 0;
+    }
+}
+
+void TextureResidency::beginFrame() {
+    ++frame;
+    slots.clear();
+    for (auto& [path, entry] : entries) entry.slot = -1;
+}
+
+int TextureResidency::request(const std::string& path, const double projectedPixels) {
+    if (path.empty()) return -1;
+
+    Entry& entry = entries[path];
+    if (entry.failed) return -1;
+    entry.lastUsed = frame;
+
+    bool reload = entry.bytes == 0;
+    if (reload && entry.sourceSize.x > 0) {
+        // Known size: skip the decode while not even the coarsest level would fit
+        if (bytesAt(entry.sourceSize, maxLevelFor(entry.sourceSize)) > available(entry)) return -1;
+    } else if (!reload) {
+        const unsigned wanted = levelFor(entry.sourceSize, projectedPixels);
+        if (wanted > entry.level + 1) {
+            reload = true; // far away now: drop to a cheaper level
+        } else if (wanted < entry.level) {
+            // Only go finer if the next level would actually fit in the budget
+            reload = bytesAt(entry.sourceSize, entry.level - 1) <= available(entry);
+        }
+    }
+
+    if (reload && !load(path, entry, projectedPixels) && entry.bytes == 0)
+        return -1;
+
+    if (entry.slot < 0) {
+        if (slots.size() >= maxSlots) return -1;
+        entry.slot = static_cast<int>(slots.size());
+        slots.push_back(&entry.texture);
+    }
+    return entry.slot;
+}
+
+void TextureResidency::setBudget(const std::size_t bytes) {
+    budgetBytes = bytes;
+    makeRoom(0, nullptr);
+}
+
+bool TextureResidency::load(const std::string& path, Entry& entry, const double projectedPixels) {
+    sf::Image image;
+    bool found = false;
+    // Try different path variations
+    for (const std::string& tryPath : {path, "../" + path, "./" + path}) {
+        if (image.loadFromFile(tryPath)) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        unload(entry);
+        entry.failed = true;
+        return false;
+    }
+
+    entry.sourceSize = image.getSize();
+    const unsigned maxLevel = maxLevelFor(entry.sourceSize);
+    unsigned level = levelFor(entry.sourceSize, projectedPixels);
+
+    // Coarsen until the texture fits next to everything used this frame
+    residentBytes -= entry.bytes;
+    while (!makeRoom(bytesAt(entry.sourceSize, level), &entry)) {
+        if (level == maxLevel) {
+            residentBytes += entry.bytes;
+            return false;
+        }
+        ++level;
+    }
+
+    if (!entry.texture.loadFromImage(downscale(image, level))) {
+        entry.bytes = 0;
+        return false;
+    }
+    entry.texture.setRepeated(true);
+    entry.level = level;
+    entry.bytes = bytesAt(entry.sourceSize, level);
+    residentBytes += entry.bytes;
+    return true;
+}
+
+void TextureResidency::unload(Entry& entry) {
+    residentBytes -= entry.bytes;
+    entry.bytes = 0;
+    entry.texture = sf::Texture();
+}
+
+bool TextureResidency::makeRoom(const std::size_t bytes, const Entry* keep) {
+    while (residentBytes + bytes > budgetBytes) {
+        Entry* victim = nullptr;
+        for (auto& [path, entry] : entries) {
+            if (&entry == keep || entry.bytes == 0 || entry.lastUsed >= frame) continue;
+            if (!victim || entry.lastUsed < victim->lastUsed) victim = &entry;
+        }
+        if (!victim) return false;
+        unload(*victim);
+    }
+    return true;
+}
+
+std::size_t TextureResidency::available(const Entry& entry) const {
+    std::size_t bytes = (budgetBytes > residentBytes ? budgetBytes - residentBytes : 0) + entry.bytes;
+    for (const auto& [path, other] : entries)
+        if (&other != &entry && other.lastUsed < frame) bytes += other.bytes;
+    return bytes;
+}
+
+unsigned TextureResidency::levelFor(const sf::Vector2u size, const double projectedPixels) {
+    // Wrapped UVs show roughly half the texture across the object's diameter,
+    // so aim for two texels per projected pixel along the largest side.
+    const double needed = std::max(1.0, projectedPixels * 2.0);
+    const double side = std::max(size.x, size.y);
+    if (side <= needed) return 0;
+    return std::min(maxLevelFor(size), static_cast<unsigned>(std::floor(std::log2(side / needed))));
+}
+
+std::size_t TextureResidency::bytesAt(const sf::Vector2u size, const unsigned level) {
+    const std::size_t w = std::max(1u, size.x >> level);
+    const std::size_t h = std::max(1u, size.y >> level);
+    return w * h * 4; // RGBA8
+}
@@ -0,0 +1,55 @@
+#ifndef RENDERING_PROJECT_TEXTURERESIDENCY_H
+#define RENDERING_PROJECT_TEXTURERESIDENCY_H
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Keeps object textures resident on the GPU under a fixed memory budget.
+// Textures are loaded on first request (i.e. when an object using them becomes visible),
+// downscaled to the mip level matching their projected size, and evicted least-recently-used.
+struct TextureResidency {
+    struct Entry {
+        sf::Texture texture;
+        sf::Vector2u sourceSize{0, 0};  // full-resolution size, known after the first load (even one
+                                        // that did not fit, so it is not decoded again until it would)
+        unsigned level = 0;             // resident level: 0 = full size, n = size / 2^n
+        std::size_t bytes = 0;          // 0 = not resident
+        std::uint64_t lastUsed = 0;     // frame index of the last request
+        int slot = -1;                  // sampler slot for the current frame
+        bool failed = false;            // file missing/unreadable, never retried
+    };
+
+    std::size_t budgetBytes;
+    unsigned maxSlots;                  // number of sampler uniforms in the shader
+    std::size_t residentBytes = 0;
+    std::uint64_t frame = 0;
+    std::map<std::string, Entry> entries;
+    std::vector<const sf::Texture*> slots;  // slot -> texture bound this frame
+
+    explicit TextureResidency(std::size_t budgetBytes = 64u << 20, unsigned maxSlots = 8) :
+        budgetBytes(budgetBytes), maxSlots(maxSlots) {}
+
+    // Starts a new frame: sampler slots are reassigned from scratch
+    void beginFrame();
+    // Makes the texture resident at a level suited to `projectedPixels` (on-screen diameter)
+    // and returns its sampler slot for this frame, or -1 if it could not be made resident.
+    int request(const std::string& path, double projectedPixels);
+    void setBudget(std::size_t bytes);
+
+private:
+    bool load(const std::string& path, Entry& entry, double projectedPixels);
+    void unload(Entry& entry);
+    bool makeRoom(std::size_t bytes, const Entry* keep);
+    // Bytes `entry` could take this frame: free budget plus whatever is resident but unused
+    std::size_t available(const Entry& entry) const;
+    static unsigned levelFor(sf::Vector2u size, double projectedPixels);
+    static std::size_t bytesAt(sf::Vector2u size, unsigned level);
+};
+
+
+#endif //RENDERING_PROJECT_TEXTURERESIDENCY_H
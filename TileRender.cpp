@@ -0,0 +1,328 @@
+#include "TileRender.h"
+
+#include "CameraBasis.h"
+#include "Constants.h"
+#include "CpuRenderer.h"
+#include "PathTracer.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#define TILE_RENDER_POSIX 1
+#endif
+
+
+namespace {
+    enum Message : std::uint8_t { Job = 1, Tile = 2, Done = 3, Result = 10 };
+
+    using Clock = std::chrono::steady_clock;
+    constexpr auto SEND_TIMEOUT = std::chrono::seconds(1);
+    constexpr int CONNECT_ATTEMPTS = 50;  // the coordinator may still be starting up
+    constexpr auto CONNECT_RETRY = std::chrono::milliseconds(100);
+
+    struct TileRect {
+        std::uint32_t x, y, width, height;
+    };
+
+    struct Worker {
+        sf::TcpSocket socket;
+        std::vector<std::pair<std::uint32_t, Clock::time_point>> assigned;  // tiles out and when they were sent
+        bool alive = true;
+    };
+
+    sf::Packet& operator<<(sf::Packet& packet, const Vector3& v) { return packet << v.getX() << v.getY() << v.getZ(); }
+
+    sf::Packet& operator>>(sf::Packet& packet, Vector3& v) {
+        double x = 0, y = 0, z = 0;
+        packet >> x >> y >> z;
+        v = Vector3(x, y, z);
+        return packet;
+    }
+
+    // Sends a whole packet on a non-blocking socket; false if the peer is gone or stuck
+    bool sendAll(sf::TcpSocket& socket, sf::Packet& packet) {
+        const auto deadline = Clock::now() + SEND_TIMEOUT;
+        for (;;) {
+            const sf::Socket::Status status = socket.send(packet);
+            if (status == sf::Socket::Status::Done) return true;
+            if (status != sf::Socket::Status::Partial && status != sf::Socket::Status::NotReady) return false;
+            if (Clock::now() > deadline) return false;
+            std::this_thread::yield();
+        }
+    }
+}
+
+TileCoordinator::TileCoordinator(const unsigned short port) {
+    if (listener.listen(port) != sf::Socket::Status::Done) {
+        throw std::runtime_error("TileCoordinator: cannot listen on port " + std::to_string(port));
+    }
+}
+
+std::vector<std::uint8_t> TileCoordinator::render(const RenderJob& job, const std::vector<int>& localWorkers) {
+    const auto start = Clock::now();
+    lastStats = {};
+    std::vector<std::uint8_t> image(static_cast<std::size_t>(job.width) * job.height * 4, 0);
+
+    std::vector<TileRect> tiles;
+    for (std::uint32_t y = 0; y < job.height; y += tileSize)
+        for (std::uint32_t x = 0; x < job.width; x += tileSize)
+            tiles.push_back({x, y, std::min<std::uint32_t>(tileSize, job.width - x), std::min<std::uint32_t>(tileSize, job.height - y)});
+    lastStats.tiles = static_cast<unsigned>(tiles.size());
+
+    std::deque<std::uint32_t> pending(tiles.size());
+    std::iota(pending.begin(), pending.end(), 0u);
+    std::vector<std::uint8_t> done(tiles.size(), 0);
+    std::vector<std::uint8_t> holders(tiles.size(), 0);  // workers a tile is currently out with
+    std::size_t remaining = tiles.size();
+    double averageSeconds = 0.0;  // from handing a tile out to getting it back
+    std::size_t measured = 0;
+
+    sf::Packet jobPacket;
+    jobPacket << std::uint8_t(Job) << job.scene << job.cameraOrigin << job.cameraForward << job.light << job.fov
+              << std::uint32_t(job.width) << std::uint32_t(job.height) << std::uint32_t(job.maxSteps) << std::int32_t(job.maxReflectionDepth)
+              << std::uint32_t(job.pathSamples) << std::uint32_t(job.edgeSamples);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    sf::SocketSelector selector;
+    selector.add(listener);
+
+    auto give = [&](Worker& worker, const std::uint32_t index) {
+        const TileRect& t = tiles[index];
+        sf::Packet packet;
+        packet << std::uint8_t(Tile) << index << t.x << t.y << t.width << t.height;
+        if (!sendAll(worker.socket, packet)) return false;
+        worker.assigned.emplace_back(index, Clock::now());
+        ++holders[index];
+        return true;
+    };
+
+    // A lost worker's tiles go back to the front of the queue
+    auto drop = [&](Worker& worker) {
+        for (const auto& [index, sent] : worker.assigned) {
+            --holders[index];
+            if (!done[index]) {
+                pending.push_front(index);
+                ++lastStats.reissued;
+            }
+        }
+        worker.assigned.clear();
+        selector.remove(worker.socket);
+        worker.socket.disconnect();
+        worker.alive = false;
+    };
+
+    auto receive = [&](Worker& worker, sf::Packet& packet) {
+        std::uint8_t kind = 0;
+        std::uint32_t index = 0;
+        packet >> kind >> index;
+        const auto it = std::find_if(worker.assigned.begin(), worker.assigned.end(), [&](const auto& a) { return a.first == index; });
+        const std::size_t bytes = packet.getDataSize() - packet.getReadPosition();
+        if (!packet || kind != Result || it == worker.assigned.end() || bytes != std::size_t(tiles[index].width) * tiles[index].height * 4) {
+            drop(worker);  // protocol error
+            return;
+        }
+
+        const double seconds = std::chrono::duration<double>(Clock::now() - it->second).count();
+        averageSeconds += (seconds - averageSeconds) / static_cast<double>(++measured);
+        worker.assigned.erase(it);
+        --holders[index];
+        if (done[index]) return;  // a re-issued copy came back second
+
+        const TileRect& t = tiles[index];
+        const auto* pixels = static_cast<const std::uint8_t*>(packet.getData()) + packet.getReadPosition();
+        for (std::uint32_t row = 0; row < t.height; ++row) {
+            std::copy_n(pixels + std::size_t(row) * t.width * 4, std::size_t(t.width) * 4,
+                        image.begin() + (std::size_t(t.y + row) * job.width + t.x) * 4);
+        }
+        done[index] = 1;
+        --remaining;
+    };
+
+    // Oldest tile that has been out too long and is not already duplicated
+    auto overdue = [&](const Worker& taker, const Clock::time_point now) {
+        const double limit = std::max(minReissueSeconds, reissueFactor * averageSeconds);
+        std::uint32_t best = 0;
+        Clock::time_point bestSent = now;
+        bool found = false;
+        for (const auto& worker : workers) {
+            if (!worker->alive || worker.get() == &taker) continue;
+            for (const auto& [index, sent] : worker->assigned) {
+                if (done[index] || holders[index] > 1 || sent >= bestSent) continue;
+                if (std::chrono::duration<double>(now - sent).count() < limit) continue;
+                best = index;
+                bestSent = sent;
+                found = true;
+            }
+        }
+        return std::make_pair(found, best);
+    };
+
+    std::vector<int> running = localWorkers;
+    auto idleSince = start;  // last time a worker was connected
+    while (remaining > 0) {
+        // Nobody left to render the remaining tiles: fail instead of waiting forever
+        const auto checked = Clock::now();
+        if (std::any_of(workers.begin(), workers.end(), [](const auto& worker) { return worker->alive; }))
+            idleSince = checked;
+        else if (std::chrono::duration<double>(checked - idleSince).count() > idleTimeoutSeconds) {
+            std::ostringstream message;
+            message << "TileCoordinator: no worker connected for " << idleTimeoutSeconds << " s, " << remaining << " tiles left";
+            throw std::runtime_error(message.str());
+        }
+        if (!localWorkers.empty() && reapLocalWorkers(running) == 0)
+            throw std::runtime_error("TileCoordinator: every local worker exited with " + std::to_string(remaining) + " tiles left");
+
+        if (selector.wait(sf::milliseconds(50))) {
+            if (selector.isReady(listener)) {
+                auto worker = std::make_unique<Worker>();
+                if (listener.accept(worker->socket) == sf::Socket::Status::Done &&
+                    worker->socket.send(jobPacket) == sf::Socket::Status::Done) {
+                    worker->socket.setBlocking(false);
+                    selector.add(worker->socket);
+                    workers.push_back(std::move(worker));
+                    ++lastStats.workers;
+                }
+            }
+            for (const auto& worker : workers) {
+                if (!worker->alive || !selector.isReady(worker->socket)) continue;
+                for (sf::Packet packet; worker->alive;) {
+                    const sf::Socket::Status status = worker->socket.receive(packet);
+                    if (status == sf::Socket::Status::NotReady) break;
+                    if (status == sf::Socket::Status::Done) receive(*worker, packet);
+                    else drop(*worker);
+                }
+            }
+        }
+
+        // Top every worker up to tilesInFlight: queued tiles first, then overdue ones
+        const auto now = Clock::now();
+        for (const auto& worker : workers) {
+            while (worker->alive && worker->assigned.size() < tilesInFlight) {
+                while (!pending.empty() && done[pending.front()]) pending.pop_front();
+                std::uint32_t index;
+                if (!pending.empty()) {
+                    index = pending.front();
+                    pending.pop_front();
+                } else {
+                    const auto [found, late] = overdue(*worker, now);
+                    if (!found) break;
+                    index = late;
+                    ++lastStats.reissued;
+                }
+                if (!give(*worker, index)) {
+                    pending.push_front(index);
+                    drop(*worker);
+                }
+            }
+        }
+    }
+
+    for (const auto& worker : workers) {
+        if (!worker->alive) continue;
+        sf::Packet packet;
+        packet << std::uint8_t(Done);
+        sendAll(worker->socket, packet);
+        worker->socket.disconnect();
+    }
+    lastStats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return image;
+}
+
+std::size_t runTileWorker(const sf::IpAddress coordinator, const unsigned short port) {
+    sf::TcpSocket socket;
+    bool connected = false;
+    for (int attempt = 0; attempt < CONNECT_ATTEMPTS && !connected; ++attempt) {
+        connected = socket.connect(coordinator, port, sf::seconds(1)) == sf::Socket::Status::Done;
+        if (!connected) std::this_thread::sleep_for(CONNECT_RETRY);
+    }
+    if (!connected) throw std::runtime_error("TileRender: cannot connect to the coordinator");
+
+    sf::Packet packet;
+    if (socket.receive(packet) != sf::Socket::Status::Done) return 0;
+    std::uint8_t kind = 0;
+    RenderJob job;
+    std::uint32_t width = 0, height = 0, maxSteps = 0, pathSamples = 0, edgeSamples = 0;
+    std::int32_t maxReflectionDepth = 0;
+    packet >> kind >> job.scene >> job.cameraOrigin >> job.cameraForward >> job.light >> job.fov >> width >> height >> maxSteps >> maxReflectionDepth
+           >> pathSamples >> edgeSamples;
+    if (!packet || kind != Job) throw std::runtime_error("TileRender: expected a job from the coordinator");
+
+    Scene scene;
+    std::istringstream in(job.scene);
+    readScene(in, scene);
+    CpuRenderer renderer(scene, job.light, job.fov);
+    renderer.maxSteps = maxSteps;
+    renderer.maxReflectionDepth = maxReflectionDepth;
+    renderer.edgeSamples = edgeSamples;
+    const CameraBasis camera(job.cameraOrigin, job.cameraForward, Z);
+    // Path-traced tiles come out the same whichever worker renders them, so reissued tiles agree
+    PathTracer tracer(renderer);
+    tracer.maxSamples = std::max(1u, pathSamples);
+
+    std::vector<std::uint8_t> pixels;
+    std::size_t rendered = 0;
+    while (socket.receive(packet) == sf::Socket::Status::Done) {
+        std::uint32_t index = 0, x = 0, y = 0, w = 0, h = 0;
+        packet >> kind >> index >> x >> y >> w >> h;
+        if (!packet || kind != Tile) break;
+
+        if (pathSamples > 0) tracer.render(camera, width, height, x, y, w, h, pixels);
+        else renderer.renderRegion(camera, width, height, x, y, w, h, pixels);
+        sf::Packet result;
+        result << std::uint8_t(Result) << index;
+        result.append(pixels.data(), pixels.size());
+        if (socket.send(result) != sf::Socket::Status::Done) break;
+        ++rendered;
+    }
+    return rendered;
+}
+
+std::vector<int> spawnLocalWorkers(const std::string& executable, const unsigned count, const unsigned short port, const unsigned threads) {
+#ifdef TILE_RENDER_POSIX
+    const std::string address = "127.0.0.1:" + std::to_string(port);
+    const std::string threadCount = std::to_string(threads);
+    std::vector<int> processes;
+    for (unsigned i = 0; i < count; ++i) {
+        std::vector<std::string> args = {executable, "--worker", address, "--threads", threadCount};
+        std::vector<char*> argv;
+        for (std::string& arg : args) argv.push_back(arg.data());
+        argv.push_back(nullptr);
+        pid_t pid = 0;
+        if (posix_spawnp(&pid, executable.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+            throw std::runtime_error("TileRender: cannot start '" + executable + "'");
+        }
+        processes.push_back(pid);
+    }
+    return processes;
+#else
+    (void)executable; (void)count; (void)port; (void)threads;
+    throw std::runtime_error("TileRender: local worker processes are only supported on POSIX systems");
+#endif
+}
+
+void waitLocalWorkers(const std::vector<int>& processes) {
+#ifdef TILE_RENDER_POSIX
+    for (const int pid : processes) waitpid(pid, nullptr, 0);
+#else
+    (void)processes;
+#endif
+}
+
+std::size_t reapLocalWorkers(std::vector<int>& processes) {
+#ifdef TILE_RENDER_POSIX
+    std::erase_if(processes, [](const int pid) { return waitpid(pid, nullptr, WNOHANG) != 0; });
+#endif
+    return processes.size();
+}
@@ -0,0 +1,88 @@
+#ifndef RENDERING_PROJECT_TILERENDER_H
+#define RENDERING_PROJECT_TILERENDER_H
+
+#include "Vector3.h"
+#include <SFML/Network.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Distributed rendering of one still frame. A coordinator cuts the frame into tiles and
+// hands them out over TCP to worker processes (on this or other machines), which render
+// them with the CPU renderer and send the pixels back:
+//
+//     coordinator -> worker   Job     scene (SceneFile text), camera, light, settings; once
+//     coordinator -> worker   Tile    tile to render; up to tilesInFlight outstanding
+//     worker -> coordinator   Result  tile pixels
+//     coordinator -> worker   Done    the frame is complete, the worker exits
+//
+// Tiles are handed out on demand, so fast workers take more of them. A worker that
+// disconnects gives its tiles back; a tile that stays out much longer than tiles usually
+// take (slow or hung worker) is handed to another worker as well, and whichever result
+// comes first is used.
+
+// Everything a worker needs to render tiles of one frame
+struct RenderJob {
+    std::string scene;  // writeScene() output
+    Vector3 cameraOrigin;
+    Vector3 cameraForward{0, 1, 0};
+    Vector3 light{0, 0, 1};  // direction towards the light
+    double fov = 1.0;
+    unsigned width = 0, height = 0;
+    unsigned maxSteps = 512;
+    int maxReflectionDepth = 2;
+    unsigned pathSamples = 0;  // > 0: path traced (PathTracer.h) with up to this many samples per pixel
+    unsigned edgeSamples = 0;  // > 0: edge anti-aliasing with up to this many extra rays per pixel
+};
+
+class TileCoordinator {
+public:
+    unsigned tileSize = 64;
+    unsigned tilesInFlight = 2;     // per worker, so a worker never idles waiting for its next tile
+    double reissueFactor = 4.0;     // a tile out this many times the average tile time is handed out again
+    double minReissueSeconds = 2.0;
+    double idleTimeoutSeconds = 60.0;  // render() gives up after this long without a connected worker
+
+    struct Stats {
+        unsigned workers = 0;       // connections accepted
+        unsigned tiles = 0;
+        unsigned reissued = 0;      // tiles handed out again after a disconnect or timeout
+        double seconds = 0.0;
+    };
+
+    // Listens on `port`; 0 picks a free port (see port())
+    explicit TileCoordinator(unsigned short port = 0);
+
+    [[nodiscard]] unsigned short port() const { return listener.getLocalPort(); }
+
+    // Renders the frame with whichever workers connect, blocking until every tile is back.
+    // Returns width * height RGBA pixels, top row first. Throws std::runtime_error if no
+    // worker is connected for idleTimeoutSeconds, or if `localWorkers` (process ids from
+    // spawnLocalWorkers) is not empty and all of those processes exit before the frame is done.
+    std::vector<std::uint8_t> render(const RenderJob& job, const std::vector<int>& localWorkers = {});
+
+    [[nodiscard]] const Stats& stats() const { return lastStats; }
+
+private:
+    sf::TcpListener listener;
+    Stats lastStats;
+};
+
+// Connects to a coordinator and renders tiles until the frame is done or the connection
+// drops. Returns the number of tiles rendered.
+std::size_t runTileWorker(sf::IpAddress coordinator, unsigned short port);
+
+// Starts `count` copies of `executable` as local workers ("--worker 127.0.0.1:<port>
+// --threads <threads>"). Returns their process ids; POSIX only, throws std::runtime_error
+// elsewhere or if a process cannot be started.
+std::vector<int> spawnLocalWorkers(const std::string& executable, unsigned count, unsigned short port, unsigned threads);
+// Waits for processes started by spawnLocalWorkers
+void waitLocalWorkers(const std::vector<int>& processes);
+// Reaps the listed processes that have exited, without blocking, and removes them from
+// the list; returns how many are still running
+std::size_t reapLocalWorkers(std::vector<int>& processes);
+
+
+#endif //RENDERING_PROJECT_TILERENDER_H
@@ -0,0 +1,97 @@
+#include "Timeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+
+Timeline::Track::Track(Object* object, std::string parameter) :
+    object(object), parameter(std::move(parameter)), applied(std::numeric_limits<double>::quiet_NaN()) {}
+
+Timeline::Track& Timeline::Track::key(const double time, const double value) {
+    auto it = std::upper_bound(keys.begin(), keys.end(), time, [](double t, const Keyframe& k) { return t < k.time; });
+    keys.insert(it, {time, value});
+    return *this;
+}
+
+double Timeline::Track::valueAt(double time) const {
+    // No keys, no value: never fall back to `applied`, which apply() owns
+    if (keys.empty()) return std::numeric_limits<double>::quiet_NaN();
+    if (keys.size() == 1) return keys.front().value;
+
+    const Keyframe& first = keys.front();
+    const Keyframe& last = keys.back();
+    const double span = last.time - first.time;
+
+    if (time < first.time || time > last.time) {
+        switch (extrapolation) {
+            case Extrapolation::Clamp:
+                return time < first.time ? first.value : last.value;
+            case Extrapolation::Loop:
+                if (span <= 0.0) return last.value;
+                time = first.time + (time - first.time) - std::floor((time - first.time) / span) * span;
+                break;
+            case Extrapolation::Linear: {
+                // Continue along the slope of the outermost segment
+                const Keyframe& a = time < first.time ? keys[0] : keys[keys.size() - 2];
+                const Keyframe& b = time < first.time ? keys[1] : last;
+                if (b.time == a.time) return b.value;
+                return a.value + (b.value - a.value) * (time - a.time) / (b.time - a.time);
+            }
+        }
+    }
+
+    auto next = std::upper_bound(keys.begin(), keys.end(), time, [](double t, const Keyframe& k) { return t < k.time; });
+    if (next == keys.end()) return last.value;
+    const Keyframe& b = *next;
+    const Keyframe& a = *(next - 1);
+
+    double f = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1.0;
+    switch (interpolation) {
+        case Interpolation::Step: f = 0.0; break;
+        case Interpolation::Linear: break;
+        case Interpolation::Smooth: f = f * f * (3.0 - 2.0 * f); break;
+    }
+    return a.value + (b.value - a.value) * f;
+}
+
+Timeline::Track& Timeline::animate(Object* object, std::string parameter) {
+    return tracks.emplace_back(object, std::move(parameter));
+}
+
+Timeline::Track& Timeline::animate(const std::string& objectName, std::string parameter) {
+    Object* object = scene.find(objectName);
+    if (!object) throw std::invalid_argument("Timeline: no object named '" + objectName + "'");
+    return animate(object, std::move(parameter));
+}
+
+std::size_t Timeline::evaluate(const double time) {
+    std::vector<double> values;
+    sample(time, values);
+    return apply(values);
+}
+
+void Timeline::sample(const double time, std::vector<double>& values) const {
+    values.resize(tracks.size());
+    for (std::size_t i = 0; i < tracks.size(); ++i) values[i] = tracks[i].valueAt(time);
+}
+
+std::size_t Timeline::apply(const std::vector<double>& values) {
+    std::size_t changed = 0;
+    const std::size_t count = std::min(values.size(), tracks.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        Track& track = tracks[i];
+        const double value = values[i];
+        if (value == track.applied || std::isnan(value)) continue;
+        if (!track.object->setParameter(track.parameter, value)) {
+            throw std::invalid_argument("Timeline: object has no parameter '" + track.parameter + "'");
+        }
+        track.applied = value;
+        scene.markDirty(track.object);
+        ++changed;
+    }
+    scene.commitChanges();
+    return changed;
+}
@@ -0,0 +1,67 @@
+#ifndef RENDERING_PROJECT_TIMELINE_H
+#define RENDERING_PROJECT_TIMELINE_H
+
+#include "Objects/Object.h"
+#include "Scene.h"
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+
+// Keyframed animation of named object parameters (see Object::setParameter).
+// evaluate() only writes values that actually changed and reports those objects to the
+// scene as dirty, so a static scene with one animated object re-processes just that object.
+class Timeline {
+public:
+    enum class Interpolation { Step, Linear, Smooth };
+    enum class Extrapolation { Clamp, Loop, Linear };  // behaviour outside the keyed range
+
+    struct Keyframe {
+        double time;
+        double value;
+    };
+
+    struct Track {
+        Object* object;
+        std::string parameter;
+        std::vector<Keyframe> keys;  // sorted by time
+        Interpolation interpolation = Interpolation::Linear;
+        Extrapolation extrapolation = Extrapolation::Clamp;
+        double applied;              // last value written to the object (NaN before the first)
+
+        Track(Object* object, std::string parameter);
+
+        Track& key(double time, double value);
+        Track& interpolate(Interpolation mode) { interpolation = mode; return *this; }
+        Track& extrapolate(Extrapolation mode) { extrapolation = mode; return *this; }
+
+        // NaN for a track without keys, which apply() skips
+        [[nodiscard]] double valueAt(double time) const;
+    };
+
+    explicit Timeline(Scene& scene) : scene(scene) {}
+
+    Track& animate(Object* object, std::string parameter);
+    // Looks the object up by its scene name; throws std::invalid_argument if there is none
+    Track& animate(const std::string& objectName, std::string parameter);
+
+    // Applies every track at `time` and commits the resulting changes to the scene.
+    // Throws std::invalid_argument if an object does not know a track's parameter.
+    // Returns the number of parameters that changed.
+    std::size_t evaluate(double time);
+
+    // evaluate() in two halves, so the values can be computed on another thread than
+    // the one that owns the scene: sample() only reads the tracks and writes one value
+    // per track (in animate() order) to `values`; apply() writes them to the objects and
+    // skips NaN values, such as those of tracks without keys.
+    void sample(double time, std::vector<double>& values) const;
+    std::size_t apply(const std::vector<double>& values);
+
+private:
+    Scene& scene;
+    std::deque<Track> tracks;  // deque keeps returned Track references valid
+};
+
+
+#endif //RENDERING_PROJECT_TIMELINE_H
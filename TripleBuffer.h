@@ -0,0 +1,48 @@
+#ifndef RENDERING_PROJECT_TRIPLEBUFFER_H
+#define RENDERING_PROJECT_TRIPLEBUFFER_H
+
+#include <atomic>
+
+
+// Lock-free hand-over of the newest value from one producer thread to one consumer
+// thread. The producer fills back() and publish()es it; the consumer latch()es whatever
+// was published last and reads it through front(). Neither side ever waits: the three
+// slots are swapped through a single atomic index, so the producer always has a slot
+// to write and the consumer always has a complete value to read. Values published in
+// between two latches are skipped, which is what a camera wants.
+template<class T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Producer side: the slot to fill. Its previous content is stale, so overwrite it all.
+    T& back() { return slots[backIndex]; }
+
+    void publish() {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side: makes the newest published value current. Returns false (and keeps
+    // the current value) if nothing was published since the last latch.
+    bool latch() {
+        if (!(middle.load(std::memory_order_acquire) & FRESH)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T& front() const { return slots[frontIndex]; }
+
+private:
+    static constexpr unsigned INDEX = 3;
+    static constexpr unsigned FRESH = 4;  // set in `middle` by publish(), cleared by latch()
+
+    T slots[3];
+    unsigned backIndex = 0;         // owned by the producer
+    std::atomic<unsigned> middle{1};
+    unsigned frontIndex = 2;        // owned by the consumer
+};
+
+
+#endif //RENDERING_PROJECT_TRIPLEBUFFER_H
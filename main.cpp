@@ -5,6 +5,12 @@
 #include <optional>
 #include <set>
 #include <random>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
 
 #include "Objects/Box.h"
 #include "Ray.h"
@@ -12,94 +18,375 @@
 #include <SFML/Graphics.hpp>
 
 #include "RayMarchingRender.h"
+#include "BatchRender.h"
+#include "CpuRenderer.h"
+#include "CsgProgram.h"
+#include "Parallel.h"
+#include "PathTracer.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "StreamingImage.h"
+#include "TileRender.h"
+#include "Timeline.h"
+#include "TripleBuffer.h"
+#include "CSGoperations/Difference.h"
+#include "CSGoperations/Intersection.h"
+#include "CSGoperations/Repetition.h"
+#include "CSGoperations/Transform.h"
+#include "CSGoperations/Union.h"
+#include "Objects/Capsule.h"
+#include "Objects/Cylinder.h"
 #include "Objects/Mandelbulb.h"
 #include "Objects/QuaternionJulia.h"
 #include "Objects/Plane.h"
 #include "Objects/Sphere.h"
 #include "Objects/Terrain.h"
+#include "Objects/Torus.h"
 
 using namespace std;
 
-int main()
+// ---------------- SCENE ----------------
+// Shadow demonstration scene:
+// - Big box at the top
+// - Sphere below the box (should be in shadow, but isn't without shadow implementation)
+// All objects are owned by the scene and released together when it goes out of scope.
+static void buildScene(Scene& scene)
 {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
-
-    // Random number generator for QuaternionJulia animation
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> signDist(0, 1);  // 0 or 1 for sign
-
-    // ---------------- CAMERA ----------------
-    // Start camera at standing height (Z = 2) looking forward
-    // Z is up, Y is forward, X is right
-    Ray camera({0, 0, 10}, Z*-1+X*0.001);
-
-    // FPS camera state - using proper spherical coordinates
-    // Yaw: rotation around Z axis (horizontal look left/right)
-    // Pitch: angle from horizontal plane (vertical look up/down)
-    double yaw = 0.0;      // 0 = looking along +Y
-    double pitch = 0.0;    // 0 = looking horizontally
-    const double mouseSensitivity = 0.003;
-    const double maxPitch = PI / 2.1;
-
-    // ---------------- SCENE ----------------
-    // Shadow demonstration scene:
-    // - Big box at the top
-    // - Sphere below the box (should be in shadow, but isn't without shadow implementation)
-    std::vector<Object*> scene;
-
     // Terrain: gentle hills around origin. originXZ = (0,0,0) -> we use x,z for horizontal domain, y stores seed
-    // auto* terrain = new Terrain({0, 0, 0}, /*amplitude*/ 30.0f, /*frequency*/ 0.005f, /*seed*/ 3.0f, sf::Color(30, 140, 40));
-    // auto* terrain2 = new Terrain({0, 0, -50}, /*amplitude*/ 80.0f, /*frequency*/ 0.005f, /*seed*/ 3.0f, sf::Color(30, 35, 40));
+    // auto* terrain = scene.add<Terrain>(Vector3(0, 0, 0), /*amplitude*/ 30.0f, /*frequency*/ 0.005f, /*seed*/ 3.0f, sf::Color(30, 140, 40));
+    // auto* terrain2 = scene.add<Terrain>(Vector3(0, 0, -50), /*amplitude*/ 80.0f, /*frequency*/ 0.005f, /*seed*/ 3.0f, sf::Color(30, 35, 40));
     // terrain->setWarp(2.0f, true).setRidged(false);
     // terrain2->setWarp(2.0f, true).setRidged(false);
-    // scene.push_back(terrain);
-    // scene.push_back(terrain2);
     // A sphere above terrain to look at
-    // scene.push_back(new Sphere({0, 10, 6}, 1.0, sf::Color::Red));
+    // scene.add<Sphere>(Vector3(0, 10, 6), 1.0, sf::Color::Red);
 
     // Green floor plane at Z = 0 (ground level)
-    scene.push_back(new Plane({0, 0, 0}, Z, sf::Color::Green, 0.5f));
+    scene.add<Plane>(Vector3(0, 0, 0), Z, sf::Color::Green, 0.5f);
     // A sphere on the floor to look at (at position Y=10, Z=1 for radius)
-    scene.push_back(new Sphere({0, 10, 1}, 5.0, sf::Color::Red, "textures/petyb.jpg"));
-    scene.push_back(new Mandelbulb({0, 5, 50}, 8, 1.0, sf::Color::Red, 30, "textures/Texturelabs_Atmosphere_126M.jpg"));
-
-    //scene.push_back(new Mandelbulb({0, 5, 50}, 8, 1.0, sf::Color::Red, 30, "textures/petyb.jpg"));
-    scene.push_back(new Box({1, 1, 1}, {1, 2, 1}, sf::Color::Blue, "textures/petyb.jpg"));
-    scene.push_back(new Box({5, 1, 1}, {1, 1, 1}, sf::Color::Blue, "textures/Pavel.png"));
-    scene.push_back(new Box({9, 1, 1}, {1, 1, 1}, sf::Color::Blue, "textures/Anatoly.png"));
-    scene.push_back(new QuaternionJulia(
-        {0, 5, 30},           // center position
-        {0.3, 0.5, 0.1},     // Julia constant c (affects the fractal shape)
+    scene.add<Sphere>(Vector3(0, 10, 1), 5.0, sf::Color::Red, std::string("textures/petyb.jpg"));
+    auto* bulb = scene.add<Mandelbulb>(Vector3(0, 5, 50), 8, 1.0, sf::Color::Red, 30.0, std::string("textures/Texturelabs_Atmosphere_126M.jpg"));
+    scene.setName(bulb, "bulb");
+    scene.setDynamic(bulb);  // animated by the timeline in main(), so it stays out of the shadow cache
+
+    //scene.add<Mandelbulb>(Vector3(0, 5, 50), 8, 1.0, sf::Color::Red, 30.0, std::string("textures/petyb.jpg"));
+    scene.add<Box>(Vector3(1, 1, 1), Vector3(1, 2, 1), sf::Color::Blue, std::string("textures/petyb.jpg"));
+    scene.add<Box>(Vector3(5, 1, 1), Vector3(1, 1, 1), sf::Color::Blue, std::string("textures/Pavel.png"));
+    scene.add<Box>(Vector3(9, 1, 1), Vector3(1, 1, 1), sf::Color::Blue, std::string("textures/Anatoly.png"));
+    scene.add<QuaternionJulia>(
+        Vector3(0, 5, 30),    // center position
+        Vector3(0.3, 0.5, 0.1), // Julia constant c (affects the fractal shape)
         12,                   // iterations (more = more detail)
-        20.0,                  // scale
+        20.0,                 // scale
         sf::Color::Magenta,   // color
-        "textures/fire.jpg"  // optional texture
-    ));
+        "textures/fire.jpg"   // optional texture
+    );
 
     // Big box floating above (at Z = 8, centered at Y = 10)
     // This box should cast a shadow on the sphere below
-    scene.push_back(new Box({0, 10, 8}, {2.0, 2.0, 1.0}, sf::Color::White, 1));
+    scene.add<Box>(Vector3(0, 10, 8), Vector3(2.0, 2.0, 1.0), sf::Color::White, 1.0f);
 
     // // Optional: keep fractal far away
-    // scene.push_back(new Mandelbulb({0, 5, 50}, 8, 1.0, sf::Color::Red, 40));
+    // scene.add<Mandelbulb>(Vector3(0, 5, 50), 8, 1.0, sf::Color::Red, 40.0);
     // Sphere below the box (at Y = 10, Z = 2)
     // Give it some reflectivity so reflections are visible (0 = none, 1 = mirror)
-    scene.push_back(new Sphere({0, 20, 2}, 1.5, sf::Color::White, 0.8f));
+    scene.add<Sphere>(Vector3(0, 20, 2), 1.5, sf::Color::White, 0.8f);
 
-    // scene.push_back(new Box({1, 1, 1}, {1, 1, 1}, sf::Color::Blue, "textures/Texturelabs_Atmosphere_126M.jpg"));
+    // scene.add<Box>(Vector3(1, 1, 1), Vector3(1, 1, 1), sf::Color::Blue, std::string("textures/Texturelabs_Atmosphere_126M.jpg"));
     // Sun-like light source (bright yellow sphere in the sky)
-    //scene.push_back(new Sphere({0, 20, 15}, 2.0, sf::Color(255, 255, 200)));
+    //scene.add<Sphere>(Vector3(0, 20, 15), 2.0, sf::Color(255, 255, 200));
 
     // Light direction (pointing from sun position)
     // Light source positioned above and to the side
     // This creates a clear shadow that should fall on the sphere
-    scene.push_back(new Sphere({-5, 10, 12}, 1.0, sf::Color::White));
+    scene.add<Sphere>(Vector3(-5, 10, 12), 1.0, sf::Color::White);
+
+    scene.add<Sphere>(Vector3(0, -21, 16), 0.2, sf::Color::Yellow);
+}
+
+// One tree per CSG node type and shader leaf, for checking the GPU encoding (--check-csg)
+static std::vector<std::pair<std::string, Object*>> buildCsgSamples(Scene& scene)
+{
+    const sf::Color c = sf::Color::White;
+    return {
+        {"union", scene.add<Union>(scene.make<Sphere>(Vector3(0, 0, 1), 1.0, c), scene.make<Box>(Vector3(1, 0, 1), Vector3(1, 0.5, 0.5), c, 0.0f))},
+        {"intersection", scene.add<Intersection>(scene.make<Sphere>(Vector3(0, 0, 0), 1.2, c), scene.make<Cylinder>(Vector3(0, 0, 0), 0.8, 2.0, c))},
+        {"difference", scene.add<Difference>(scene.make<Box>(Vector3(0, 0, 0), Vector3(1, 1, 1), c, 0.0f),
+                                             scene.make<Union>(scene.make<Torus>(Vector3(0, 0, 0), 1.0, 0.3, c),
+                                                               scene.make<Capsule>(Vector3(-2, 0, 0), Vector3(2, 0, 0), 0.4, c)))},
+        {"repetition", scene.add<Repetition>(scene.make<Sphere>(Vector3(0, 0, 0), 0.5, c), Vector3(2, 2, 0), Vector3(3, 3, 0))},
+        {"transform", scene.add<Transform>(scene.make<Difference>(scene.make<Box>(Vector3(0, 0, 0), Vector3(1, 2, 0.5), c, 0.0f),
+                                                                  scene.make<Sphere>(Vector3(0, 1, 0), 0.8, c)),
+                                           Vector3(3, -1, 2), fromAngleAxis(0.7, Vector3(1, 2, 3).normalized()), 1.5)},
+        {"mandelbulb", scene.add<Union>(scene.make<Mandelbulb>(Vector3(0, 0, 0), 8, 8.0, c, 2.0, 0.0f), scene.make<Plane>(Vector3(0, 0, -2), Z, c))},
+        {"julia", scene.add<Intersection>(scene.make<QuaternionJulia>(Vector3(0, 0, 0), Vector3(0.3, 0.5, 0.1), 12, 2.0, c),
+                                          scene.make<Box>(Vector3(0, 0, 0), Vector3(3, 3, 1), c, 0.0f))},
+    };
+}
+
+// Light direction (pointing from light position toward the scene)
+static Vector3 sceneLight()
+{
+    return (Vector3(0, -20, 15) - Vector3(0, 0, 2)).normalized();
+}
+
+// Root mean square difference of two RGBA images over the color channels, in [0, 1]
+static double rmse(const std::vector<std::uint8_t>& a, const std::vector<std::uint8_t>& b)
+{
+    double sum = 0.0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (i % 4 == 3) continue;
+        const double d = (a[i] - b[i]) / 255.0;
+        sum += d * d;
+    }
+    return std::sqrt(sum / static_cast<double>(a.size() / 4 * 3));
+}
+
+// ---------------- HEADLESS MODES ----------------
+// Rendering without the window:
+//   --coordinator [--port P] [--local-workers N] [--threads T] [--size WxH] [--tile S] [--path-samples N] [--aa N] [--out FILE]
+//       one frame of the scene from the start camera, as tiles across worker processes (TileRender.h);
+//       path traced when --path-samples is given, edge anti-aliased with up to N extra rays per pixel with --aa
+//   --worker HOST:PORT [--threads T]
+//       tile worker; workers on other machines run the same executable and need the same textures
+//   --check-csg
+//       compares the GPU encoding of sample CSG trees (CsgProgram::evaluate) with the CPU
+//       distances; exits with 1 on a mismatch
+//   --export-scene FILE
+//       writes the scene as SceneFile text, e.g. for a batch job
+//   --batch JOB
+//       renders an animation job (BatchRender.h); run it again to resume after an interruption
+//   --poster FILE [--size WxH] [--band ROWS] [--aa N] [--restart]
+//       one large frame from the start camera, streamed to a .ppm/.png/.tif band by band
+//       (StreamingImage.h); resumes an interrupted poster unless --restart is given.
+//       --aa N gives edge pixels up to N extra sub-pixel rays (CpuRenderer::edgeSamples)
+//   --path-trace FILE [--size WxH] [--samples N] [--noise T] [--denoise]
+//       one frame from the start camera, path traced (PathTracer.h) with up to N samples per pixel;
+//       pixels stop early once their noise is below T. --denoise filters the result (Denoiser.h)
+//       and lowers the default N from 1024 to 8
+//   --path-trace --denoise-bench [--size WxH] [--reference N] [--samples N]
+//       path traces a reference at N samples per pixel (default 512), then frames at 1, 2, 4, ...
+//       up to --samples (default 8); reports the RMSE against the reference and the time per
+//       sample, raw and denoised
+static int runHeadless(const std::vector<std::string>& args, const std::string& executable)
+{
+    auto option = [&](const std::string& name, const std::string& fallback) {
+        const auto it = std::find(args.begin(), args.end(), name);
+        return it != args.end() && it + 1 != args.end() ? *(it + 1) : fallback;
+    };
+
+    try {
+        unsigned threads = std::stoul(option("--threads", "0"));
+        if (args[0] == "--worker") {
+            const std::string address = option("--worker", "");
+            const auto colon = address.rfind(':');
+            const auto host = colon == std::string::npos ? std::nullopt : sf::IpAddress::resolve(address.substr(0, colon));
+            if (!host) throw std::invalid_argument("expected --worker HOST:PORT");
+
+            threadLimit = threads;
+            const std::size_t tiles = runTileWorker(*host, static_cast<unsigned short>(std::stoul(address.substr(colon + 1))));
+            std::cout << "Worker rendered " << tiles << " tiles\n";
+            return 0;
+        }
+        if (args[0] == "--check-csg") {
+            // CsgProgram::evaluate mirrors the shader's interpreter; both must agree with the CPU trees
+            Scene scene;
+            bool passed = true;
+            for (const auto& [name, root] : buildCsgSamples(scene)) {
+                const double deviation = CsgProgram::maxDeviation(root);
+                const bool ok = deviation >= 0.0 && deviation < 1e-3;
+                std::cout << name << ": " << (deviation < 0.0 ? "cannot be encoded" : "max deviation " + std::to_string(deviation))
+                          << (ok ? "\n" : " - FAILED\n");
+                passed = passed && ok;
+            }
+            return passed ? 0 : 1;
+        }
+        if (args[0] == "--export-scene") {
+            Scene scene;
+            buildScene(scene);
+            std::ofstream out(option("--export-scene", ""));
+            if (!out) throw std::runtime_error("cannot write the scene file");
+            writeScene(scene, out);
+            return 0;
+        }
+        if (args[0] == "--batch") {
+            std::ifstream in(option("--batch", ""));
+            if (!in) throw std::runtime_error("cannot open the batch job");
+            const BatchStats stats = renderAnimation(readAnimationJob(in), &std::cout);
+            std::cout << stats.rendered << " frames rendered, " << stats.skipped << " already done, "
+                      << stats.seconds << " s\n";
+            return 0;
+        }
+        if (args[0] == "--poster") {
+            Scene scene;
+            buildScene(scene);
+            CpuRenderer renderer(scene, sceneLight(), PI / 3);
+            renderer.edgeSamples = std::stoul(option("--aa", "0"));
+            const std::string size = option("--size", "1280x720");
+            StreamingImageWriter writer(option("--poster", ""), std::stoul(size), std::stoul(size.substr(size.find('x') + 1)),
+                                        std::stoul(option("--band", "64")),
+                                        std::find(args.begin(), args.end(), "--restart") == args.end());
+            if (writer.firstPendingRow() > 0)
+                std::cout << "Resuming at row " << writer.firstPendingRow() << "\n";
+            renderStreaming(renderer, CameraBasis(Vector3(0, 0, 10), Z*-1+X*0.001, Z), writer);
+            return 0;
+        }
+        if (args[0] == "--path-trace" && std::find(args.begin(), args.end(), "--denoise-bench") != args.end()) {
+            Scene scene;
+            buildScene(scene);
+            CpuRenderer renderer(scene, sceneLight(), PI / 3);
+            const CameraBasis camera(Vector3(0, 0, 10), Z*-1+X*0.001, Z);
+            const std::string size = option("--size", "320x180");
+            const unsigned width = std::stoul(size), height = std::stoul(size.substr(size.find('x') + 1));
+            using Clock = std::chrono::steady_clock;
+            auto ms = [](Clock::time_point from, Clock::time_point to) { return std::chrono::duration<double, std::milli>(to - from).count(); };
+
+            // Every pixel takes exactly N samples: no early stop, so only the sample count differs
+            PathTracer reference(renderer);
+            reference.minSamples = reference.maxSamples = std::max(1u, static_cast<unsigned>(std::stoul(option("--reference", "512"))));
+            std::vector<std::uint8_t> truth, raw, denoised;
+            const auto start = Clock::now();
+            reference.render(camera, width, height, 0, 0, width, height, truth);
+            std::cout << "Reference: " << reference.maxSamples << " spp in " << ms(start, Clock::now()) / 1000.0 << " s\n";
+
+            const unsigned most = std::max(1u, static_cast<unsigned>(std::stoul(option("--samples", "8"))));
+            for (unsigned spp = 1; spp <= most; spp *= 2) {
+                PathTracer tracer(renderer);
+                tracer.minSamples = tracer.maxSamples = tracer.samplesPerPass = spp;
+                tracer.denoise = true;
+                const auto t0 = Clock::now();
+                tracer.begin(camera, width, height, 0, 0, width, height);  // includes the denoiser's G-buffer
+                const auto t1 = Clock::now();
+                while (tracer.pass() > 0) {}
+                const auto t2 = Clock::now();
+                tracer.denoise = false;
+                tracer.resolve(raw);
+                tracer.denoise = true;
+                const auto t3 = Clock::now();
+                tracer.resolve(denoised);
+                const auto t4 = Clock::now();
+                std::cout << spp << " spp: raw RMSE " << rmse(raw, truth) << " (" << ms(t1, t2) / spp << " ms/spp), denoised RMSE "
+                          << rmse(denoised, truth) << " (+" << ms(t0, t1) << " ms G-buffer, +" << ms(t3, t4) << " ms filter)\n";
+            }
+            return 0;
+        }
+        if (args[0] == "--path-trace") {
+            Scene scene;
+            buildScene(scene);
+            CpuRenderer renderer(scene, sceneLight(), PI / 3);
+            PathTracer tracer(renderer);
+            tracer.denoise = std::find(args.begin(), args.end(), "--denoise") != args.end();
+            tracer.maxSamples = std::max(1u, static_cast<unsigned>(std::stoul(option("--samples", tracer.denoise ? "8" : "1024"))));
+            tracer.noiseTolerance = std::stod(option("--noise", "0.004"));
+            const std::string size = option("--size", "1280x720");
+            const unsigned width = std::stoul(size), height = std::stoul(size.substr(size.find('x') + 1));
+
+            const auto start = std::chrono::steady_clock::now();
+            tracer.begin(CameraBasis(Vector3(0, 0, 10), Z*-1+X*0.001, Z), width, height, 0, 0, width, height);
+            for (unsigned passes = 1; tracer.pass() > 0; ++passes)
+                if (passes % 16 == 0) std::cout << "Pass " << passes << ": " << tracer.activePixels() << " pixels still sampling\n";
+            std::cout << tracer.samplesTaken() << " samples ("
+                      << static_cast<double>(tracer.samplesTaken()) / (static_cast<double>(width) * height) << " per pixel) in "
+                      << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+
+            std::vector<std::uint8_t> pixels;
+            tracer.resolve(pixels);
+            const std::string out = option("--path-trace", "");
+            if (!sf::Image({width, height}, pixels.data()).saveToFile(out))
+                throw std::runtime_error("cannot write " + out);
+            return 0;
+        }
+        if (args[0] == "--coordinator") {
+            Scene scene;
+            buildScene(scene);
+            std::ostringstream text;
+            writeScene(scene, text);
+
+            RenderJob job;
+            job.scene = text.str();
+            job.cameraOrigin = Vector3(0, 0, 10);
+            job.cameraForward = (Z*-1+X*0.001).normalized();
+            job.light = sceneLight();
+            job.fov = PI / 3;
+            const std::string size = option("--size", "1280x720");
+            job.width = std::stoul(size);
+            job.height = std::stoul(size.substr(size.find('x') + 1));
+            job.pathSamples = std::stoul(option("--path-samples", "0"));
+            job.edgeSamples = std::stoul(option("--aa", "0"));
+
+            TileCoordinator coordinator(static_cast<unsigned short>(std::stoul(option("--port", "0"))));
+            coordinator.tileSize = std::stoul(option("--tile", "64"));
+            std::cout << "Coordinator listening on port " << coordinator.port() << "\n";
+
+            // Local workers split the machine between them unless told otherwise
+            const unsigned localWorkers = std::stoul(option("--local-workers", "0"));
+            if (localWorkers > 0 && threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency() / localWorkers);
+            const std::vector<int> processes = localWorkers > 0
+                ? spawnLocalWorkers(executable, localWorkers, coordinator.port(), threads)
+                : std::vector<int>();
+
+            const std::vector<std::uint8_t> pixels = coordinator.render(job, processes);
+            waitLocalWorkers(processes);
+
+            const auto& stats = coordinator.stats();
+            std::cout << stats.tiles << " tiles from " << stats.workers << " workers in " << stats.seconds << " s ("
+                      << stats.reissued << " reissued)\n";
+            const std::string out = option("--out", "frame.png");
+            if (!sf::Image({job.width, job.height}, pixels.data()).saveToFile(out))
+                throw std::runtime_error("cannot write " + out);
+            return 0;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    std::cerr << "usage: " << executable << " [mode]    (without a mode: the interactive window)\n"
+              << "  --coordinator [--port P] [--local-workers N] [--threads T] [--size WxH] [--tile S] [--path-samples N] [--aa N] [--out FILE]\n"
+              << "  --worker HOST:PORT [--threads T]\n"
+              << "  --check-csg\n"
+              << "  --export-scene FILE\n"
+              << "  --batch JOB\n"
+              << "  --poster FILE [--size WxH] [--band ROWS] [--aa N] [--restart]\n"
+              << "  --path-trace FILE [--size WxH] [--samples N] [--noise T] [--denoise]\n"
+              << "  --path-trace --denoise-bench [--size WxH] [--reference N] [--samples N]\n";
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    if (argc > 1)
+        return runHeadless(std::vector<std::string>(argv + 1, argv + argc), argv[0]);
+
+    // Random number generator for QuaternionJulia animation
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> signDist(0, 1);  // 0 or 1 for sign
+
+    // ---------------- CAMERA ----------------
+    // Start camera at standing height (Z = 2) looking forward
+    // Z is up, Y is forward, X is right
+    Ray camera({0, 0, 10}, Z*-1+X*0.001);
+
+    // FPS camera state - using proper spherical coordinates
+    // Yaw: rotation around Z axis (horizontal look left/right)
+    // Pitch: angle from horizontal plane (vertical look up/down)
+    double yaw = 0.0;      // 0 = looking along +Y
+    double pitch = 0.0;    // 0 = looking horizontally
+    const double mouseSensitivity = 0.003;
+    const double maxPitch = PI / 2.1;
+
+    Scene scene;
+    buildScene(scene);
+    const Vector3 lightDir = sceneLight();
+
+    // The bulb's power grows by 0.5 per second
+    Timeline timeline(scene);
+    timeline.animate("bulb", "power").key(0.0, 1.0).key(1.0, 1.5).extrapolate(Timeline::Extrapolation::Linear);
 
-    // Light direction (pointing from light position toward the scene)
-    Vector3 lightDir = (Vector3(0, -20, 15) - Vector3(0, 0, 2)).normalized();
-    scene.push_back(new Sphere({0, -21, 16}, 0.2, sf::Color::Yellow));
     RayMarchingRender renderer(
         1280,
         720,
@@ -123,22 +410,89 @@ int main()
     // Track pressed keys for event-based input (avoids permission issues)
     std::set<sf::Keyboard::Key> pressedKeys;
 
-    double fps = 1;
+    // ---------------- THREADS ----------------
+    // This thread polls events (SFML wants them on the window's thread) and advances the
+    // camera and the animation clock whenever it wakes up, independent of the frame rate.
+    // The render thread latches the newest state through a triple buffer: settings and
+    // animation at the start of a frame, the camera only right before marching.
+    struct FrameInput {
+        Vector3 cameraOrigin, cameraDirection;
+        std::vector<double> animation;  // timeline values, sampled here, applied by the renderer
+        unsigned width = 0, height = 0;
+        bool useCpu = false;
+        bool governorEnabled = true;
+    };
+    TripleBuffer<FrameInput> frameInput;
+    std::atomic<bool> running{true};
+
+    unsigned windowWidth = renderer.width, windowHeight = renderer.height;
+    bool useCpu = renderer.useCpu;
+    bool governorEnabled = renderer.governor.enabled;
+    const auto startTime = std::chrono::steady_clock::now();
+
+    auto publish = [&] {
+        FrameInput& next = frameInput.back();
+        next.cameraOrigin = camera.getOrigin();
+        next.cameraDirection = camera.getDirection();
+        timeline.sample(std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(), next.animation);
+        next.width = windowWidth;
+        next.height = windowHeight;
+        next.useCpu = useCpu;
+        next.governorEnabled = governorEnabled;
+        frameInput.publish();
+    };
+    publish();
+
+    // The GL context moves to the render thread
+    (void)window.setActive(false);
+    std::thread renderThread([&] {
+        (void)window.setActive(true);
+        while (running.load(std::memory_order_relaxed))
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            frameInput.latch();
+            const FrameInput& input = frameInput.front();
+            if (input.width != renderer.width || input.height != renderer.height)
+                renderer.setSize(input.width, input.height);
+            renderer.useCpu = input.useCpu;
+            renderer.governor.enabled = input.governorEnabled;
+            timeline.apply(input.animation);
+
+            // Render
+            renderer.renderFrame([&] {
+                frameInput.latch();
+                const FrameInput& latest = frameInput.front();
+                return Ray(latest.cameraOrigin, latest.cameraDirection);
+            });
+            window.display();
+            window.clear();
+
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double, std::milli> duration = end - start;
+            std::cout << "FPS: " << 1000.0 / duration.count() << "\n";
+            renderer.governor.update(duration.count());
+        }
+        (void)window.setActive(false);
+    });
+
     // ---------------- MAIN LOOP ----------------
-    while (window.isOpen())
+    bool open = true;
+    auto lastUpdate = std::chrono::steady_clock::now();
+    while (open)
     {
-        auto start = std::chrono::high_resolution_clock::now();
-
         while (const std::optional<sf::Event> event = window.pollEvent())
         {
             if (event->is<sf::Event::Closed>())
             {
-                window.close();
+                open = false;
             }
             else if (event->is<sf::Event::Resized>())
             {
                 const auto* resized = event->getIf<sf::Event::Resized>();
-                renderer.setSize(resized->size.x, resized->size.y);
+                // The window already has its new size; the render thread only follows it
+                windowWidth = resized->size.x;
+                windowHeight = resized->size.y;
                 // Update center position after resize
                 lastMouseX = resized->size.x / 2.0;
                 lastMouseY = resized->size.y / 2.0;
@@ -217,6 +571,14 @@ int main()
             {
                 const auto* keyPressed = event->getIf<sf::Event::KeyPressed>();
                 pressedKeys.insert(keyPressed->code);
+
+                // C - toggle the CPU renderer
+                if (keyPressed->code == sf::Keyboard::Key::C)
+                    useCpu = !useCpu;
+
+                // G - toggle the dynamic resolution governor (off = full quality)
+                if (keyPressed->code == sf::Keyboard::Key::G)
+                    governorEnabled = !governorEnabled;
             }
             else if (event->is<sf::Event::KeyReleased>())
             {
@@ -225,6 +587,11 @@ int main()
             }
         }
 
+        // Movement uses the time since the last update, not the last frame's fps
+        const auto now = std::chrono::steady_clock::now();
+        const double dt = std::chrono::duration<double>(now - lastUpdate).count();
+        lastUpdate = now;
+
         // WASD Movement - check keyboard state
         Vector3 moveDirection(0, 0, 0);
 
@@ -273,38 +640,27 @@ int main()
         }
 
         if (pressedKeys.contains(sf::Keyboard::Key::LShift)) {
-            moveSpeed *= pow(2, 1/fps);
+            moveSpeed *= pow(2, dt);
         }
 
         if (pressedKeys.contains(sf::Keyboard::Key::LControl)) {
-            moveSpeed /= pow(2, 1/fps);
+            moveSpeed /= pow(2, dt);
             if (moveSpeed < 0.01) moveSpeed = 0.01;
         }
 
-        cout << moveSpeed << endl;
-
         // Apply movement if any key is pressed
         if (moveDirection.magnitude() > 0.001) {
-            moveDirection = moveDirection.normalized() * moveSpeed / fps;
+            moveDirection = moveDirection.normalized() * moveSpeed * dt;
             camera.move(moveDirection);
         }
 
-        // Render
-        renderer.renderFrame(camera);
-        window.display();
-        window.clear();
-
-        if (dynamic_cast<Mandelbulb*>(scene[2]))
-        dynamic_cast<Mandelbulb*>(scene[2])->power += 0.5 / fps;
-
-        auto end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> duration = end - start;
-        std::cout << "FPS: " << 1000.0 / duration.count() << "\n";
-        fps = 1000.0 / duration.count();
+        publish();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 
-    for (auto* object : scene)
-        delete object;
+    running = false;
+    renderThread.join();
+    window.close();
 
     return 0;
 }
\ No newline at end of file
@@ -4,6 +4,8 @@ uniform vec3 u_camForward;
 uniform vec3 u_camRight;
 uniform vec3 u_camUp;
 uniform float u_fov;
+uniform int u_maxSteps;        // ray step limit, at most MAX_STEPS (set by the resolution governor)
+uniform int u_reflectionDepth; // reflection bounces, at most MAX_REFLECTION_DEPTH
 uniform vec3 u_light;
 uniform int u_objCount;
 
@@ -31,6 +33,44 @@ uniform sampler2D u_texture5;
 uniform sampler2D u_texture6;
 uniform sampler2D u_texture7;
 
+// Cached light-space depth map of static geometry (see ShadowCache)
+uniform sampler2D u_shadowMap;
+uniform float u_shadowMapEnabled;
+uniform float u_shadowMapSize;       // texels per side
+uniform vec3  u_shadowOrigin;
+uniform vec3  u_shadowAxisU;
+uniform vec3  u_shadowAxisV;
+uniform float u_shadowExtent;
+uniform float u_shadowRange;
+uniform float u_objShadowCached[MAX_OBJECTS];  // 1 = covered by the shadow map
+
+// Objects each 16x16 pixel tile can see (see ScreenBins), tile rows top to bottom. A tile
+// is TILE_LIST_TEXELS texels: the object count in .r, then four object indices per texel.
+// Only primary rays use them; shadow and reflection rays still see every object.
+const float TILE_SIZE = 16.0;
+const float TILE_LIST_TEXELS = 9.0;
+uniform sampler2D u_tileLists;
+uniform vec2  u_tileListSize;        // texels
+uniform float u_tileListsEnabled;
+
+// Nested CSG trees as postfix programs (see CsgProgram.h). Each instruction is four rows:
+// (op, a, b, c), two op-specific vectors and the leaf colour. Type 12 objects run the
+// instructions [u_objRadius, u_objRadius2).
+const int MAX_CSG_ROWS = 256;
+const int CSG_STACK = 8;
+const int CSG_DOMAINS = 4;
+const float CSG_BOUND_MARGIN = 0.05;
+uniform vec4 u_csgProgram[MAX_CSG_ROWS];
+
+// Level of detail (see Lod.h): width of the current pixel's cone at the point being
+// evaluated. rayMarch() updates it every step and leaves it at the hit, so normals and
+// shadow rays of that hit see the same detail. 0 = full detail.
+float g_footprint = 0.0;
+
+// This fragment's tile list while its primary ray is marched; -1 = every object
+int g_tileCount = -1;
+int g_tileObjects[MAX_OBJECTS];
+
 // Reflection depth (0 = no reflections)
 const int MAX_REFLECTION_DEPTH = 2;
 
@@ -42,6 +82,22 @@ vec3 skyColor() { return vec3(0.5, 0.7, 1.0); }
 
 vec4 FragColor;
 
+float pixelAngle() { return 2.0 * tan(u_fov * 0.5) / u_resolution.y; }
+
+// Fractal detail of iteration n is ~scale / power^n wide; keep two iterations past the pixel
+float lodIterations(float iterations, float scale, float power) {
+    if (g_footprint <= 0.0) return iterations;
+    float levels = log(scale / g_footprint) / log(max(power, 2.0));
+    return clamp(ceil(levels) + 2.0, min(iterations, 2.0), iterations);
+}
+
+// fBm octaves with a wavelength below the pixel are dropped (one is kept beyond that)
+int lodOctaves(int octaves, float baseFreq, float lacunarity) {
+    if (g_footprint <= 0.0 || baseFreq <= 0.0 || lacunarity <= 1.0) return octaves;
+    float levels = log(1.0 / (baseFreq * g_footprint)) / log(lacunarity);
+    return int(clamp(floor(levels) + 2.0, 1.0, float(octaves)));
+}
+
 // ------------------------
 // Basic SDF functions
 // ------------------------
@@ -178,10 +234,115 @@ float quaternionJuliaSDF(vec3 p, vec3 center, float scale, vec3 juliaC, float it
     return distance;
 }
 
-// Example: CSG operations
-float opUnion(float d1, float d2) { return min(d1, d2); }
-float opIntersection(float d1, float d2) { return max(d1, d2); }
-float opDifference(float d1, float d2) { return max(d1, -d2); }
+// ------------------------
+// CSG programs
+// ------------------------
+float capsuleSegmentSDF(vec3 p, vec3 a, vec3 b, float radius) {
+    vec3 pa = p - a, ba = b - a;
+    float h = clamp(dot(pa,ba)/dot(ba,ba), 0.0, 1.0);
+    return length(pa - ba*h) - radius;
+}
+
+float csgLeafDistance(int pc, vec3 p) {
+    vec4 ins = u_csgProgram[pc * 4];
+    vec3 v1 = u_csgProgram[pc * 4 + 1].xyz;
+    vec3 v2 = u_csgProgram[pc * 4 + 2].xyz;
+    float op = ins.x;
+
+    if (op < 0.5) return sphereSDF(p, v1, ins.y);
+    if (op < 1.5) return planeSDF(p, v1, v2);
+    if (op < 2.5) return boxSDF(p, v1, v2);
+    if (op < 3.5) return cylinderSDF(p, v1, ins.y, ins.z * 2.0);
+    if (op < 4.5) return capsuleSegmentSDF(p, v1, v2, ins.y);
+    if (op < 5.5) return torusSDF(p, v1, ins.y, ins.z);
+    if (op < 9.5) return mandelbulbSDF(p, v1, ins.y, ins.z, lodIterations(ins.w, ins.y, ins.z));
+    if (op < 11.5) return quaternionJuliaSDF(p, v1, ins.y, v2, lodIterations(ins.z, ins.y, 2.0));
+    return 1e20;
+}
+
+// Runs instructions [begin, end): leaves and skipped bounds push (distance, leaf),
+// operators pop two entries and push one. leaf is the instruction of the winning leaf.
+// Repeat / Transform and their End instructions save and restore p around a child.
+float csgDistance(int begin, int end, vec3 p, out int leaf) {
+    float stackD[CSG_STACK];
+    int stackL[CSG_STACK];
+    int sp = 0;
+    vec3 domains[CSG_DOMAINS];
+    int dp = 0;
+    int pc = begin;
+
+    for (int step = 0; step < MAX_CSG_ROWS / 4; ++step) {
+        if (pc >= end) break;
+        vec4 ins = u_csgProgram[pc * 4];
+
+        if (ins.x < 19.5) {
+            stackD[sp] = csgLeafDistance(pc, p);
+            stackL[sp] = pc;
+            sp++;
+            pc++;
+        } else if (ins.x > 39.5) {
+            if (ins.x < 40.5) {
+                // Repeat: fold p into one grid cell until the matching EndRepeat
+                vec3 spacing = u_csgProgram[pc * 4 + 1].xyz;
+                vec3 limit = u_csgProgram[pc * 4 + 2].xyz;
+                domains[dp] = p;
+                dp++;
+                p -= spacing * clamp(floor(p / max(spacing, vec3(1e-9)) + 0.5), -limit, limit);
+            } else if (ins.x < 49.5) {
+                dp--;
+                p = domains[dp];
+            } else if (ins.x < 50.5) {
+                // Transform: rows 1-3 hold the inverse rotation with the translation in w
+                vec4 r0 = u_csgProgram[pc * 4 + 1];
+                vec4 r1 = u_csgProgram[pc * 4 + 2];
+                vec4 r2 = u_csgProgram[pc * 4 + 3];
+                vec3 q = p - vec3(r0.w, r1.w, r2.w);
+                domains[dp] = p;
+                dp++;
+                p = vec3(dot(r0.xyz, q), dot(r1.xyz, q), dot(r2.xyz, q)) / ins.y;
+            } else {
+                // EndTransform: back to the parent space, distance scaled with it
+                dp--;
+                p = domains[dp];
+                stackD[sp - 1] *= ins.y;
+            }
+            pc++;
+        } else if (ins.x > 29.5) {
+            // Bound: skip the subtree while well outside its bounding sphere
+            float d = length(p - u_csgProgram[pc * 4 + 1].xyz) - ins.y;
+            if (d > CSG_BOUND_MARGIN) {
+                stackD[sp] = d;
+                stackL[sp] = int(ins.w + 0.5);
+                sp++;
+                pc = int(ins.z + 0.5);
+            } else {
+                pc++;
+            }
+        } else {
+            sp--;
+            float y = stackD[sp];
+            float x = stackD[sp - 1];
+            int ly = stackL[sp];
+            int lx = stackL[sp - 1];
+            if (ins.x < 20.5) {        // union
+                stackD[sp - 1] = min(x, y);
+                stackL[sp - 1] = x < y ? lx : ly;
+            } else if (ins.x < 21.5) { // intersection
+                stackD[sp - 1] = max(x, y);
+                stackL[sp - 1] = x > y ? lx : ly;
+            } else if (ins.x < 22.5) { // difference, carved faces keep the minuend's leaf
+                stackD[sp - 1] = max(x, -y);
+            } else {                   // difference with the operands evaluated in reverse
+                stackD[sp - 1] = max(y, -x);
+                stackL[sp - 1] = ly;
+            }
+            pc++;
+        }
+    }
+
+    leaf = stackL[0];
+    return stackD[0];
+}
 
 // ------------------------
 // Noise/FBM utilities for terrain
@@ -192,7 +353,8 @@ float hash12(vec2 p) {
     return fract((p3.x + p3.y) * p3.z);
 }
 
-float valueNoise(vec2 p, float seed) {
+// Value noise in .x and its derivatives in .yz, in one evaluation (Terrain.h has the CPU port)
+vec3 valueNoise(vec2 p, float seed) {
     vec2 so = vec2(seed * 57.0, seed * 113.0);
     vec2 i = floor(p);
     vec2 f = fract(p);
@@ -201,100 +363,139 @@ float valueNoise(vec2 p, float seed) {
     float c = hash12(i + vec2(0.0, 1.0) + so);
     float d = hash12(i + vec2(1.0, 1.0) + so);
     vec2 u = f * f * (3.0 - 2.0 * f);
-    return mix(mix(a, b, u.x), mix(c, d, u.x), u.y);
+    vec2 du = 6.0 * f * (1.0 - f);
+    float k = a - b - c + d;
+    return vec3(a + (b - a) * u.x + (c - a) * u.y + k * u.x * u.y,
+                du * vec2(b - a + k * u.y, c - a + k * u.x));
 }
 
-float fbm2D(vec2 p, float baseFreq, int octaves, float lacunarity, float gain, float seed, float warpStrength, float warpToggle, float ridgedToggle) {
+// fBm in .x and its gradient with respect to p in .yz, including the domain warp
+vec3 fbm2D(vec2 p, float baseFreq, int octaves, float lacunarity, float gain, float seed, float warpStrength, float warpToggle, float ridgedToggle) {
     vec2 pp = p;
-    if (warpToggle > 0.5 && warpStrength > 0.0) {
-        float wf = max(0.01, baseFreq * 0.5);
-        float wx = valueNoise(p * wf + vec2(13.1 * seed, 37.7 * seed), seed);
-        float wy = valueNoise(p * wf + vec2(91.4 * seed + 17.0, 27.9 * seed + 11.0), seed);
-        pp += (vec2(wx, wy) * 2.0 - 1.0) * warpStrength;
+    vec3 wx = vec3(0.0);
+    vec3 wy = vec3(0.0);
+    float wf = 0.0;
+    bool warped = warpToggle > 0.5 && warpStrength > 0.0;
+    if (warped) {
+        wf = max(0.01, baseFreq * 0.5);
+        wx = valueNoise(p * wf + vec2(13.1 * seed, 37.7 * seed), seed);
+        wy = valueNoise(p * wf + vec2(91.4 * seed + 17.0, 27.9 * seed + 11.0), seed);
+        pp += (vec2(wx.x, wy.x) * 2.0 - 1.0) * warpStrength;
     }
 
     float amp = 1.0;
     float freq = baseFreq;
     float sum = 0.0;
-    int oct = 8;
-    for (int i = 0; i < oct; ++i) {
-        float n = valueNoise(pp * freq + vec2(17.0 * seed, 29.0 * seed), seed);
+    vec2 grad = vec2(0.0);
+    for (int i = 0; i < 8; ++i) {
+        if (i >= octaves) break;
+        vec3 n = valueNoise(pp * freq + vec2(17.0 * seed, 29.0 * seed), seed);
         if (ridgedToggle > 0.5) {
-            n = 1.0 - abs(2.0 * n - 1.0);
+            n = vec3(1.0 - abs(2.0 * n.x - 1.0), n.yz * (n.x >= 0.5 ? -2.0 : 2.0));
         }
-        sum += n * amp;
+        sum += n.x * amp;
+        grad += n.yz * (freq * amp);
         freq *= lacunarity;
         amp *= gain;
     }
-    return sum;
+
+    // Chain rule through the warp: d(pp)/d(p) = I + 2 * warpStrength * wf * (dwx; dwy)
+    if (warped) {
+        grad += 2.0 * warpStrength * wf * (grad.x * wx.yz + grad.y * wy.yz);
+    }
+    return vec3(sum, grad);
 }
 
-float terrainHeightAt(vec3 p, vec3 originXZ_seed, float amplitude, float baseFreq, vec3 oct_lac_gain, vec3 warpRidged) {
+// Surface height in .x and its gradient over xy in .yz
+vec3 terrainHeightAt(vec3 p, vec3 originXZ_seed, float amplitude, float baseFreq, vec3 oct_lac_gain, vec3 warpRidged) {
     vec2 xy = p.xy - vec2(originXZ_seed.x, originXZ_seed.z);
     float seed = originXZ_seed.y;
     float octF = floor(oct_lac_gain.x + 0.5);
     float lac = oct_lac_gain.y;
     float g = oct_lac_gain.z;
-    int oct = int(clamp(octF, 1.0, 8.0));
-    float height = amplitude * fbm2D(xy, baseFreq, oct, lac, g, seed, warpRidged.x, warpRidged.z, warpRidged.y);
-    return height;
+    int oct = lodOctaves(int(clamp(octF, 1.0, 8.0)), baseFreq, lac);
+    return amplitude * fbm2D(xy, baseFreq, oct, lac, g, seed, warpRidged.x, warpRidged.z, warpRidged.y);
 }
 
 float terrainSDF(vec3 p, int idx) {
-    float h = terrainHeightAt(p, u_objPos[idx], u_objRadius[idx], u_objRadius2[idx], u_objNormal[idx], u_objColor2[idx]);
+    float h = terrainHeightAt(p, u_objPos[idx], u_objRadius[idx], u_objRadius2[idx], u_objNormal[idx], u_objColor2[idx]).x;
     return p.z - h - u_objExtra[idx];
 }
 
+// d = z - h(x, y), so the normal follows from the height gradient of the same fBm pass
+vec3 terrainNormal(vec3 p, int idx) {
+    vec3 h = terrainHeightAt(p, u_objPos[idx], u_objRadius[idx], u_objRadius2[idx], u_objNormal[idx], u_objColor2[idx]);
+    return normalize(vec3(-h.yz, 1.0));
+}
+
 // ------------------------
 // Scene distance
 // ------------------------
+float objectDistance(int i, vec3 p) {
+    float t = u_objType[i];
+    float d = 1e20;
+
+    if (t < 0.5) {
+        d = sphereSDF(p, u_objPos[i], u_objRadius[i]);
+    } else if (t < 1.5) {
+        d = planeSDF(p, u_objPos[i], u_objNormal[i]);
+    } else if (t < 2.5) {
+        // Box - use full size vector from objNormal
+        d = boxSDF(p, u_objPos[i], u_objNormal[i]);
+    } else if (t < 3.5) {
+        d = cylinderSDF(p, u_objPos[i], u_objRadius[i], u_objRadius[i]*2.0);
+    } else if (t < 4.5) {
+        d = capsuleSDF(p, u_objPos[i], u_objRadius[i], u_objRadius2[i]);
+    } else if (t < 5.5) {
+        d = torusSDF(p, u_objPos[i], u_objRadius[i], u_objRadius2[i]);
+    } else if (t < 8.5) {
+        // 6-8 were the two-sphere CSG nodes, replaced by CSG programs (12)
+    } else if (t < 9.5) {
+        d = mandelbulbSDF(p, u_objPos[i], u_objRadius[i], u_objRadius2[i], lodIterations(u_objNormal[i].x, u_objRadius[i], u_objRadius2[i]));
+    } else if (t < 10.5) {
+        d = terrainSDF(p, i);
+    } else if (t < 11.5) {
+        d = quaternionJuliaSDF(p, u_objPos[i], u_objRadius[i], vec3(u_objNormal[i].y, u_objNormal[i].z, u_objRadius2[i]), lodIterations(u_objNormal[i].x, u_objRadius[i], 2.0));
+    } else if (t < 12.5) {
+        int leaf;
+        d = csgDistance(int(u_objRadius[i] + 0.5), int(u_objRadius2[i] + 0.5), p, leaf);
+    }
+
+    return d;
+}
+
 float sceneDistance(vec3 p, out int hitIndex) {
     float minD = 1e20;
     hitIndex = -1;
 
-    for (int i = 0; i < u_objCount; ++i) {
-        float t = u_objType[i];
-        float d = 1e20;
-
-        if (t < 0.5) {
-            d = sphereSDF(p, u_objPos[i], u_objRadius[i]);
-        } else if (t < 1.5) {
-            d = planeSDF(p, u_objPos[i], u_objNormal[i]);
-        } else if (t < 2.5) {
-            // Box - use full size vector from objNormal
-            d = boxSDF(p, u_objPos[i], u_objNormal[i]);
-        } else if (t < 3.5) {
-            d = cylinderSDF(p, u_objPos[i], u_objRadius[i], u_objRadius[i]*2.0);
-        } else if (t < 4.5) {
-            d = capsuleSDF(p, u_objPos[i], u_objRadius[i], u_objRadius2[i]);
-        } else if (t < 5.5) {
-            d = torusSDF(p, u_objPos[i], u_objRadius[i], u_objRadius2[i]);
-        } else if (t < 6.5) {
-            float d1 = sphereSDF(p, u_objPos[i], u_objRadius[i]);
-            float d2 = sphereSDF(p, u_objNormal[i], u_objRadius2[i]);
-            d = min(d1, d2);
-        } else if (t < 7.5) {
-            float d1 = sphereSDF(p, u_objPos[i], u_objRadius[i]);
-            float d2 = sphereSDF(p, u_objNormal[i], u_objRadius2[i]);
-            d = max(d1, d2);
-        } else if (t < 8.5) {
-            float d1 = sphereSDF(p, u_objPos[i], u_objRadius[i]);
-            float d2 = sphereSDF(p, u_objNormal[i], u_objRadius2[i]);
-            d = max(d1, -d2);
-        } else if (t < 9.5) {
-            d = mandelbulbSDF(p, u_objPos[i], u_objRadius[i], u_objRadius2[i], u_objNormal[i].x);
-        } else if (t < 10.5) {
-            d = terrainSDF(p, i);
-        } else if (t < 11.5) {
-            d = quaternionJuliaSDF(p, u_objPos[i], u_objRadius[i], vec3(u_objNormal[i].y, u_objNormal[i].z, u_objRadius2[i]), u_objNormal[i].x);
+    if (g_tileCount >= 0) {
+        for (int k = 0; k < MAX_OBJECTS; ++k) {
+            if (k >= g_tileCount) break;
+            int i = g_tileObjects[k];
+            float d = objectDistance(i, p);
+            if (d < minD) { minD = d; hitIndex = i; }
         }
+        return minD;
+    }
 
+    for (int i = 0; i < u_objCount; ++i) {
+        float d = objectDistance(i, p);
         if (d < minD) { minD = d; hitIndex = i; }
     }
 
     return minD;
 }
 
+// Distance to the objects the shadow map does not cover
+float uncachedDistance(vec3 p) {
+    float minD = 1e20;
+    for (int i = 0; i < u_objCount; ++i) {
+        if (u_objShadowCached[i] > 0.5) continue;
+        minD = min(minD, objectDistance(i, p));
+    }
+    return minD;
+}
+
 // ------------------------
 // Normal estimation
 // ------------------------
@@ -307,6 +508,13 @@ vec3 estimateNormal(vec3 p) {
     return normalize(vec3(dx,dy,dz));
 }
 
+// Normal at a hit on object hitIndex: analytic for terrain, central differences of the
+// scene otherwise
+vec3 surfaceNormal(vec3 p, int hitIndex) {
+    if (u_objType[hitIndex] > 9.5 && u_objType[hitIndex] < 10.5) return terrainNormal(p, hitIndex);
+    return estimateNormal(p);
+}
+
 // ------------------------
 // UV coordinate calculation (from texture shader)
 // ------------------------
@@ -355,7 +563,38 @@ vec4 sampleTextureByIndex(int texIdx, vec2 uv) {
 // ------------------------
 // Shadow ray marching
 // ------------------------
+float unpackShadowDepth(vec2 texel) {
+    vec3 c = texture2D(u_shadowMap, (texel + 0.5) / u_shadowMapSize).rgb;
+    return dot(floor(c * 255.0 + 0.5), vec3(65536.0, 256.0, 1.0)) / 16777215.0 * u_shadowRange;
+}
+
+// Static visibility from the shadow map: 1 lit, 0 shadowed, -1 outside the map
+float cachedShadow(vec3 p, vec3 normal, vec3 lightDir) {
+    if (u_shadowMapEnabled < 0.5) return -1.0;
+
+    float texel = 2.0 * u_shadowExtent / u_shadowMapSize;
+    vec3 q = p + normal * (texel * 1.5) - u_shadowOrigin;
+    float z = -dot(q, lightDir);
+    vec2 t = (vec2(dot(q, u_shadowAxisU), dot(q, u_shadowAxisV)) + u_shadowExtent) / texel - 0.5;
+    if (z < 0.0 || z > u_shadowRange || any(lessThan(t, vec2(0.0))) || any(greaterThanEqual(t, vec2(u_shadowMapSize - 1.0)))) return -1.0;
+
+    // 2x2 percentage-closer filter
+    vec2 base = floor(t);
+    vec2 f = t - base;
+    float bias = texel * 1.5;
+    float l00 = step(z, unpackShadowDepth(base) + bias);
+    float l10 = step(z, unpackShadowDepth(base + vec2(1.0, 0.0)) + bias);
+    float l01 = step(z, unpackShadowDepth(base + vec2(0.0, 1.0)) + bias);
+    float l11 = step(z, unpackShadowDepth(base + vec2(1.0, 1.0)) + bias);
+    return mix(mix(l00, l10, f.x), mix(l01, l11, f.x), f.y);
+}
+
 float shadowRay(vec3 p, vec3 normal, vec3 lightDir) {
+    // Static geometry comes from the cache; only what it does not cover is marched
+    float cached = cachedShadow(p, normal, lightDir);
+    if (cached == 0.0) return 0.0;
+    bool uncachedOnly = cached > 0.0;
+
     const float shadowBias = 0.02;
     vec3 shadowOrigin = p + normal * shadowBias + lightDir * shadowBias;
 
@@ -368,12 +607,12 @@ float shadowRay(vec3 p, vec3 normal, vec3 lightDir) {
     for (int i = 0; i < MAX_SHADOW_STEPS && distTraveled < MAX_SHADOW_DIST; ++i) {
         int dummy;
         vec3 currentPos = shadowOrigin + lightDir * distTraveled;
-        float d = sceneDistance(currentPos, dummy);
+        float d = uncachedOnly ? uncachedDistance(currentPos) : sceneDistance(currentPos, dummy);
         if (d < SHADOW_EPS) return 0.0;
         distTraveled += max(d, 0.02);
     }
 
-    return 1.0;
+    return uncachedOnly ? cached : 1.0;
 }
 
 // ------------------------
@@ -382,13 +621,11 @@ float shadowRay(vec3 p, vec3 normal, vec3 lightDir) {
 vec3 baseColorAt(int hitIndex, vec3 p, vec3 normal) {
     float t = u_objType[hitIndex];
 
-    // CSG: choose color based on which primitive contributes
-    if (t >= 6.0 && t <= 8.0) {
-        float d1 = sphereSDF(p, u_objPos[hitIndex], u_objRadius[hitIndex]);
-        float d2 = sphereSDF(p, u_objNormal[hitIndex], u_objRadius2[hitIndex]);
-        if (t < 6.5) return (d1 < d2) ? u_objColor[hitIndex] : u_objColor2[hitIndex]; // union
-        if (t < 7.5) return (d1 < d2) ? u_objColor[hitIndex] : u_objColor2[hitIndex]; // intersection
-        return u_objColor[hitIndex]; // difference
+    // CSG: color of the leaf primitive that produced the surface
+    if (t >= 11.5 && t < 12.5) {
+        int leaf;
+        csgDistance(int(u_objRadius[hitIndex] + 0.5), int(u_objRadius2[hitIndex] + 0.5), p, leaf);
+        return u_csgProgram[leaf * 4 + 3].rgb;
     }
 
     // Texture selection (same rules as your texture shader)
@@ -449,8 +686,9 @@ vec3 shadePhong(vec3 p, vec3 normal, vec3 viewDir, int hitIndex) {
 // ------------------------
 // Ray march
 // ------------------------
-bool rayMarch(vec3 ro, vec3 rd, out vec3 hitPos, out int hitIndex) {
-    const float EPS = 0.001;
+// cone: path length before ro (reflections), so the pixel footprint keeps widening
+bool rayMarch(vec3 ro, vec3 rd, float cone, out vec3 hitPos, out int hitIndex) {
+    const float EPS = 0.001;  // lower limit; hits are accepted within half a pixel
     const float MAX_DIST = 2000.0;
     const int MAX_STEPS = 512;
 
@@ -458,10 +696,13 @@ bool rayMarch(vec3 ro, vec3 rd, out vec3 hitPos, out int hitIndex) {
     float distTraveled = 0.0;
     hitIndex = -1;
 
+    float angle = pixelAngle();
     for (int i = 0; i < MAX_STEPS && distTraveled < MAX_DIST; ++i) {
+        if (i >= u_maxSteps) break;
+        g_footprint = angle * (cone + distTraveled);
         int tmp;
         float d = sceneDistance(p, tmp);
-        if (d < EPS) { hitIndex = tmp; break; }
+        if (d < max(EPS, 0.5 * g_footprint)) { hitIndex = tmp; break; }
         p += max(d, 0.0) * rd;
         distTraveled += max(d, 0.0);
     }
@@ -471,21 +712,22 @@ bool rayMarch(vec3 ro, vec3 rd, out vec3 hitPos, out int hitIndex) {
 }
 
 // Trace reflected radiance along a path
-vec3 traceReflectionPath(vec3 rayOrigin, vec3 rayDir) {
+vec3 traceReflectionPath(vec3 rayOrigin, vec3 rayDir, float cone) {
     vec3 accum = vec3(0.0);
     float throughput = 1.0;
 
     for (int bounce = 0; bounce < MAX_REFLECTION_DEPTH; ++bounce) {
+        if (bounce >= u_reflectionDepth) break;
         vec3 hitPos;
         int hitIndex;
-        bool hit = rayMarch(rayOrigin, rayDir, hitPos, hitIndex);
+        bool hit = rayMarch(rayOrigin, rayDir, cone, hitPos, hitIndex);
 
         if (!hit) {
             accum += throughput * skyColor();
             break;
         }
 
-        vec3 n = estimateNormal(hitPos);
+        vec3 n = surfaceNormal(hitPos, hitIndex);
         vec3 viewDir = normalize(-rayDir);
 
         vec3 local = shadePhong(hitPos, n, viewDir, hitIndex);
@@ -499,6 +741,7 @@ vec3 traceReflectionPath(vec3 rayOrigin, vec3 rayDir) {
 
         if (throughput < 0.01) break;
 
+        cone += length(hitPos - rayOrigin);
         rayOrigin = hitPos + n * REFLECTION_BIAS;
         rayDir = normalize(reflect(rayDir, n));
     }
@@ -506,6 +749,23 @@ vec3 traceReflectionPath(vec3 rayOrigin, vec3 rayDir) {
     return accum;
 }
 
+// Reads the list of the tile holding this fragment into g_tileObjects
+void loadTileList() {
+    // CPU tile rows run top to bottom, gl_FragCoord.y bottom to top
+    vec2 tile = floor(vec2(gl_FragCoord.x, u_resolution.y - gl_FragCoord.y) / TILE_SIZE);
+    vec2 first = vec2(tile.x * TILE_LIST_TEXELS, tile.y);
+    float count = floor(texture2D(u_tileLists, (first + 0.5) / u_tileListSize).r * 255.0 + 0.5);
+    for (int k = 0; k < MAX_OBJECTS; k += 4) {
+        if (float(k) >= count) break;
+        vec4 ids = floor(texture2D(u_tileLists, (first + vec2(1.0 + float(k / 4), 0.0) + 0.5) / u_tileListSize) * 255.0 + 0.5);
+        g_tileObjects[k] = int(ids.r);
+        g_tileObjects[k + 1] = int(ids.g);
+        g_tileObjects[k + 2] = int(ids.b);
+        g_tileObjects[k + 3] = int(ids.a);
+    }
+    g_tileCount = int(count);
+}
+
 // ------------------------
 // Main
 // ------------------------
@@ -519,12 +779,15 @@ void main() {
 
     vec3 hitPos;
     int hitIndex;
-    if (!rayMarch(rayOrigin, rayDir, hitPos, hitIndex)) {
+    if (u_tileListsEnabled > 0.5) loadTileList();
+    bool primaryHit = rayMarch(rayOrigin, rayDir, 0.0, hitPos, hitIndex);
+    g_tileCount = -1;
+    if (!primaryHit) {
         gl_FragColor = vec4(skyColor(), 1.0);
         return;
     }
 
-    vec3 n0 = estimateNormal(hitPos);
+    vec3 n0 = surfaceNormal(hitPos, hitIndex);
     vec3 viewDir0 = normalize(-rayDir);
     vec3 local0 = shadePhong(hitPos, n0, viewDir0, hitIndex);
 
@@ -534,10 +797,10 @@ void main() {
     }
 
     vec3 color = local0;
-    if (MAX_REFLECTION_DEPTH > 0 && refl0 > 0.001) {
+    if (u_reflectionDepth > 0 && refl0 > 0.001) {
         vec3 reflDir0 = normalize(reflect(rayDir, n0));
         vec3 reflOrigin0 = hitPos + n0 * REFLECTION_BIAS;
-        vec3 reflected = traceReflectionPath(reflOrigin0, reflDir0);
+        vec3 reflected = traceReflectionPath(reflOrigin0, reflDir0, length(hitPos - rayOrigin));
         color += refl0 * REFLECTION_STRENGTH * reflected;
     }
 